@@ -0,0 +1,421 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "refraction.h"
+#include "approx.h"
+
+/*
+------------------------------------------------------
+approx.c
+
+In deltaAngle the spacecraft altitude and zenith angle only enter through
+z_0 = zenAng + theta, the zenith angle of the spacecraft seen from the ground
+station: dAng = z_0 - asin(sin(z_0) * EARTHRAD / (EARTHRAD + GS_HEIGHT)).
+So for a fixed station height dAng is a function of z_0 alone, and a one
+dimensional table covers every (zenith angle, altitude) pair. The range
+[0, z0Max] is split into equal cells, each fitted with a polynomial of degree
+APPROX_DEGREE through its Chebyshev nodes. Evaluation is a cell lookup plus
+APPROX_DEGREE multiply-adds. Other displacement models that depend only on z_0,
+such as the ray tracing of raytrace.c, are tabulated through refractApproxBuildFn.
+
+The table can be saved to and loaded from a file so that it need not be rebuilt
+at every start. The file holds a header (struct approxFileHeader) and the
+coefficients as native doubles.
+------------------------------------------------------
+*/
+
+struct approxFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	int32_t nCells, degree;
+	double z0Max;
+	double earthRad, gsHeight;      // Model constants the table was built with
+	double maxError;
+};
+
+/* dAng of the model in deltaAngle, as a function of the zenith angle at the ground station */
+static double shellDAng(double z_0)
+{
+	return z_0 - asin((sin(z_0) * EARTHRAD) / (EARTHRAD + GS_HEIGHT));
+}
+
+/* The function the table approximates */
+static double exactDAng(const struct refractApprox *tbl, double z_0)
+{
+	return tbl->fn != NULL ? tbl->fn(tbl->arg, z_0) : shellDAng(z_0);
+}
+
+/*
+------------------------------------------------------
+fitCell
+
+PURPOSE:		Fit dAng over one cell with a polynomial in local coordinates
+INPUT ARGUMENTS:	tbl (for the function to fit), cell bounds [lo, hi] in z_0
+OUTPUT ARGUMENTS:	coef[p], the coefficient of t^p, where t maps [lo, hi] onto [-1, 1]
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	cos, exactDAng
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Interpolation at the Chebyshev nodes, converted to the monomial basis for Horner evaluation
+------------------------------------------------------
+*/
+
+static void fitCell(const struct refractApprox *tbl, double lo, double hi, double *coef)
+{
+	double val[APPROX_COEFS], cheb[APPROX_COEFS], mono[APPROX_COEFS][APPROX_COEFS], sum;
+	int j, m, p;
+
+	for (m = 0; m < APPROX_COEFS; m++)
+	{
+		val[m] = exactDAng(tbl, 0.5 * (lo + hi) + 0.5 * (hi - lo) * cos(PI * (m + 0.5) / APPROX_COEFS));
+	}
+
+	/* Discrete Chebyshev transform: cheb[j] multiplies T_j(t) */
+	for (j = 0; j < APPROX_COEFS; j++)
+	{
+		sum = 0.0;
+		for (m = 0; m < APPROX_COEFS; m++)
+		{
+			sum += val[m] * cos(j * PI * (m + 0.5) / APPROX_COEFS);
+		}
+		cheb[j] = sum * (j == 0 ? 1.0 : 2.0) / APPROX_COEFS;
+	}
+
+	/* Monomial coefficients of each T_j from T_j = 2t T_(j-1) - T_(j-2) */
+	for (j = 0; j < APPROX_COEFS; j++)
+	{
+		for (p = 0; p < APPROX_COEFS; p++)
+		{
+			mono[j][p] = 0.0;
+		}
+	}
+	mono[0][0] = 1.0;
+	mono[1][1] = 1.0;
+	for (j = 2; j < APPROX_COEFS; j++)
+	{
+		for (p = 0; p < APPROX_COEFS; p++)
+		{
+			mono[j][p] = (p > 0 ? 2.0 * mono[j - 1][p - 1] : 0.0) - mono[j - 2][p];
+		}
+	}
+
+	for (p = 0; p < APPROX_COEFS; p++)
+	{
+		sum = 0.0;
+		for (j = 0; j < APPROX_COEFS; j++)
+		{
+			sum += cheb[j] * mono[j][p];
+		}
+		coef[p] = sum;
+	}
+}
+
+/*
+------------------------------------------------------
+refractApproxBuild
+
+PURPOSE:		Build the dAng table and measure its worst-case error
+INPUT ARGUMENTS:	z0Max, the largest zenith angle at the ground station to cover (radians, below pi/2),
+			number of cells nCells
+OUTPUT ARGUMENTS:	*tbl
+RETURNED VALUE:		0 on success, -1 on invalid arguments or allocation failure
+FUNCTIONS CALLED:	fitCell, refractApproxCheck
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			dAng bends sharply as z_0 approaches 90 degrees; 256 cells up to 85 degrees
+			stay within about 4e-15 rad (a few hundredths of a micrometre on the ground)
+------------------------------------------------------
+*/
+
+int refractApproxBuild(struct refractApprox *tbl, double z0Max, int nCells)
+{
+	return refractApproxBuildFn(tbl, z0Max, nCells, NULL, NULL);
+}
+
+/*
+------------------------------------------------------
+refractApproxBuildFn
+
+PURPOSE:		Build a table of another angular displacement model
+INPUT ARGUMENTS:	As refractApproxBuild, plus fn(arg, z_0) returning dAng (NULL for the refracting shell)
+OUTPUT ARGUMENTS:	*tbl
+RETURNED VALUE:		0 on success, -1 on invalid arguments or allocation failure
+FUNCTIONS CALLED:	fitCell, refractApproxCheck
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			fn must be smooth over [0, z0Max]; arg must outlive the table
+------------------------------------------------------
+*/
+
+int refractApproxBuildFn(struct refractApprox *tbl, double z0Max, int nCells,
+	double (*fn)(void *arg, double z_0), void *arg)
+{
+	double width;
+	int i;
+
+	tbl->coef = NULL;
+	tbl->fn = fn;
+	tbl->arg = arg;
+	if (nCells < 1 || !(z0Max > 0.0) || z0Max >= PI / 2)
+	{
+		return -1;
+	}
+
+	tbl->coef = malloc((size_t)nCells * APPROX_COEFS * sizeof(double));
+	if (tbl->coef == NULL)
+	{
+		return -1;
+	}
+	tbl->nCells = nCells;
+	tbl->z0Max = z0Max;
+	tbl->scale = nCells / z0Max;
+
+	width = z0Max / nCells;
+	for (i = 0; i < nCells; i++)
+	{
+		fitCell(tbl, i * width, (i + 1) * width, tbl->coef + (size_t)i * APPROX_COEFS);
+	}
+
+	refractApproxCheck(tbl, 64);
+
+	return 0;
+}
+
+void refractApproxFree(struct refractApprox *tbl)
+{
+	free(tbl->coef);
+	tbl->coef = NULL;
+}
+
+/*
+------------------------------------------------------
+refractApproxDAng
+
+PURPOSE:		Evaluate the tabulated angular displacement
+INPUT ARGUMENTS:	tbl, zenith angle of the spacecraft at the ground station z_0 (radians)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		dAng
+FUNCTIONS CALLED:	None
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Arguments outside [0, z0Max] are extrapolated from the nearest edge cell
+------------------------------------------------------
+*/
+
+double refractApproxDAng(const struct refractApprox *tbl, double z_0)
+{
+	const double *cf;
+	double u, t, r;
+	int i, p;
+
+	u = z_0 * tbl->scale;
+	i = (int)u;
+	i = i < 0 ? 0 : (i >= tbl->nCells ? tbl->nCells - 1 : i);
+	t = 2.0 * (u - i) - 1.0;
+
+	cf = tbl->coef + (size_t)i * APPROX_COEFS;
+	r = cf[APPROX_DEGREE];
+	for (p = APPROX_DEGREE - 1; p >= 0; p--)
+	{
+		r = r * t + cf[p];
+	}
+
+	return r;
+}
+
+/*
+------------------------------------------------------
+refractApproxCheck
+
+PURPOSE:		Measure the worst-case error of the table against the exact model
+INPUT ARGUMENTS:	tbl, samples per cell
+OUTPUT ARGUMENTS:	tbl->maxError
+RETURNED VALUE:		Largest |approximate - exact| dAng found, in radians
+FUNCTIONS CALLED:	exactDAng, refractApproxDAng
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Samples include both ends of every cell, where piecewise fits are worst
+------------------------------------------------------
+*/
+
+double refractApproxCheck(struct refractApprox *tbl, int samples)
+{
+	double z_0, err, worst = 0.0;
+	int i, m;
+
+	if (samples < 2)
+	{
+		samples = 2;
+	}
+
+	for (i = 0; i < tbl->nCells; i++)
+	{
+		for (m = 0; m < samples; m++)
+		{
+			z_0 = (i + (double)m / (samples - 1)) / tbl->scale;
+			err = fabs(refractApproxDAng(tbl, z_0) - exactDAng(tbl, z_0));
+			if (!(err <= worst))
+			{
+				worst = err;
+			}
+		}
+	}
+
+	tbl->maxError = worst;
+	return worst;
+}
+
+/*
+------------------------------------------------------
+refractApproxSave
+
+PURPOSE:		Write the table to a cache file
+INPUT ARGUMENTS:	tbl, path
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		0 on success, -1 on failure
+FUNCTIONS CALLED:	fopen, fwrite
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Only tables of the refracting shell model can be saved
+------------------------------------------------------
+*/
+
+int refractApproxSave(const struct refractApprox *tbl, const char *path)
+{
+	struct approxFileHeader hdr;
+	size_t ncoef = (size_t)tbl->nCells * APPROX_COEFS;
+	FILE *fp;
+	int ok;
+
+	if (tbl->fn != NULL)
+	{
+		return -1;
+	}
+
+	hdr.magic = APPROX_MAGIC;
+	hdr.version = APPROX_VERSION;
+	hdr.nCells = tbl->nCells;
+	hdr.degree = APPROX_DEGREE;
+	hdr.z0Max = tbl->z0Max;
+	hdr.earthRad = EARTHRAD;
+	hdr.gsHeight = GS_HEIGHT;
+	hdr.maxError = tbl->maxError;
+
+	fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		return -1;
+	}
+	ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 && fwrite(tbl->coef, sizeof(double), ncoef, fp) == ncoef;
+
+	return (fclose(fp) == 0 && ok) ? 0 : -1;
+}
+
+/*
+------------------------------------------------------
+refractApproxLoad
+
+PURPOSE:		Read a table written by refractApproxSave
+INPUT ARGUMENTS:	path
+OUTPUT ARGUMENTS:	*tbl
+RETURNED VALUE:		0 on success, -1 if the file is missing, malformed, or was built
+			with a different degree, Earth radius or station height
+FUNCTIONS CALLED:	fopen, fread, malloc
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Callers typically fall back to refractApproxBuild (and save) on failure
+------------------------------------------------------
+*/
+
+int refractApproxLoad(struct refractApprox *tbl, const char *path)
+{
+	struct approxFileHeader hdr;
+	size_t ncoef;
+	FILE *fp;
+
+	tbl->coef = NULL;
+	tbl->fn = NULL;
+	tbl->arg = NULL;
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+	{
+		return -1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != APPROX_MAGIC || hdr.version != APPROX_VERSION
+		|| hdr.degree != APPROX_DEGREE || hdr.earthRad != EARTHRAD || hdr.gsHeight != GS_HEIGHT
+		|| hdr.nCells < 1 || !(hdr.z0Max > 0.0))
+	{
+		fclose(fp);
+		return -1;
+	}
+
+	ncoef = (size_t)hdr.nCells * APPROX_COEFS;
+	tbl->coef = malloc(ncoef * sizeof(double));
+	if (tbl->coef == NULL || fread(tbl->coef, sizeof(double), ncoef, fp) != ncoef)
+	{
+		free(tbl->coef);
+		tbl->coef = NULL;
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	tbl->nCells = hdr.nCells;
+	tbl->z0Max = hdr.z0Max;
+	tbl->scale = hdr.nCells / hdr.z0Max;
+	tbl->maxError = hdr.maxError;
+
+	return 0;
+}
+
+/*
+------------------------------------------------------
+refractPointApprox
+
+PURPOSE:		refractPoint with the angular displacement taken from the table
+INPUT ARGUMENTS:	tbl, spacecraft coordinates (x,y,z) and ground station coordinates (a,b,c)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (*d,*e,*f)
+RETURNED VALUE:		0 if the table was used, 1 if z_0 was outside the table
+			and the exact refractPoint was used instead
+FUNCTIONS CALLED:	atan, refractApproxDAng, refractPoint, sqrt
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Replaces the sin and asin of the exact path; the zenith angle still needs one atan
+------------------------------------------------------
+*/
+
+int refractPointApprox(const struct refractApprox *tbl, double x, double y, double z, double a, double b, double c,
+	double *d, double *e, double *f)
+{
+	double alt_sat, t, dx, dy, dz, dist, z_0, k;
+
+	alt_sat = sqrt(x * x + y * y + z * z);
+	t = EARTHRAD / alt_sat;
+	dx = t * x - a;
+	dy = t * y - b;
+	dz = t * z - c;
+	dist = sqrt(dx * dx + dy * dy + dz * dz);
+	z_0 = atan(dist / (alt_sat - EARTHRAD)) + dist / EARTHRAD;
+
+	if (!(z_0 <= tbl->z0Max))
+	{
+		refractPoint(x, y, z, a, b, c, d, e, f, NULL);
+		return 1;
+	}
+	if (dist == 0.0)
+	{
+		*d = a;
+		*e = b;
+		*f = c;
+		return 0;
+	}
+
+	k = EARTHRAD * refractApproxDAng(tbl, z_0) / dist;
+	*d = a + k * dx;
+	*e = b + k * dy;
+	*f = c + k * dz;
+
+	return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef APPROX_H
+#define APPROX_H
+
+/*
+Piecewise polynomial approximation of the angular displacement dAng
+as a function of the zenith angle z_0 at the ground station
+*/
+#define APPROX_MAGIC 0x58504152u        // "RAPX" read as little-endian bytes
+#define APPROX_VERSION 1u
+#define APPROX_DEGREE 5                 // Polynomial degree in each cell
+#define APPROX_COEFS (APPROX_DEGREE + 1)
+
+struct refractApprox
+{
+	int nCells;                     // Number of cells over [0, z0Max]
+	double z0Max;                   // Largest zenith angle at the ground station served, in radians
+	double scale;                   // Cells per radian
+	double maxError;                // Worst-case |dAng error| found by refractApproxCheck, in radians
+	double *coef;                   // nCells * APPROX_COEFS, lowest power first
+	double (*fn)(void *arg, double z_0);    // Function tabulated; NULL for the refracting shell of deltaAngle
+	void *arg;
+};
+
+/*
+Function prototypes
+*/
+int refractApproxBuild(struct refractApprox *tbl, double z0Max, int nCells);
+
+int refractApproxBuildFn(struct refractApprox *tbl, double z0Max, int nCells,
+	double (*fn)(void *arg, double z_0), void *arg);
+
+void refractApproxFree(struct refractApprox *tbl);
+
+double refractApproxDAng(const struct refractApprox *tbl, double z_0);
+
+double refractApproxCheck(struct refractApprox *tbl, int samples);
+
+int refractApproxSave(const struct refractApprox *tbl, const char *path);
+
+int refractApproxLoad(struct refractApprox *tbl, const char *path);
+
+int refractPointApprox(const struct refractApprox *tbl, double x, double y, double z, double a, double b, double c,
+	double *d, double *e, double *f);
+
+#endif
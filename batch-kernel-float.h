@@ -0,0 +1,197 @@
+/*
+------------------------------------------------------
+batch-kernel-float.h
+
+Mixed precision vector kernel for refractBatchFloat, included by batch.c once per
+instruction set after the macros of batch-kernel.h. The including file must also define:
+
+FV, FM			vector of 2 VW floats and its comparison mask types
+FSET1, FADD, FSUB, FMUL, FDIV, FSQRT, FABS, FFLOOR, FFMA
+FGT, FLT, FEQ		ordered comparisons returning FM
+FSEL(m, a, b)		a where m is set, b elsewhere
+FPACK(lo, hi)		two VD rounded into one FV, lo in the low lanes
+FLO(v), FHI(v)		low and high halves of an FV widened to VD
+
+Coordinates, the projection and the final translation stay in double: a float
+ulp is half a metre at the Earth radius. The angular chain from the station to
+projection vector onwards runs in float on twice the lanes. The displacement
+z_0 - zed, which cancels in float, is obtained from its sine
+	u = sin(z_0) (1 - k^2) / (cos(zed) + k cos(z_0)),  cos(zed)^2 = 1 - k^2 + k^2 cos(z_0)^2
+with k = EARTHRAD / (EARTHRAD + GS_HEIGHT), keeping its relative precision. Above
+the horizon u < sqrt(1 - k^2) = 2.2e-3, so asin(u) = u + u^3 / 6 to float precision.
+
+The float functions follow the Cephes single precision implementations (S. Moshier).
+------------------------------------------------------
+*/
+
+/* Vector arctangent in float, Cephes atanf */
+
+static KATTR FV KFN(vatanf)(FV x)
+{
+	const FV zero = FSET1(0.0f);
+	FV ax, xr, y0, zz, p, r;
+	FM big, mid, neg;
+
+	neg = FLT(x, zero);
+	ax = FABS(x);
+
+	/* Range reduction: tan(3pi/8) and tan(pi/8) thresholds */
+	big = FGT(ax, FSET1(2.414213562373095f));
+	mid = FGT(ax, FSET1(0.4142135623730950f));
+
+	xr = FSEL(big, FDIV(FSET1(-1.0f), ax),
+		FSEL(mid, FDIV(FSUB(ax, FSET1(1.0f)), FADD(ax, FSET1(1.0f))), ax));
+	y0 = FSEL(big, FSET1(1.5707963267948966f), FSEL(mid, FSET1(0.7853981633974483f), zero));
+
+	zz = FMUL(xr, xr);
+	p = FSET1(8.05374449538e-2f);
+	p = FFMA(p, zz, FSET1(-1.38776856032e-1f));
+	p = FFMA(p, zz, FSET1(1.99777106478e-1f));
+	p = FFMA(p, zz, FSET1(-3.33329491539e-1f));
+	r = FADD(y0, FFMA(FMUL(p, zz), xr, xr));
+
+	return FSEL(neg, FSUB(zero, r), r);
+}
+
+/* Vector sine and cosine of x >= 0 in float, Cephes sinf/cosf sharing one reduction */
+
+static KATTR void KFN(vsincosf)(FV x, FV *s, FV *c)
+{
+	const FV one = FSET1(1.0f), minus = FSET1(-1.0f);
+	FV j, j8, zr, zz, ps, pc;
+	FM odd, hi, swap;
+
+	/* Octant of the argument, rounded up to an even octant */
+	j = FFLOOR(FMUL(x, FSET1(1.27323954473516f)));
+	odd = FEQ(FSUB(j, FMUL(FSET1(2.0f), FFLOOR(FMUL(j, FSET1(0.5f))))), one);
+	j = FSEL(odd, FADD(j, one), j);
+	j8 = FSUB(j, FMUL(FSET1(8.0f), FFLOOR(FMUL(j, FSET1(0.125f)))));
+	hi = FGT(j8, FSET1(3.0f));
+	j8 = FSEL(hi, FSUB(j8, FSET1(4.0f)), j8);
+	swap = FGT(j8, one);
+
+	/* Extended precision modular arithmetic */
+	zr = FSUB(x, FMUL(j, FSET1(0.78515625f)));
+	zr = FSUB(zr, FMUL(j, FSET1(2.4187564849853515625e-4f)));
+	zr = FSUB(zr, FMUL(j, FSET1(3.77489497744594108e-8f)));
+	zz = FMUL(zr, zr);
+
+	ps = FSET1(-1.9515295891e-4f);
+	ps = FFMA(ps, zz, FSET1(8.3321608736e-3f));
+	ps = FFMA(ps, zz, FSET1(-1.6666654611e-1f));
+	ps = FFMA(FMUL(ps, zz), zr, zr);
+
+	pc = FSET1(2.443315711809948e-5f);
+	pc = FFMA(pc, zz, FSET1(-1.388731625493765e-3f));
+	pc = FFMA(pc, zz, FSET1(4.166664568298827e-2f));
+	pc = FFMA(FMUL(pc, zz), zz, FSUB(one, FMUL(FSET1(0.5f), zz)));
+
+	/* Lower half of the circle flips the sine; octants 2 and 3 swap the polynomials and flip the cosine */
+	*s = FMUL(FSEL(hi, minus, one), FSEL(swap, pc, ps));
+	*c = FMUL(FSEL(hi, minus, one), FMUL(FSEL(swap, minus, one), FSEL(swap, ps, pc)));
+}
+
+/*
+------------------------------------------------------
+refractBlockFloat
+
+PURPOSE:		Compute refracted ground station coordinates for 2 VW points at a time
+INPUT ARGUMENTS:	Spacecraft coordinates (x,y,z), ground station coordinates (a,b,c),
+			cnt (points to load and store, at most 2 VW)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f)
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	vatanf, vsincosf
+NOTES:			Same model as refractBlock; the first cnt elements only are accessed
+------------------------------------------------------
+*/
+
+static KATTR void KFN(refractBlockFloat)(const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f, size_t cnt)
+{
+	const double shell = (double)EARTHRAD / (EARTHRAD + GS_HEIGHT);
+	const VD R = VSET1(EARTHRAD);
+	VD vx, vy, vz, va[2], vb[2], vc[2], dx[2], dy[2], dz[2], h[2], alt_sat, t, k;
+	FV fx, fy, fz, dist, zenAng, z_0, sz, cz, czed, u, dAng, linDisp, fk;
+	size_t half, m;
+
+	/* Projection, height and station to projection vector in double */
+	for (half = 0; half < 2; half++)
+	{
+		m = cnt > half * VW ? cnt - half * VW : 0;
+		if (m >= VW)
+		{
+			vx = VLOAD(x + half * VW);
+			vy = VLOAD(y + half * VW);
+			vz = VLOAD(z + half * VW);
+			va[half] = VLOAD(a + half * VW);
+			vb[half] = VLOAD(b + half * VW);
+			vc[half] = VLOAD(c + half * VW);
+		}
+		else
+		{
+			vx = VLOADM(x + half * VW, m);
+			vy = VLOADM(y + half * VW, m);
+			vz = VLOADM(z + half * VW, m);
+			va[half] = VLOADM(a + half * VW, m);
+			vb[half] = VLOADM(b + half * VW, m);
+			vc[half] = VLOADM(c + half * VW, m);
+		}
+		alt_sat = VSQRT(VFMA(vx, vx, VFMA(vy, vy, VMUL(vz, vz))));
+		t = VDIV(R, alt_sat);
+		h[half] = VSUB(alt_sat, R);
+		dx[half] = VFMA(t, vx, VSUB(VSET1(0.0), va[half]));
+		dy[half] = VFMA(t, vy, VSUB(VSET1(0.0), vb[half]));
+		dz[half] = VFMA(t, vz, VSUB(VSET1(0.0), vc[half]));
+	}
+
+	/* Zenith angle, central angle and angular displacement in float */
+	fx = FPACK(dx[0], dx[1]);
+	fy = FPACK(dy[0], dy[1]);
+	fz = FPACK(dz[0], dz[1]);
+	dist = FSQRT(FFMA(fx, fx, FFMA(fy, fy, FMUL(fz, fz))));
+	zenAng = KFN(vatanf)(FDIV(dist, FPACK(h[0], h[1])));
+	z_0 = FFMA(dist, FSET1((float)(1.0 / EARTHRAD)), zenAng);
+	KFN(vsincosf)(z_0, &sz, &cz);
+	czed = FSQRT(FFMA(FMUL(cz, cz), FSET1((float)(shell * shell)), FSET1((float)(1.0 - shell * shell))));
+	u = FDIV(FMUL(sz, FSET1((float)(1.0 - shell * shell))), FFMA(FABS(cz), FSET1((float)shell), czed));
+	dAng = FFMA(FMUL(u, FMUL(u, u)), FSET1(1.0f / 6.0f), u);
+
+	/* Below the horizon, zed is the refracted angle of the mirrored pi - z_0 */
+	dAng = FSEL(FLT(cz, FSET1(0.0f)), FADD(dAng, FFMA(FSET1(2.0f), z_0, FSET1(-3.14159265f))), dAng);
+
+	linDisp = FMUL(FSET1((float)EARTHRAD), dAng);
+	fk = FSEL(FEQ(linDisp, FSET1(0.0f)), FSET1(0.0f), FDIV(linDisp, dist));
+
+	/* Translate the ground station towards the satellite projection in double */
+	for (half = 0; half < 2; half++)
+	{
+		m = cnt > half * VW ? cnt - half * VW : 0;
+		k = half == 0 ? FLO(fk) : FHI(fk);
+		if (m >= VW)
+		{
+			VSTORE(d + half * VW, VFMA(k, dx[half], va[half]));
+			VSTORE(e + half * VW, VFMA(k, dy[half], vb[half]));
+			VSTORE(f + half * VW, VFMA(k, dz[half], vc[half]));
+		}
+		else if (m > 0)
+		{
+			VSTOREM(d + half * VW, VFMA(k, dx[half], va[half]), m);
+			VSTOREM(e + half * VW, VFMA(k, dy[half], vb[half]), m);
+			VSTOREM(f + half * VW, VFMA(k, dz[half], vc[half]), m);
+		}
+	}
+}
+
+/* Run refractBlockFloat over n points */
+
+static KATTR void KFN(refractKernelFloat)(size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	size_t i;
+
+	for (i = 0; i < n; i += 2 * VW)
+	{
+		KFN(refractBlockFloat)(x + i, y + i, z + i, a + i, b + i, c + i, d + i, e + i, f + i,
+			n - i < 2 * VW ? n - i : 2 * VW);
+	}
+}
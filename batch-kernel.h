@@ -0,0 +1,364 @@
+/*
+------------------------------------------------------
+batch-kernel.h
+
+Vector kernels for refractBatch, refractBatchStations and refractBatchWgs84, written once against a small set of macros and
+included by batch.c once per instruction set. The including file must define:
+
+VD, VM			vector of doubles and vector comparison mask types
+VW			number of doubles per vector
+KFN(name)		decorates a function name with the instruction set suffix
+KATTR			function attributes required to use the instruction set
+VSET1, VLOAD, VSTORE	broadcast, unaligned load and unaligned store
+VLOADM, VSTOREM		load/store of the first rem elements only (rem < VW)
+VADD, VSUB, VMUL, VDIV, VSQRT, VABS, VFLOOR
+VFMA(a, b, c)		a * b + c
+VGT, VLT, VEQ		ordered comparisons returning VM
+VMAND, VMANDNOT		mask and, mask and-not (first & ~second)
+VSEL(m, a, b)		a where m is set, b elsewhere
+
+and include geodesy.h for the WGS84 constants.
+
+The transcendental functions follow the Cephes double precision implementations
+(S. Moshier) and agree with the C library to within a few ulp over the range
+of arguments produced by the refraction geometry.
+------------------------------------------------------
+*/
+
+/*
+------------------------------------------------------
+vatan
+
+PURPOSE:		Vector arctangent
+INPUT ARGUMENTS:	x
+RETURNED VALUE:		atan(x) in each lane
+FUNCTIONS CALLED:	None
+NOTES:			Range reduction to |x| <= 0.66 followed by a 4/5 rational approximation
+------------------------------------------------------
+*/
+
+static KATTR VD KFN(vatan)(VD x)
+{
+	const VD zero = VSET1(0.0);
+	VD ax, xr, y0, more, zz, p, q, r;
+	VM big, mid, neg;
+
+	neg = VLT(x, zero);
+	ax = VABS(x);
+
+	/* Range reduction: tan(3pi/8) and 0.66 thresholds */
+	big = VGT(ax, VSET1(2.41421356237309504880));
+	mid = VMANDNOT(VGT(ax, VSET1(0.66)), big);
+
+	xr = VSEL(big, VDIV(VSET1(-1.0), ax),
+		VSEL(mid, VDIV(VSUB(ax, VSET1(1.0)), VADD(ax, VSET1(1.0))), ax));
+	y0 = VSEL(big, VSET1(1.57079632679489661923),
+		VSEL(mid, VSET1(0.78539816339744830962), zero));
+	more = VSEL(big, VSET1(6.123233995736765886130E-17),
+		VSEL(mid, VSET1(3.061616997868382943065E-17), zero));
+
+	zz = VMUL(xr, xr);
+	p = VSET1(-8.750608600031904122785E-1);
+	p = VFMA(p, zz, VSET1(-1.615753718733365076637E1));
+	p = VFMA(p, zz, VSET1(-7.500855792314704667340E1));
+	p = VFMA(p, zz, VSET1(-1.228866684490136173410E2));
+	p = VFMA(p, zz, VSET1(-6.485021904942025371773E1));
+	q = VADD(zz, VSET1(2.485846490142306297962E1));
+	q = VFMA(q, zz, VSET1(1.650270098316988542046E2));
+	q = VFMA(q, zz, VSET1(4.328810604912902668951E2));
+	q = VFMA(q, zz, VSET1(4.853903996359136964868E2));
+	q = VFMA(q, zz, VSET1(1.945506571482613964425E2));
+
+	r = VDIV(VMUL(zz, p), q);
+	r = VFMA(xr, r, xr);
+	r = VADD(VADD(y0, r), more);
+
+	return VSEL(neg, VSUB(zero, r), r);
+}
+
+/*
+------------------------------------------------------
+vsin
+
+PURPOSE:		Vector sine
+INPUT ARGUMENTS:	x, in radians
+RETURNED VALUE:		sin(x) in each lane
+FUNCTIONS CALLED:	None
+NOTES:			Reduction modulo pi/4 with a three part (Cody-Waite) pi/4,
+			then the sine or cosine polynomial depending on the octant
+------------------------------------------------------
+*/
+
+static KATTR VD KFN(vsin)(VD x)
+{
+	const VD zero = VSET1(0.0);
+	VD ax, sgn, j, j8, zr, zz, ps, pc, r;
+	VM odd, hi, usecos;
+
+	sgn = VSEL(VLT(x, zero), VSET1(-1.0), VSET1(1.0));
+	ax = VABS(x);
+
+	/* Octant of the argument, rounded up to an even octant */
+	j = VFLOOR(VMUL(ax, VSET1(1.27323954473516268615)));
+	odd = VEQ(VSUB(j, VMUL(VSET1(2.0), VFLOOR(VMUL(j, VSET1(0.5))))), VSET1(1.0));
+	j = VSEL(odd, VADD(j, VSET1(1.0)), j);
+	j8 = VSUB(j, VMUL(VSET1(8.0), VFLOOR(VMUL(j, VSET1(0.125)))));
+
+	/* Lower half of the circle flips the sign */
+	hi = VGT(j8, VSET1(3.0));
+	sgn = VSEL(hi, VSUB(zero, sgn), sgn);
+	j8 = VSEL(hi, VSUB(j8, VSET1(4.0)), j8);
+	usecos = VGT(j8, VSET1(1.0));
+
+	/* Extended precision modular arithmetic */
+	zr = VSUB(ax, VMUL(j, VSET1(7.85398125648498535156E-1)));
+	zr = VSUB(zr, VMUL(j, VSET1(3.77489470793079817668E-8)));
+	zr = VSUB(zr, VMUL(j, VSET1(2.69515142907905952645E-15)));
+	zz = VMUL(zr, zr);
+
+	ps = VSET1(1.58962301576546568060E-10);
+	ps = VFMA(ps, zz, VSET1(-2.50507477628578072866E-8));
+	ps = VFMA(ps, zz, VSET1(2.75573136213857245213E-6));
+	ps = VFMA(ps, zz, VSET1(-1.98412698295895385996E-4));
+	ps = VFMA(ps, zz, VSET1(8.33333333332211858878E-3));
+	ps = VFMA(ps, zz, VSET1(-1.66666666666666307295E-1));
+	ps = VFMA(VMUL(zr, zz), ps, zr);
+
+	pc = VSET1(-1.13585365213876817300E-11);
+	pc = VFMA(pc, zz, VSET1(2.08757008419747316778E-9));
+	pc = VFMA(pc, zz, VSET1(-2.75573141792967388112E-7));
+	pc = VFMA(pc, zz, VSET1(2.48015872888517045348E-5));
+	pc = VFMA(pc, zz, VSET1(-1.38888888888730564116E-3));
+	pc = VFMA(pc, zz, VSET1(4.16666666666665929218E-2));
+	pc = VFMA(VMUL(zz, zz), pc, VSUB(VSET1(1.0), VMUL(VSET1(0.5), zz)));
+
+	r = VSEL(usecos, pc, ps);
+	return VMUL(sgn, r);
+}
+
+/*
+------------------------------------------------------
+refractBlockProjected
+
+PURPOSE:		Compute refracted ground station coordinates for VW points at a time,
+			given the spacecraft projection
+INPUT ARGUMENTS:	Spacecraft projection (px,py,pz), spacecraft height above the surface,
+			ground station coordinates (a,b,c)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f)
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	vatan, vsin
+NOTES:			Same model as zenithAngle and deltaAngle
+------------------------------------------------------
+*/
+
+static KATTR void KFN(refractBlockProjected)(VD px, VD py, VD pz, VD height, VD a, VD b, VD c, VD *d, VD *e, VD *f)
+{
+	const VD R = VSET1(EARTHRAD);
+	VD dx, dy, dz, dist, zenAng, theta, z_0, s, zed, dAng, linDisp, k;
+	VM still;
+
+	/* Distance from the projection to the unrefracted ground station */
+	dx = VSUB(px, a);
+	dy = VSUB(py, b);
+	dz = VSUB(pz, c);
+	dist = VSQRT(VFMA(dx, dx, VFMA(dy, dy, VMUL(dz, dz))));
+
+	/* Zenith angle, central angle and angular displacement */
+	zenAng = KFN(vatan)(VDIV(dist, height));
+	theta = VDIV(dist, R);
+	z_0 = VADD(zenAng, theta);
+	s = VMUL(KFN(vsin)(z_0), VSET1((double)EARTHRAD / (EARTHRAD + GS_HEIGHT)));
+	zed = KFN(vatan)(VDIV(s, VSQRT(VSUB(VSET1(1.0), VMUL(s, s)))));
+	dAng = VSUB(z_0, zed);
+
+	/* Translate the ground station towards the satellite projection */
+	linDisp = VMUL(R, dAng);
+	still = VEQ(linDisp, VSET1(0.0));
+	k = VDIV(linDisp, dist);
+	*d = VSEL(still, a, VFMA(k, dx, a));
+	*e = VSEL(still, b, VFMA(k, dy, b));
+	*f = VSEL(still, c, VFMA(k, dz, c));
+}
+
+/*
+------------------------------------------------------
+refractBlock
+
+PURPOSE:		Compute refracted ground station coordinates for VW points at a time
+INPUT ARGUMENTS:	Spacecraft coordinates (x,y,z) and ground station coordinates (a,b,c)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f)
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	refractBlockProjected
+NOTES:			Same model as satProjection, zenithAngle and deltaAngle.
+------------------------------------------------------
+*/
+
+static KATTR void KFN(refractBlock)(VD x, VD y, VD z, VD a, VD b, VD c, VD *d, VD *e, VD *f)
+{
+	const VD R = VSET1(EARTHRAD);
+	VD alt_sat, t;
+
+	/* Satellite projection onto the Earth surface */
+	alt_sat = VSQRT(VFMA(x, x, VFMA(y, y, VMUL(z, z))));
+	t = VDIV(R, alt_sat);
+	KFN(refractBlockProjected)(VMUL(t, x), VMUL(t, y), VMUL(t, z), VSUB(alt_sat, R), a, b, c, d, e, f);
+}
+
+/*
+------------------------------------------------------
+refractBlockWgs84
+
+PURPOSE:		Compute refracted ground station coordinates for VW points at a time on the WGS84 ellipsoid
+INPUT ARGUMENTS:	Spacecraft coordinates (x,y,z) and ground station coordinates (a,b,c)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f)
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	vatan, vsin
+NOTES:			Same model as refractPointModel with EARTH_WGS84 (wgs84Foot, wgs84Radius)
+------------------------------------------------------
+*/
+
+static KATTR void KFN(refractBlockWgs84)(VD x, VD y, VD z, VD a, VD b, VD c, VD *d, VD *e, VD *f)
+{
+	const VD one = VSET1(1.0), e2 = VSET1(WGS84_E2), e4 = VSET1(WGS84_E2 * WGS84_E2);
+	VD rho2, p, q, r, s, ss, u, v2, v, h, w, uv, den, root, g, k, ik, ike, ke2, height, px, py, pz, nxy2, radius;
+	VD dx, dy, dz, dist, zenAng, theta, z_0, sz, zed, dAng, linDisp, kd;
+	VM still;
+
+	/* Vermeille's k for the spacecraft, as vermeilleK */
+	rho2 = VFMA(x, x, VMUL(y, y));
+	p = VMUL(rho2, VSET1(1.0 / (WGS84_A * WGS84_A)));
+	q = VMUL(VMUL(z, z), VSET1((1.0 - WGS84_E2) / (WGS84_A * WGS84_A)));
+	r = VMUL(VSUB(VADD(p, q), e4), VSET1(1.0 / 6.0));
+	s = VDIV(VMUL(VMUL(e4, p), q), VMUL(VMUL(VSET1(4.0), r), VMUL(r, r)));
+	ss = VMUL(s, s);
+	u = VFMA(ss, VFMA(s, VSET1(4576.0 / 4782969), VSET1(-160.0 / 59049)), VFMA(s, VSET1(56.0 / 6561), VSET1(-8.0 / 243)));
+	u = VMUL(r, VFMA(ss, u, VFMA(s, VSET1(2.0 / 9), VSET1(3.0))));
+	v2 = VFMA(u, u, VMUL(e4, q));
+	h = VMUL(VMUL(e2, VSUB(u, q)), VDIV(VSET1(0.5), v2));
+	v = VSQRT(v2);
+	w = VFMA(h, v, VSET1(0.5 * WGS84_E2));
+	uv = VADD(u, v);
+	den = VADD(uv, VFMA(VSET1(2.0 * WGS84_E2), w, VSET1(-WGS84_E2 * WGS84_E2)));
+	g = VDIV(one, VMUL(uv, den));
+	root = VSQRT(VFMA(w, w, uv));
+	ik = VMUL(VMUL(VADD(root, w), den), g);
+	ike = VMUL(VMUL(VADD(root, VSUB(w, e2)), uv), g);
+	k = VSUB(root, w);
+
+	/* Foot of the normal and geodetic height, as wgs84Foot */
+	px = VMUL(x, ike);
+	py = VMUL(y, ike);
+	pz = VMUL(VMUL(z, VSET1(1.0 - WGS84_E2)), ik);
+	ke2 = VADD(k, e2);
+	height = VMUL(VMUL(VMUL(VADD(k, VSET1(WGS84_E2 - 1.0)), ik), ike),
+		VSQRT(VFMA(VMUL(k, k), rho2, VMUL(VMUL(ke2, ke2), VMUL(z, z)))));
+
+	/* Gaussian radius under the station, as wgs84Radius */
+	nxy2 = VMUL(VFMA(a, a, VMUL(b, b)), VSET1((1.0 - WGS84_E2) * (1.0 - WGS84_E2)));
+	radius = VDIV(VMUL(VSET1(WGS84_A * (1.0 - WGS84_F)), VFMA(c, c, nxy2)),
+		VFMA(VMUL(c, c), VSET1(1.0 - WGS84_E2), nxy2));
+
+	/* Zenith angle, central angle and angular displacement as in refractBlockProjected */
+	dx = VSUB(px, a);
+	dy = VSUB(py, b);
+	dz = VSUB(pz, c);
+	dist = VSQRT(VFMA(dx, dx, VFMA(dy, dy, VMUL(dz, dz))));
+	zenAng = KFN(vatan)(VDIV(dist, height));
+	theta = VDIV(dist, radius);
+	z_0 = VADD(zenAng, theta);
+	sz = VDIV(VMUL(KFN(vsin)(z_0), radius), VADD(radius, VSET1(GS_HEIGHT)));
+	zed = KFN(vatan)(VDIV(sz, VSQRT(VSUB(one, VMUL(sz, sz)))));
+	dAng = VSUB(z_0, zed);
+
+	linDisp = VMUL(radius, dAng);
+	still = VEQ(linDisp, VSET1(0.0));
+	kd = VDIV(linDisp, dist);
+	*d = VSEL(still, a, VFMA(kd, dx, a));
+	*e = VSEL(still, b, VFMA(kd, dy, b));
+	*f = VSEL(still, c, VFMA(kd, dz, c));
+}
+
+/* Run refractBlock over n points. The final partial vector uses masked loads and stores,
+   so every element goes through the same instructions regardless of n. */
+
+static KATTR void KFN(refractKernel)(size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	VD vd, ve, vf;
+	size_t i, rem;
+
+	for (i = 0; i + VW <= n; i += VW)
+	{
+		KFN(refractBlock)(VLOAD(x + i), VLOAD(y + i), VLOAD(z + i),
+			VLOAD(a + i), VLOAD(b + i), VLOAD(c + i), &vd, &ve, &vf);
+		VSTORE(d + i, vd);
+		VSTORE(e + i, ve);
+		VSTORE(f + i, vf);
+	}
+
+	rem = n - i;
+	if (rem > 0)
+	{
+		KFN(refractBlock)(VLOADM(x + i, rem), VLOADM(y + i, rem), VLOADM(z + i, rem),
+			VLOADM(a + i, rem), VLOADM(b + i, rem), VLOADM(c + i, rem), &vd, &ve, &vf);
+		VSTOREM(d + i, vd, rem);
+		VSTOREM(e + i, ve, rem);
+		VSTOREM(f + i, vf, rem);
+	}
+}
+
+/* One spacecraft, already projected, against n ground stations */
+
+static KATTR void KFN(refractStationsKernel)(double px, double py, double pz, double height, size_t n,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	const VD vx = VSET1(px), vy = VSET1(py), vz = VSET1(pz), vh = VSET1(height);
+	VD vd, ve, vf;
+	size_t i, rem;
+
+	for (i = 0; i + VW <= n; i += VW)
+	{
+		KFN(refractBlockProjected)(vx, vy, vz, vh, VLOAD(a + i), VLOAD(b + i), VLOAD(c + i), &vd, &ve, &vf);
+		VSTORE(d + i, vd);
+		VSTORE(e + i, ve);
+		VSTORE(f + i, vf);
+	}
+
+	rem = n - i;
+	if (rem > 0)
+	{
+		KFN(refractBlockProjected)(vx, vy, vz, vh, VLOADM(a + i, rem), VLOADM(b + i, rem), VLOADM(c + i, rem),
+			&vd, &ve, &vf);
+		VSTOREM(d + i, vd, rem);
+		VSTOREM(e + i, ve, rem);
+		VSTOREM(f + i, vf, rem);
+	}
+}
+
+/* refractBlockWgs84 over n points, the tail as in refractKernel */
+
+static KATTR void KFN(refractKernelWgs84)(size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	VD vd, ve, vf;
+	size_t i, rem;
+
+	for (i = 0; i + VW <= n; i += VW)
+	{
+		KFN(refractBlockWgs84)(VLOAD(x + i), VLOAD(y + i), VLOAD(z + i),
+			VLOAD(a + i), VLOAD(b + i), VLOAD(c + i), &vd, &ve, &vf);
+		VSTORE(d + i, vd);
+		VSTORE(e + i, ve);
+		VSTORE(f + i, vf);
+	}
+
+	rem = n - i;
+	if (rem > 0)
+	{
+		KFN(refractBlockWgs84)(VLOADM(x + i, rem), VLOADM(y + i, rem), VLOADM(z + i, rem),
+			VLOADM(a + i, rem), VLOADM(b + i, rem), VLOADM(c + i, rem), &vd, &ve, &vf);
+		VSTOREM(d + i, vd, rem);
+		VSTOREM(e + i, ve, rem);
+		VSTOREM(f + i, vf, rem);
+	}
+}
@@ -0,0 +1,661 @@
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "refraction.h"
+#include "geodesy.h"
+
+/*
+------------------------------------------------------
+batch.c
+
+Structure-of-arrays entry point for correcting many ground station points at once.
+The spacecraft coordinates (x,y,z), ground station coordinates (a,b,c) and
+refracted ground station coordinates (d,e,f) are passed as separate arrays.
+
+An AVX-512 or AVX2 kernel is selected at runtime from the CPU features, with a
+scalar kernel as the fallback. The environment variable REFRACTION_KERNEL
+(scalar, avx2 or avx512) restricts the selection, e.g. for comparing kernels.
+
+refractBatchFloat runs the same model with the angular chain in float
+(batch-kernel-float.h), for uses such as visibility planning where millimetres
+do not matter. refractBatchWgs84 runs it on the WGS84 ellipsoid (geodesy.c).
+------------------------------------------------------
+*/
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+enum { KERNEL_SCALAR, KERNEL_AVX2, KERNEL_AVX512 };
+
+static void refractKernel_scalar(size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		refractPoint(x[i], y[i], z[i], a[i], b[i], c[i], &d[i], &e[i], &f[i], NULL);
+	}
+}
+
+/* One projected spacecraft against n stations, with the expressions of refractPointModel */
+static void refractStationsKernel_scalar(double px, double py, double pz, double height, size_t n,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	double dx, dy, dz, dist, z_0, dAng, linearDisplacement;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		dx = px - a[i];
+		dy = py - b[i];
+		dz = pz - c[i];
+		dist = sqrt(dx * dx + dy * dy + dz * dz);
+		z_0 = atan(dist / height) + dist / EARTHRAD;
+		dAng = z_0 - asin((sin(z_0) * EARTHRAD) / (EARTHRAD + GS_HEIGHT));
+		linearDisplacement = EARTHRAD * dAng;
+		if (linearDisplacement == 0.0)
+		{
+			d[i] = a[i];
+			e[i] = b[i];
+			f[i] = c[i];
+		}
+		else
+		{
+			d[i] = a[i] + (linearDisplacement / dist) * dx;
+			e[i] = b[i] + (linearDisplacement / dist) * dy;
+			f[i] = c[i] + (linearDisplacement / dist) * dz;
+		}
+	}
+}
+
+/* The refracting shell at GS_HEIGHT on the WGS84 ellipsoid, one point at a time */
+static void refractKernelWgs84_scalar(size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	static const struct refractModel wgs84 = { ATMOS_SHELL, GS_HEIGHT, NULL, NULL, EARTH_WGS84 };
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		refractPointModel(&wgs84, x[i], y[i], z[i], a[i], b[i], c[i], &d[i], &e[i], &f[i], NULL);
+	}
+}
+
+/* Mixed precision counterpart of refractBlockFloat, one point at a time */
+static void refractKernelFloat_scalar(size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	const double shell = (double)EARTHRAD / (EARTHRAD + GS_HEIGHT);
+	const float k2 = (float)(shell * shell), rest = (float)(1.0 - shell * shell);
+	double alt_sat, t, dx, dy, dz, k;
+	float dist, z_0, sz, cz, u, dAng;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		alt_sat = sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+		t = EARTHRAD / alt_sat;
+		dx = t * x[i] - a[i];
+		dy = t * y[i] - b[i];
+		dz = t * z[i] - c[i];
+		dist = sqrtf((float)dx * (float)dx + (float)dy * (float)dy + (float)dz * (float)dz);
+		z_0 = atanf(dist / (float)(alt_sat - EARTHRAD)) + dist * (float)(1.0 / EARTHRAD);
+		sz = sinf(z_0);
+		cz = cosf(z_0);
+		u = sz * rest / (sqrtf(rest + k2 * cz * cz) + (float)shell * fabsf(cz));
+		dAng = u + u * u * u * (1.0f / 6.0f);
+		if (cz < 0.0f)
+		{
+			dAng += 2.0f * z_0 - 3.14159265f;
+		}
+		k = dAng == 0.0f ? 0.0 : (double)(EARTHRAD * dAng / dist);
+		d[i] = a[i] + k * dx;
+		e[i] = b[i] + k * dy;
+		f[i] = c[i] + k * dz;
+	}
+}
+
+#ifdef HAVE_X86_KERNELS
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+/*
+AVX2 kernel: 4 doubles per vector, masks held as vectors
+*/
+#define VD __m256d
+#define VM __m256d
+#define VW 4
+#define KFN(name) name##_avx2
+#define KATTR TARGET_AVX2
+#define VSET1(v) _mm256_set1_pd(v)
+#define VLOAD(p) _mm256_loadu_pd(p)
+#define VSTORE(p, v) _mm256_storeu_pd(p, v)
+#define VTAILMASK(rem) _mm256_cmpgt_epi64(_mm256_set1_epi64x((long long)(rem)), _mm256_setr_epi64x(0, 1, 2, 3))
+#define VLOADM(p, rem) _mm256_maskload_pd(p, VTAILMASK(rem))
+#define VSTOREM(p, v, rem) _mm256_maskstore_pd(p, VTAILMASK(rem), v)
+#define VADD _mm256_add_pd
+#define VSUB _mm256_sub_pd
+#define VMUL _mm256_mul_pd
+#define VDIV _mm256_div_pd
+#define VSQRT _mm256_sqrt_pd
+#define VABS(v) _mm256_andnot_pd(_mm256_set1_pd(-0.0), v)
+#define VFLOOR _mm256_floor_pd
+#define VFMA _mm256_fmadd_pd
+#define VGT(u, v) _mm256_cmp_pd(u, v, _CMP_GT_OQ)
+#define VLT(u, v) _mm256_cmp_pd(u, v, _CMP_LT_OQ)
+#define VEQ(u, v) _mm256_cmp_pd(u, v, _CMP_EQ_OQ)
+#define VMAND _mm256_and_pd
+#define VMANDNOT(m1, m2) _mm256_andnot_pd(m2, m1)
+#define VSEL(m, u, v) _mm256_blendv_pd(v, u, m)
+#define FV __m256
+#define FM __m256
+#define FSET1(v) _mm256_set1_ps(v)
+#define FADD _mm256_add_ps
+#define FSUB _mm256_sub_ps
+#define FMUL _mm256_mul_ps
+#define FDIV _mm256_div_ps
+#define FSQRT _mm256_sqrt_ps
+#define FABS(v) _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v)
+#define FFLOOR _mm256_floor_ps
+#define FFMA _mm256_fmadd_ps
+#define FGT(u, v) _mm256_cmp_ps(u, v, _CMP_GT_OQ)
+#define FLT(u, v) _mm256_cmp_ps(u, v, _CMP_LT_OQ)
+#define FEQ(u, v) _mm256_cmp_ps(u, v, _CMP_EQ_OQ)
+#define FSEL(m, u, v) _mm256_blendv_ps(v, u, m)
+#define FPACK(lo, hi) _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1)
+#define FLO(v) _mm256_cvtps_pd(_mm256_castps256_ps128(v))
+#define FHI(v) _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1))
+#include "batch-kernel.h"
+#include "batch-kernel-float.h"
+#undef VD
+#undef VM
+#undef VW
+#undef KFN
+#undef KATTR
+#undef VSET1
+#undef VLOAD
+#undef VSTORE
+#undef VLOADM
+#undef VSTOREM
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VDIV
+#undef VSQRT
+#undef VABS
+#undef VFLOOR
+#undef VFMA
+#undef VGT
+#undef VLT
+#undef VEQ
+#undef VMAND
+#undef VMANDNOT
+#undef VSEL
+#undef FV
+#undef FM
+#undef FSET1
+#undef FADD
+#undef FSUB
+#undef FMUL
+#undef FDIV
+#undef FSQRT
+#undef FABS
+#undef FFLOOR
+#undef FFMA
+#undef FGT
+#undef FLT
+#undef FEQ
+#undef FSEL
+#undef FPACK
+#undef FLO
+#undef FHI
+
+/*
+AVX-512 kernel: 8 doubles per vector, masks held in mask registers
+*/
+#define VD __m512d
+#define VM __mmask8
+#define VW 8
+#define KFN(name) name##_avx512
+#define KATTR TARGET_AVX512
+#define VSET1(v) _mm512_set1_pd(v)
+#define VLOAD(p) _mm512_loadu_pd(p)
+#define VSTORE(p, v) _mm512_storeu_pd(p, v)
+#define VLOADM(p, rem) _mm512_maskz_loadu_pd((__mmask8)((1u << (rem)) - 1), p)
+#define VSTOREM(p, v, rem) _mm512_mask_storeu_pd(p, (__mmask8)((1u << (rem)) - 1), v)
+#define VADD _mm512_add_pd
+#define VSUB _mm512_sub_pd
+#define VMUL _mm512_mul_pd
+#define VDIV _mm512_div_pd
+#define VSQRT _mm512_sqrt_pd
+#define VABS _mm512_abs_pd
+#define VFLOOR(v) _mm512_roundscale_pd(v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)
+#define VFMA _mm512_fmadd_pd
+#define VGT(u, v) _mm512_cmp_pd_mask(u, v, _CMP_GT_OQ)
+#define VLT(u, v) _mm512_cmp_pd_mask(u, v, _CMP_LT_OQ)
+#define VEQ(u, v) _mm512_cmp_pd_mask(u, v, _CMP_EQ_OQ)
+#define VMAND(m1, m2) ((__mmask8)((m1) & (m2)))
+#define VMANDNOT(m1, m2) ((__mmask8)((m1) & ~(m2)))
+#define VSEL(m, u, v) _mm512_mask_blend_pd(m, v, u)
+#define FV __m512
+#define FM __mmask16
+#define FSET1(v) _mm512_set1_ps(v)
+#define FADD _mm512_add_ps
+#define FSUB _mm512_sub_ps
+#define FMUL _mm512_mul_ps
+#define FDIV _mm512_div_ps
+#define FSQRT _mm512_sqrt_ps
+#define FABS _mm512_abs_ps
+#define FFLOOR(v) _mm512_roundscale_ps(v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)
+#define FFMA _mm512_fmadd_ps
+#define FGT(u, v) _mm512_cmp_ps_mask(u, v, _CMP_GT_OQ)
+#define FLT(u, v) _mm512_cmp_ps_mask(u, v, _CMP_LT_OQ)
+#define FEQ(u, v) _mm512_cmp_ps_mask(u, v, _CMP_EQ_OQ)
+#define FSEL(m, u, v) _mm512_mask_blend_ps(m, v, u)
+#define FPACK(lo, hi) _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(_mm512_cvtpd_ps(lo))), \
+	_mm256_castps_pd(_mm512_cvtpd_ps(hi)), 1))
+#define FLO(v) _mm512_cvtps_pd(_mm512_castps512_ps256(v))
+#define FHI(v) _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1)))
+#include "batch-kernel.h"
+#include "batch-kernel-float.h"
+
+/* Query the CPU for AVX2+FMA and AVX-512F support, including OS support for the wider registers */
+static int cpuKernelSupport(void)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return KERNEL_AVX512;
+	}
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+	{
+		return KERNEL_AVX2;
+	}
+	return KERNEL_SCALAR;
+#else
+	int info[4];
+	unsigned long long xcr0;
+	int level = KERNEL_SCALAR;
+
+	__cpuid(info, 1);
+	if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 12)))	// OSXSAVE, FMA
+	{
+		return KERNEL_SCALAR;
+	}
+	xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+	if ((xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)))		// YMM state, AVX2
+	{
+		level = KERNEL_AVX2;
+	}
+	if ((xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16)))		// ZMM state, AVX-512F
+	{
+		level = KERNEL_AVX512;
+	}
+	return level;
+#endif
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+/*
+------------------------------------------------------
+selectKernel
+
+PURPOSE:		Choose the widest kernel supported by the CPU and allowed by REFRACTION_KERNEL
+INPUT ARGUMENTS:	None
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		KERNEL_SCALAR, KERNEL_AVX2 or KERNEL_AVX512
+FUNCTIONS CALLED:	cpuKernelSupport, getenv
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The choice is made on the first call and kept; the CPU check and getenv
+			cost about as much as a 1-point batch
+------------------------------------------------------
+*/
+
+static int selectKernel(void)
+{
+	static _Atomic int selected = -1;
+	int level = atomic_load_explicit(&selected, memory_order_relaxed);
+	const char *limit;
+
+	if (level >= 0)
+	{
+		return level;
+	}
+
+	level = KERNEL_SCALAR;
+#ifdef HAVE_X86_KERNELS
+	level = cpuKernelSupport();
+#endif
+
+	limit = getenv("REFRACTION_KERNEL");
+	if (limit != NULL)
+	{
+		if (strcmp(limit, "scalar") == 0)
+		{
+			level = KERNEL_SCALAR;
+		}
+		else if (strcmp(limit, "avx2") == 0 && level > KERNEL_AVX2)
+		{
+			level = KERNEL_AVX2;
+		}
+	}
+	atomic_store_explicit(&selected, level, memory_order_relaxed);
+
+	return level;
+}
+
+/*
+------------------------------------------------------
+refractBatch
+
+PURPOSE:		Compute refracted ground station coordinates for n points
+INPUT ARGUMENTS:	n, spacecraft coordinates (x,y,z) and ground station coordinates (a,b,c) as arrays
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f) as arrays
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	refractKernel_avx512, refractKernel_avx2, refractKernel_scalar, selectKernel
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The arrays need no particular alignment. Output arrays must not overlap the inputs.
+------------------------------------------------------
+*/
+
+void refractBatch(size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	switch (selectKernel())
+	{
+#ifdef HAVE_X86_KERNELS
+	case KERNEL_AVX512:
+		refractKernel_avx512(n, x, y, z, a, b, c, d, e, f);
+		break;
+	case KERNEL_AVX2:
+		refractKernel_avx2(n, x, y, z, a, b, c, d, e, f);
+		break;
+#endif
+	default:
+		refractKernel_scalar(n, x, y, z, a, b, c, d, e, f);
+		break;
+	}
+
+	return;
+}
+
+/*
+------------------------------------------------------
+refractBatchStations
+
+PURPOSE:		Compute refracted ground station coordinates for one spacecraft and n stations
+INPUT ARGUMENTS:	Spacecraft coordinates (x,y,z), n, ground station coordinates (a,b,c) as arrays
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f) as arrays
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	fma, refractStationsKernel_avx512, refractStationsKernel_avx2,
+			refractStationsKernel_scalar, selectKernel, sqrt
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The spacecraft radius and projection are computed once for all n stations.
+			Results are bit-identical to refractBatch with (x,y,z) repeated n times.
+------------------------------------------------------
+*/
+
+void refractBatchStations(double x, double y, double z, size_t n,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	double alt_sat, t;
+	int kernel = selectKernel();
+
+#ifdef HAVE_X86_KERNELS
+	if (kernel != KERNEL_SCALAR)
+	{
+		/* Radius rounded as in the vector kernels */
+		alt_sat = sqrt(fma(x, x, fma(y, y, z * z)));
+		t = EARTHRAD / alt_sat;
+		if (kernel == KERNEL_AVX512)
+		{
+			refractStationsKernel_avx512(t * x, t * y, t * z, alt_sat - EARTHRAD, n, a, b, c, d, e, f);
+		}
+		else
+		{
+			refractStationsKernel_avx2(t * x, t * y, t * z, alt_sat - EARTHRAD, n, a, b, c, d, e, f);
+		}
+		return;
+	}
+#endif
+
+	alt_sat = sqrt(x * x + y * y + z * z);
+	t = EARTHRAD / alt_sat;
+	refractStationsKernel_scalar(t * x, t * y, t * z, alt_sat - EARTHRAD, n, a, b, c, d, e, f);
+	(void)kernel;
+
+	return;
+}
+
+/*
+------------------------------------------------------
+refractBatchWgs84
+
+PURPOSE:		Compute refracted ground station coordinates for n points on the WGS84 ellipsoid
+INPUT ARGUMENTS:	n, spacecraft coordinates (x,y,z) and ground station coordinates (a,b,c) as arrays
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f) as arrays
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	refractKernelWgs84_avx512, refractKernelWgs84_avx2, refractKernelWgs84_scalar,
+			selectKernel
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Same arrays as refractBatch; the model of refractPointModel with ATMOS_SHELL
+			at GS_HEIGHT and EARTH_WGS84
+------------------------------------------------------
+*/
+
+void refractBatchWgs84(size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	switch (selectKernel())
+	{
+#ifdef HAVE_X86_KERNELS
+	case KERNEL_AVX512:
+		refractKernelWgs84_avx512(n, x, y, z, a, b, c, d, e, f);
+		break;
+	case KERNEL_AVX2:
+		refractKernelWgs84_avx2(n, x, y, z, a, b, c, d, e, f);
+		break;
+#endif
+	default:
+		refractKernelWgs84_scalar(n, x, y, z, a, b, c, d, e, f);
+		break;
+	}
+
+	return;
+}
+
+/*
+------------------------------------------------------
+refractBatchFloat
+
+PURPOSE:		Compute refracted ground station coordinates for n points in mixed precision
+INPUT ARGUMENTS:	n, spacecraft coordinates (x,y,z) and ground station coordinates (a,b,c) as arrays
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f) as arrays
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	refractKernelFloat_avx512, refractKernelFloat_avx2, refractKernelFloat_scalar,
+			selectKernel
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Same model and arrays as refractBatch. The angular displacement is computed in
+			float, twice as many points per vector; coordinates stay in double.
+			refractBatchFloatCheck measures the difference from refractBatch.
+------------------------------------------------------
+*/
+
+void refractBatchFloat(size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	switch (selectKernel())
+	{
+#ifdef HAVE_X86_KERNELS
+	case KERNEL_AVX512:
+		refractKernelFloat_avx512(n, x, y, z, a, b, c, d, e, f);
+		break;
+	case KERNEL_AVX2:
+		refractKernelFloat_avx2(n, x, y, z, a, b, c, d, e, f);
+		break;
+#endif
+	default:
+		refractKernelFloat_scalar(n, x, y, z, a, b, c, d, e, f);
+		break;
+	}
+
+	return;
+}
+
+/* Wall clock time in seconds, for the timings of refractBatchFloatCheck */
+static double checkClock(void)
+{
+	struct timespec ts;
+
+	timespec_get(&ts, TIME_UTC);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+------------------------------------------------------
+refractBatchFloatCheck
+
+PURPOSE:		Compare refractBatchFloat with refractBatch over a sweep of zenith angles
+INPUT ARGUMENTS:	height (spacecraft height above the Earth surface, in metres),
+			zMax (largest zenith angle of the spacecraft at the station, in radians),
+			samples (points of the sweep)
+OUTPUT ARGUMENTS:	chk
+RETURNED VALUE:		0 on success, -1 if out of memory
+FUNCTIONS CALLED:	checkClock, refractBatch, refractBatchFloat
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Stations lie on the Earth surface at scattered latitudes and longitudes, and
+			the spacecraft at scattered azimuths, so that no coordinate is special.
+------------------------------------------------------
+*/
+
+int refractBatchFloatCheck(double height, double zMax, size_t samples, struct refractFloatCheck *chk)
+{
+	double *buf, *x, *y, *z, *a, *b, *c, *d, *e, *f, *d32, *e32, *f32;
+	double lat, lon, az, zen, up[3], dir[3], rho, err, sum = 0.0, t0, t1, t2;
+	const double R = EARTHRAD;
+	size_t i;
+
+	memset(chk, 0, sizeof(*chk));
+	if (samples < 2)
+	{
+		samples = 2;
+	}
+	buf = malloc(12 * samples * sizeof(double));
+	if (buf == NULL)
+	{
+		return -1;
+	}
+	x = buf;
+	y = x + samples;
+	z = y + samples;
+	a = z + samples;
+	b = a + samples;
+	c = b + samples;
+	d = c + samples;
+	e = d + samples;
+	f = e + samples;
+	d32 = f + samples;
+	e32 = d32 + samples;
+	f32 = e32 + samples;
+
+	for (i = 0; i < samples; i++)
+	{
+		/* Low discrepancy station position and azimuth */
+		lat = asin(2.0 * fmod(i * 0.6180339887498949, 1.0) - 1.0);
+		lon = 2.0 * PI * fmod(i * 0.7548776662466927, 1.0);
+		az = 2.0 * PI * fmod(i * 0.5698402909980532, 1.0);
+		zen = zMax * i / (samples - 1);
+
+		up[0] = cos(lat) * cos(lon);
+		up[1] = cos(lat) * sin(lon);
+		up[2] = sin(lat);
+		dir[0] = cos(zen) * up[0] + sin(zen) * (-cos(az) * sin(lon) - sin(az) * sin(lat) * cos(lon));
+		dir[1] = cos(zen) * up[1] + sin(zen) * (cos(az) * cos(lon) - sin(az) * sin(lat) * sin(lon));
+		dir[2] = cos(zen) * up[2] + sin(zen) * sin(az) * cos(lat);
+
+		/* Range along dir from the station to the sphere of radius R + height */
+		rho = -R * cos(zen) + sqrt(R * R * cos(zen) * cos(zen) + height * (2.0 * R + height));
+		a[i] = R * up[0];
+		b[i] = R * up[1];
+		c[i] = R * up[2];
+		x[i] = a[i] + rho * dir[0];
+		y[i] = b[i] + rho * dir[1];
+		z[i] = c[i] + rho * dir[2];
+	}
+
+	t0 = checkClock();
+	refractBatch(samples, x, y, z, a, b, c, d, e, f);
+	t1 = checkClock();
+	refractBatchFloat(samples, x, y, z, a, b, c, d32, e32, f32);
+	t2 = checkClock();
+
+	for (i = 0; i < samples; i++)
+	{
+		err = sqrt((d32[i] - d[i]) * (d32[i] - d[i]) + (e32[i] - e[i]) * (e32[i] - e[i])
+			+ (f32[i] - f[i]) * (f32[i] - f[i]));
+		sum += err;
+		if (!(err <= chk->maxError))
+		{
+			chk->maxError = err;
+			chk->zAtMax = zMax * i / (samples - 1);
+		}
+	}
+	chk->samples = samples;
+	chk->meanError = sum / samples;
+	chk->nsDouble = (t1 - t0) * 1e9 / samples;
+	chk->nsFloat = (t2 - t1) * 1e9 / samples;
+
+	free(buf);
+	return 0;
+}
+
+/*
+------------------------------------------------------
+refractBatchKernel
+
+PURPOSE:		Report which kernel refractBatch will use on this machine
+INPUT ARGUMENTS:	None
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		"avx512", "avx2" or "scalar"
+FUNCTIONS CALLED:	selectKernel
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:
+------------------------------------------------------
+*/
+
+const char *refractBatchKernel(void)
+{
+	switch (selectKernel())
+	{
+	case KERNEL_AVX512:
+		return "avx512";
+	case KERNEL_AVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
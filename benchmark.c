@@ -0,0 +1,486 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "refraction.h"
+#include "pool.h"
+
+/*
+------------------------------------------------------
+benchmark.c
+
+Timing harness for the refraction functions.
+
+Per point functions (satProjection, zenithAngle, refractiveIndex, deltaAngle),
+the original per-point call chain of main (chainPoint), refractPoint and
+refractPointModel on the WGS84 ellipsoid are timed over every combination of
+spacecraft altitude (ALTITUDES) and zenith band (ZEN_BANDS bands of 10 degrees
+over 0-90). refractBatch, refractPoolBatch and refractBatchWgs84 are timed for
+batch sizes of 1, 10, ... up to the maximum batch size.
+
+Each measurement is run once to warm up and then repeated; the best and the
+median repetition are reported as ns/point and points/s. With -j the results
+are written as JSON, one result object per line. With -b they are compared
+against a baseline written by an earlier -j run: a result more than the
+tolerance slower than its baseline (by median) is a regression, and the
+exit status is 2.
+
+BUILD:			refraction.c must be compiled with -DREFRACTION_TRACE=0 -DREFRACTION_NO_MAIN,
+			otherwise the functions are timed together with their printf output.
+			Link with approx.c, batch.c, geodesy.c, pool.c, raytrace.c and trace.c.
+USAGE:			benchmark [-n points] [-r repetitions] [-m max batch] [-p threads]
+				[-j results.json] [-b baseline.json] [-t tolerance %]
+------------------------------------------------------
+*/
+
+#define ALTITUDES 4
+#define ZEN_BANDS 9
+#define BATCH_TARGET 1000000    // Points computed per repetition of a batch size measurement
+#define MAX_REPS 64
+#define MAX_RESULTS 512
+#define NAME_LEN 64
+
+static const double altitude[ALTITUDES] = { 400e3, 800e3, 20200e3, 35786e3 };  // LEO, polar LEO, GPS, GEO; in metres
+
+struct points
+{
+	size_t n;
+	double *x, *y, *z, *a, *b, *c, *d, *e, *f;
+};
+
+struct result
+{
+	char name[NAME_LEN];
+	size_t points;                  // Points per repetition
+	int reps;
+	double best, median;            // ns/point
+};
+
+struct bench
+{
+	struct result res[MAX_RESULTS];
+	int nres;
+	int reps;
+	int threads;
+	struct refractPool *pool;
+};
+
+static volatile double sink;            // Keeps the results of the scalar loops alive
+
+static double nowSeconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+------------------------------------------------------
+chainPoint
+
+PURPOSE:		The per-point glue of the original main, without its output
+INPUT ARGUMENTS:	Spacecraft coordinates (x,y,z) and ground station coordinates (a,b,c)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (*d,*e,*f)
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	deltaAngle, fabs, pow, satProjection, sqrt
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:
+------------------------------------------------------
+*/
+
+static void chainPoint(double x, double y, double z, double a, double b, double c,
+	double *d, double *e, double *f)
+{
+	double satProj_x, satProj_y, satProj_z, projSatGSDiff_x, projSatGSDiff_y, projSatGSDiff_z,
+		distProjSat2GS, dAng, linearDisplacement;
+
+	satProjection(x, y, z, &satProj_x, &satProj_y, &satProj_z);
+	projSatGSDiff_x = fabs(a - satProj_x);
+	projSatGSDiff_y = fabs(b - satProj_y);
+	projSatGSDiff_z = fabs(c - satProj_z);
+	distProjSat2GS = sqrt(pow((satProj_x - a), 2) + pow((satProj_y - b), 2) + pow((satProj_z - c), 2));
+	dAng = deltaAngle(x, y, z, a, b, c);
+	linearDisplacement = EARTHRAD * dAng;
+
+	if (linearDisplacement == 0.0)
+	{
+		*d = a;
+		*e = b;
+		*f = c;
+		return;
+	}
+	*d = satProj_x > a ? a + (linearDisplacement / distProjSat2GS) * projSatGSDiff_x
+		: a - (linearDisplacement / distProjSat2GS) * projSatGSDiff_x;
+	*e = satProj_y > b ? b + (linearDisplacement / distProjSat2GS) * projSatGSDiff_y
+		: b - (linearDisplacement / distProjSat2GS) * projSatGSDiff_y;
+	*f = satProj_z > c ? c + (linearDisplacement / distProjSat2GS) * projSatGSDiff_z
+		: c - (linearDisplacement / distProjSat2GS) * projSatGSDiff_z;
+}
+
+static void allocPoints(struct points *p, size_t n)
+{
+	p->n = n;
+	p->x = malloc(9 * n * sizeof(double));
+	if (p->x == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	p->y = p->x + n;
+	p->z = p->y + n;
+	p->a = p->z + n;
+	p->b = p->a + n;
+	p->c = p->b + n;
+	p->d = p->c + n;
+	p->e = p->d + n;
+	p->f = p->e + n;
+}
+
+/*
+Ground stations spread over the sphere, each with a spacecraft at altitude alt
+and a zenith angle in [zenMin, zenMax) degrees
+*/
+static void makePoints(struct points *p, double alt, double zenMin, double zenMax, unsigned seed)
+{
+	double lon, lat, zen, off, az, ux, uy, uz, ex, ey, nx, ny, nz, sx, sy, sz, rs;
+	size_t i;
+
+	srand(seed);
+	rs = EARTHRAD + alt;
+	for (i = 0; i < p->n; i++)
+	{
+		lon = 2 * PI * rand() / RAND_MAX;
+		lat = asin(2.0 * rand() / RAND_MAX - 1);
+		zen = (zenMin + (zenMax - zenMin) * rand() / ((double)RAND_MAX + 1)) * PI / 180;
+		az = 2 * PI * rand() / RAND_MAX;
+
+		ux = cos(lat) * cos(lon);
+		uy = cos(lat) * sin(lon);
+		uz = sin(lat);
+		p->a[i] = EARTHRAD * ux;
+		p->b[i] = EARTHRAD * uy;
+		p->c[i] = EARTHRAD * uz;
+
+		/* Central angle at which the spacecraft is seen at zenith angle zen from the station */
+		off = zen - asin(EARTHRAD * sin(zen) / rs);
+		ex = -sin(lon);
+		ey = cos(lon);
+		nx = -sin(lat) * cos(lon);
+		ny = -sin(lat) * sin(lon);
+		nz = cos(lat);
+		sx = cos(off) * ux + sin(off) * (cos(az) * ex + sin(az) * nx);
+		sy = cos(off) * uy + sin(off) * (cos(az) * ey + sin(az) * ny);
+		sz = cos(off) * uz + sin(off) * sin(az) * nz;
+		p->x[i] = rs * sx;
+		p->y[i] = rs * sy;
+		p->z[i] = rs * sz;
+	}
+}
+
+/* One pass of a per point function over all points, in seconds */
+static double runPoints(int fn, struct points *p)
+{
+	static const struct refractModel wgs84 = { ATMOS_SHELL, GS_HEIGHT, NULL, NULL, EARTH_WGS84 };
+	double t0, acc = 0.0, sx, sy, sz, dist;
+	size_t i;
+
+	t0 = nowSeconds();
+	for (i = 0; i < p->n; i++)
+	{
+		switch (fn)
+		{
+		case 0:
+			satProjection(p->x[i], p->y[i], p->z[i], &sx, &sy, &sz);
+			acc += sx + sy + sz;
+			break;
+		case 1:
+			acc += zenithAngle(p->x[i], p->y[i], p->z[i], p->a[i], p->b[i], p->c[i], &dist);
+			break;
+		case 2:
+			acc += refractiveIndex(p->a[i], p->b[i], p->c[i]);
+			break;
+		case 3:
+			acc += deltaAngle(p->x[i], p->y[i], p->z[i], p->a[i], p->b[i], p->c[i]);
+			break;
+		case 4:
+			chainPoint(p->x[i], p->y[i], p->z[i], p->a[i], p->b[i], p->c[i], &p->d[i], &p->e[i], &p->f[i]);
+			break;
+		case 5:
+			refractPoint(p->x[i], p->y[i], p->z[i], p->a[i], p->b[i], p->c[i], &p->d[i], &p->e[i], &p->f[i], NULL);
+			break;
+		default:
+			refractPointModel(&wgs84, p->x[i], p->y[i], p->z[i], p->a[i], p->b[i], p->c[i],
+				&p->d[i], &p->e[i], &p->f[i], NULL);
+			break;
+		}
+	}
+	t0 = nowSeconds() - t0;
+	sink = acc;
+
+	return t0;
+}
+
+/* iters calls of refractBatch (or refractPoolBatch, or refractBatchWgs84) over the first size points, in seconds */
+static double runBatch(struct refractPool *pool, int wgs84, struct points *p, size_t size, size_t iters)
+{
+	double t0 = nowSeconds();
+	size_t k;
+
+	for (k = 0; k < iters; k++)
+	{
+		if (pool != NULL)
+		{
+			refractPoolBatch(pool, size, p->x, p->y, p->z, p->a, p->b, p->c, p->d, p->e, p->f);
+		}
+		else if (wgs84)
+		{
+			refractBatchWgs84(size, p->x, p->y, p->z, p->a, p->b, p->c, p->d, p->e, p->f);
+		}
+		else
+		{
+			refractBatch(size, p->x, p->y, p->z, p->a, p->b, p->c, p->d, p->e, p->f);
+		}
+	}
+
+	return nowSeconds() - t0;
+}
+
+static int compareDouble(const void *l, const void *r)
+{
+	double a = *(const double *)l, b = *(const double *)r;
+
+	return a < b ? -1 : a > b;
+}
+
+/* Record a measurement from the times of its repetitions */
+static void addResult(struct bench *bn, const char *name, size_t points, double *t)
+{
+	struct result *r;
+
+	if (bn->nres == MAX_RESULTS)
+	{
+		return;
+	}
+	r = &bn->res[bn->nres++];
+	snprintf(r->name, NAME_LEN, "%s", name);
+	r->points = points;
+	r->reps = bn->reps;
+	qsort(t, (size_t)bn->reps, sizeof(double), compareDouble);
+	r->best = t[0] / points * 1e9;
+	r->median = t[bn->reps / 2] / points * 1e9;
+	printf("%-40s %10.2f %10.2f %14.0f\n", r->name, r->best, r->median, 1e9 / r->median);
+}
+
+static void benchPoints(struct bench *bn, size_t n)
+{
+	static const char *fnName[] = { "satProjection", "zenithAngle", "refractiveIndex", "deltaAngle",
+		"chain", "refractPoint", "refractPointWgs84" };
+	struct points p;
+	double t[MAX_REPS];
+	char name[NAME_LEN];
+	int ia, iz, fn, r;
+
+	allocPoints(&p, n);
+	for (ia = 0; ia < ALTITUDES; ia++)
+	{
+		for (iz = 0; iz < ZEN_BANDS; iz++)
+		{
+			makePoints(&p, altitude[ia], 10.0 * iz, 10.0 * (iz + 1), 1);
+			for (fn = 0; fn < 7; fn++)
+			{
+				runPoints(fn, &p);
+				for (r = 0; r < bn->reps; r++)
+				{
+					t[r] = runPoints(fn, &p);
+				}
+				snprintf(name, NAME_LEN, "%s/alt=%.0fkm/zen=%d-%d", fnName[fn], altitude[ia] / 1000,
+					10 * iz, 10 * (iz + 1));
+				addResult(bn, name, n, t);
+			}
+		}
+	}
+	free(p.x);
+}
+
+static void benchBatch(struct bench *bn, size_t maxBatch)
+{
+	struct points p;
+	double t[MAX_REPS];
+	char name[NAME_LEN];
+	static const char *modeName[] = { "refractBatch", "refractPoolBatch", "refractBatchWgs84" };
+	struct refractPool *pool;
+	size_t size, iters;
+	int mode, r;
+
+	allocPoints(&p, maxBatch);
+	makePoints(&p, 500e3, 0.0, 80.0, 1);
+	for (mode = 0; mode < 3; mode++)
+	{
+		pool = mode == 1 ? bn->pool : NULL;
+		for (size = 1; size <= maxBatch; size *= 10)
+		{
+			iters = size < BATCH_TARGET ? BATCH_TARGET / size : 1;
+			runBatch(pool, mode == 2, &p, size, iters);
+			for (r = 0; r < bn->reps; r++)
+			{
+				t[r] = runBatch(pool, mode == 2, &p, size, iters);
+			}
+			snprintf(name, NAME_LEN, "%s/n=%zu", modeName[mode], size);
+			addResult(bn, name, size * iters, t);
+		}
+	}
+	free(p.x);
+}
+
+static int writeJson(const struct bench *bn, const char *path)
+{
+	FILE *fp = fopen(path, "w");
+	int i;
+
+	if (fp == NULL)
+	{
+		return -1;
+	}
+	fprintf(fp, "{\n\"kernel\": \"%s\",\n\"threads\": %d,\n\"results\": [\n", refractBatchKernel(), bn->threads);
+	for (i = 0; i < bn->nres; i++)
+	{
+		fprintf(fp, "{\"name\": \"%s\", \"points\": %zu, \"reps\": %d, \"ns_per_point\": %.4f, "
+			"\"ns_per_point_median\": %.4f, \"points_per_s\": %.0f}%s\n",
+			bn->res[i].name, bn->res[i].points, bn->res[i].reps, bn->res[i].best, bn->res[i].median,
+			1e9 / bn->res[i].median, i + 1 < bn->nres ? "," : "");
+	}
+	fprintf(fp, "]\n}\n");
+
+	return fclose(fp) == 0 ? 0 : -1;
+}
+
+/*
+Compare the medians with those of a baseline file written by writeJson;
+returns the number of regressions, or -1 if the baseline cannot be read
+*/
+static int compareBaseline(const struct bench *bn, const char *path, double tolerance)
+{
+	char line[512], name[NAME_LEN];
+	const char *s;
+	double base, ratio;
+	int i, matched = 0, regressions = 0;
+	FILE *fp = fopen(path, "r");
+
+	if (fp == NULL)
+	{
+		return -1;
+	}
+	printf("\n%-40s %10s %10s %8s\n", "baseline comparison", "base ns", "now ns", "ratio");
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		s = strstr(line, "\"ns_per_point_median\": ");
+		if (sscanf(line, "{\"name\": \"%63[^\"]\"", name) != 1 || s == NULL
+			|| sscanf(s + strlen("\"ns_per_point_median\": "), "%lf", &base) != 1)
+		{
+			continue;
+		}
+		for (i = 0; i < bn->nres && strcmp(bn->res[i].name, name) != 0; i++)
+		{
+		}
+		if (i == bn->nres)
+		{
+			continue;
+		}
+		matched++;
+		ratio = bn->res[i].median / base;
+		if (ratio > 1.0 + tolerance / 100)
+		{
+			regressions++;
+			printf("%-40s %10.2f %10.2f %8.2f  REGRESSION\n", name, base, bn->res[i].median, ratio);
+		}
+	}
+	fclose(fp);
+	printf("%d results compared, %d slower than baseline by more than %.1f%%\n", matched, regressions, tolerance);
+
+	return regressions;
+}
+
+int main(int argc, char **argv)
+{
+	static struct bench bn;
+	const char *jsonPath = NULL, *basePath = NULL;
+	size_t n = 65536, maxBatch = 10000000;
+	double tolerance = 10.0;
+	int threads = 0, i, regressions = 0;
+
+	bn.reps = 5;
+	for (i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-n") == 0)
+		{
+			n = strtoul(argv[i + 1], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-r") == 0)
+		{
+			bn.reps = atoi(argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "-m") == 0)
+		{
+			maxBatch = strtoul(argv[i + 1], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-p") == 0)
+		{
+			threads = atoi(argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "-j") == 0)
+		{
+			jsonPath = argv[i + 1];
+		}
+		else if (strcmp(argv[i], "-b") == 0)
+		{
+			basePath = argv[i + 1];
+		}
+		else if (strcmp(argv[i], "-t") == 0)
+		{
+			tolerance = atof(argv[i + 1]);
+		}
+		else
+		{
+			break;
+		}
+	}
+	if (i < argc || n == 0 || maxBatch == 0 || bn.reps < 1 || bn.reps > MAX_REPS)
+	{
+		fprintf(stderr, "usage: benchmark [-n points] [-r repetitions (1-%d)] [-m max batch] [-p threads]\n"
+			"                 [-j results.json] [-b baseline.json] [-t tolerance %%]\n", MAX_REPS);
+		return 1;
+	}
+
+	bn.pool = refractPoolCreate(threads);
+	if (bn.pool == NULL)
+	{
+		fprintf(stderr, "cannot start %d threads\n", threads);
+		return 1;
+	}
+	bn.threads = refractPoolThreads(bn.pool);
+	printf("kernel %s, %d threads, %zu points, best and median of %d\n", refractBatchKernel(), bn.threads, n, bn.reps);
+	printf("%-40s %10s %10s %14s\n", "", "best ns", "median ns", "points/s");
+	benchPoints(&bn, n);
+	benchBatch(&bn, maxBatch);
+	refractPoolDestroy(bn.pool);
+
+	if (jsonPath != NULL && writeJson(&bn, jsonPath) != 0)
+	{
+		fprintf(stderr, "cannot write %s\n", jsonPath);
+		return 1;
+	}
+	if (basePath != NULL)
+	{
+		regressions = compareBaseline(&bn, basePath, tolerance);
+		if (regressions < 0)
+		{
+			fprintf(stderr, "cannot read %s\n", basePath);
+			return 1;
+		}
+	}
+
+	return regressions > 0 ? 2 : 0;
+}
@@ -0,0 +1,535 @@
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "refraction.h"
+#include "dem.h"
+#include "geodesy.h"
+
+/*
+------------------------------------------------------
+dem.c
+
+Tiles are mapped read-only on first use and kept in a cache of at most maxTiles
+mappings. Every tile on the globe has an entry in a direct table (slot index,
+unknown or absent), so a lookup is one load under the cache mutex. The mapped
+slots form a doubly linked LRU list. A tile in use by a lookup run is pinned
+with a reference count, and the least recently used unpinned slot is unmapped
+when a new tile needs room. Heights are read from the mapping without copying;
+the kernel pages in the parts of a tile that are actually sampled.
+
+demHeights sorts each block of DEM_BATCH points by tile, unless they already come
+in tile order as consecutive samples of a pass do. Then every tile is pinned once
+per run of points instead of once per point.
+------------------------------------------------------
+*/
+
+#define SLOT_UNKNOWN -1         // Tile not looked for yet
+#define SLOT_ABSENT -2          // No file, or not a valid tile: sea level
+
+struct demTile
+{
+	const unsigned char *map;       // side * side big-endian heights
+	size_t size;
+	int side;
+	int key;                        // Index of the tile on the globe
+	int refs;                       // Lookup runs using the mapping
+	int prev, next;                 // LRU list, most recent first
+};
+
+struct demCache
+{
+	char *dir;
+	int maxTiles, used, head, tail;
+	struct demTile *tiles;
+	int slot[DEM_TILES];
+	uint64_t hits, maps, evictions;
+	pthread_mutex_t lock;
+};
+
+/* Tile index of the 1 degree cell holding (latDeg, lonDeg), and its south-west corner */
+static int tileKey(double latDeg, double lonDeg, int *latFloor, int *lonFloor)
+{
+	int la = (int)floor(latDeg), lo;
+
+	lonDeg = fmod(lonDeg + 180.0, 360.0);
+	if (lonDeg < 0.0)
+	{
+		lonDeg += 360.0;
+	}
+	lo = (int)floor(lonDeg) - 180;
+	la = la < -90 ? -90 : la > 89 ? 89 : la;
+	lo = lo > 179 ? 179 : lo;
+	*latFloor = la;
+	*lonFloor = lo;
+	return (la + 90) * 360 + lo + 180;
+}
+
+static void lruUnlink(struct demCache *dem, int s)
+{
+	struct demTile *t = &dem->tiles[s];
+
+	if (t->prev >= 0)
+	{
+		dem->tiles[t->prev].next = t->next;
+	}
+	else
+	{
+		dem->head = t->next;
+	}
+	if (t->next >= 0)
+	{
+		dem->tiles[t->next].prev = t->prev;
+	}
+	else
+	{
+		dem->tail = t->prev;
+	}
+}
+
+static void lruPushFront(struct demCache *dem, int s)
+{
+	struct demTile *t = &dem->tiles[s];
+
+	t->prev = -1;
+	t->next = dem->head;
+	if (dem->head >= 0)
+	{
+		dem->tiles[dem->head].prev = s;
+	}
+	dem->head = s;
+	if (dem->tail < 0)
+	{
+		dem->tail = s;
+	}
+}
+
+static void lruPushBack(struct demCache *dem, int s)
+{
+	struct demTile *t = &dem->tiles[s];
+
+	t->next = -1;
+	t->prev = dem->tail;
+	if (dem->tail >= 0)
+	{
+		dem->tiles[dem->tail].next = s;
+	}
+	dem->tail = s;
+	if (dem->head < 0)
+	{
+		dem->head = s;
+	}
+}
+
+/* Map the file of tile key into t; -1 if there is no valid file */
+static int mapTile(const struct demCache *dem, int key, struct demTile *t)
+{
+	char path[4096];
+	struct stat st;
+	int la = key / 360 - 90, lo = key % 360 - 180, fd;
+	void *map;
+
+	snprintf(path, sizeof(path), "%s/%c%02d%c%03d.hgt", dem->dir, la < 0 ? 'S' : 'N', abs(la),
+		lo < 0 ? 'W' : 'E', abs(lo));
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return -1;
+	}
+	if (fstat(fd, &st) != 0 || (st.st_size != 1201 * 1201 * 2 && st.st_size != 3601 * 3601 * 2))
+	{
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		return -1;
+	}
+	t->map = map;
+	t->size = (size_t)st.st_size;
+	t->side = st.st_size == 1201 * 1201 * 2 ? 1201 : 3601;
+	t->key = key;
+	t->refs = 0;
+	return 0;
+}
+
+/*
+Pin tile key and return it, or NULL with *full clear if it has no data (sea level),
+or NULL with *full set if every slot is pinned by other runs
+*/
+static const struct demTile *acquire(struct demCache *dem, int key, int *full)
+{
+	struct demTile *t = NULL;
+	int s;
+
+	*full = 0;
+	pthread_mutex_lock(&dem->lock);
+	s = dem->slot[key];
+	if (s >= 0)
+	{
+		dem->hits++;
+	}
+	else if (s == SLOT_UNKNOWN)
+	{
+		/* A new slot, or the least recently used unpinned one */
+		if (dem->used < dem->maxTiles)
+		{
+			s = dem->used++;
+		}
+		else
+		{
+			for (s = dem->tail; s >= 0 && dem->tiles[s].refs > 0; s = dem->tiles[s].prev)
+			{
+			}
+			if (s >= 0)
+			{
+				lruUnlink(dem, s);
+				if (dem->tiles[s].map != NULL)
+				{
+					munmap((void *)dem->tiles[s].map, dem->tiles[s].size);
+					dem->slot[dem->tiles[s].key] = SLOT_UNKNOWN;
+					dem->evictions++;
+				}
+			}
+		}
+		if (s < 0)
+		{
+			*full = 1;
+		}
+		else if (mapTile(dem, key, &dem->tiles[s]) == 0)
+		{
+			dem->slot[key] = s;
+			dem->maps++;
+			lruPushFront(dem, s);
+		}
+		else
+		{
+			/* Keep the slot empty at the back of the list, first to be reused */
+			dem->tiles[s].map = NULL;
+			dem->tiles[s].refs = 0;
+			lruPushBack(dem, s);
+			dem->slot[key] = SLOT_ABSENT;
+			s = SLOT_ABSENT;
+		}
+	}
+	if (s >= 0)
+	{
+		t = &dem->tiles[s];
+		t->refs++;
+		if (dem->head != s)
+		{
+			lruUnlink(dem, s);
+			lruPushFront(dem, s);
+		}
+	}
+	pthread_mutex_unlock(&dem->lock);
+
+	return t;
+}
+
+static void release(struct demCache *dem, const struct demTile *t)
+{
+	if (t != NULL)
+	{
+		pthread_mutex_lock(&dem->lock);
+		dem->tiles[t - dem->tiles].refs--;
+		pthread_mutex_unlock(&dem->lock);
+	}
+}
+
+/* Bilinear height in tile t, void samples left out of the weights; 0 if all four are void */
+static double sampleTile(const struct demTile *t, double latDeg, double lonDeg, int latFloor, int lonFloor)
+{
+	const unsigned char *p;
+	double fy, fx, w[4], h[4], sum = 0.0, wsum = 0.0;
+	int row, col, i, v;
+
+	if (t == NULL)
+	{
+		return 0.0;
+	}
+	fy = (latFloor + 1 - latDeg) * (t->side - 1);
+	fx = (lonDeg - lonFloor) * (t->side - 1);
+	row = (int)fy;
+	col = (int)fx;
+	row = row < 0 ? 0 : row > t->side - 2 ? t->side - 2 : row;
+	col = col < 0 ? 0 : col > t->side - 2 ? t->side - 2 : col;
+	fy -= row;
+	fx -= col;
+	w[0] = (1.0 - fy) * (1.0 - fx);
+	w[1] = (1.0 - fy) * fx;
+	w[2] = fy * (1.0 - fx);
+	w[3] = fy * fx;
+
+	for (i = 0; i < 4; i++)
+	{
+		p = t->map + 2 * ((size_t)(row + (i >> 1)) * t->side + col + (i & 1));
+		v = (int16_t)((p[0] << 8) | p[1]);
+		h[i] = v;
+		if (v != DEM_VOID)
+		{
+			sum += w[i] * h[i];
+			wsum += w[i];
+		}
+	}
+	return wsum > 0.0 ? sum / wsum : 0.0;
+}
+
+/*
+------------------------------------------------------
+demOpen
+
+PURPOSE:		Create a tile cache over a directory of .hgt files
+INPUT ARGUMENTS:	dir, maxTiles (mappings kept at once)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		New cache, or NULL if memory could not be obtained
+FUNCTIONS CALLED:	calloc, malloc, pthread_mutex_init
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Tiles are opened lazily. maxTiles must be at least the number of threads
+			looking up heights at the same time; a 1 arc-second tile maps 25 MB.
+------------------------------------------------------
+*/
+
+struct demCache *demOpen(const char *dir, int maxTiles)
+{
+	struct demCache *dem;
+	int i;
+
+	if (maxTiles < 1)
+	{
+		return NULL;
+	}
+	dem = calloc(1, sizeof(*dem));
+	if (dem == NULL)
+	{
+		return NULL;
+	}
+	dem->dir = malloc(strlen(dir) + 1);
+	dem->tiles = calloc((size_t)maxTiles, sizeof(*dem->tiles));
+	if (dem->dir == NULL || dem->tiles == NULL)
+	{
+		free(dem->dir);
+		free(dem->tiles);
+		free(dem);
+		return NULL;
+	}
+	strcpy(dem->dir, dir);
+	dem->maxTiles = maxTiles;
+	dem->head = dem->tail = -1;
+	for (i = 0; i < DEM_TILES; i++)
+	{
+		dem->slot[i] = SLOT_UNKNOWN;
+	}
+	pthread_mutex_init(&dem->lock, NULL);
+
+	return dem;
+}
+
+void demClose(struct demCache *dem)
+{
+	int s;
+
+	if (dem == NULL)
+	{
+		return;
+	}
+	for (s = 0; s < dem->used; s++)
+	{
+		if (dem->tiles[s].map != NULL)
+		{
+			munmap((void *)dem->tiles[s].map, dem->tiles[s].size);
+		}
+	}
+	pthread_mutex_destroy(&dem->lock);
+	free(dem->tiles);
+	free(dem->dir);
+	free(dem);
+}
+
+/*
+------------------------------------------------------
+demHeight
+
+PURPOSE:		Terrain height at one point
+INPUT ARGUMENTS:	dem, WGS84 geodetic latitude and longitude in radians
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		Height above sea level in metres, bilinear between the four nearest samples;
+			NaN if no slot of the cache is free
+FUNCTIONS CALLED:	demHeights
+VER./DATE:		1.1 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Use demHeights for many points. The tiles are gridded in geodetic latitude;
+			the geocentric latitude is up to 0.19 degrees (21 km) south of it.
+------------------------------------------------------
+*/
+
+double demHeight(struct demCache *dem, double lat, double lon)
+{
+	double h;
+
+	demHeights(dem, 1, &lat, &lon, &h);
+
+	return h;
+}
+
+static int compareKey(const void *p, const void *q)
+{
+	uint64_t u = *(const uint64_t *)p, v = *(const uint64_t *)q;
+
+	return u < v ? -1 : u > v;
+}
+
+/*
+------------------------------------------------------
+demHeights
+
+PURPOSE:		Terrain heights at n points, looked up tile by tile
+INPUT ARGUMENTS:	dem, n, WGS84 geodetic latitudes and longitudes in radians as arrays
+OUTPUT ARGUMENTS:	h, heights above sea level in metres
+RETURNED VALUE:		0 on success, -1 if no slot of the cache was free for some tile
+			(the heights of its points are NaN)
+FUNCTIONS CALLED:	acquire, qsort, release, sampleTile, tileKey
+VER./DATE:		1.1 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Safe to call from several threads on one cache
+------------------------------------------------------
+*/
+
+int demHeights(struct demCache *dem, size_t n, const double *lat, const double *lon, double *h)
+{
+	uint64_t order[DEM_BATCH];
+	const struct demTile *t = NULL;
+	double latDeg, lonDeg;
+	size_t i0, m, k, j;
+	int latFloor, lonFloor, key, lastKey, sorted, full = 0, status = 0;
+
+	for (i0 = 0; i0 < n; i0 += DEM_BATCH)
+	{
+		m = n - i0 < DEM_BATCH ? n - i0 : DEM_BATCH;
+		sorted = 1;
+		for (k = 0; k < m; k++)
+		{
+			key = tileKey(lat[i0 + k] * 180.0 / PI, lon[i0 + k] * 180.0 / PI, &latFloor, &lonFloor);
+			order[k] = ((uint64_t)key << 32) | k;
+			sorted &= k == 0 || order[k] > order[k - 1];
+		}
+		if (!sorted)
+		{
+			qsort(order, m, sizeof(order[0]), compareKey);
+		}
+
+		lastKey = -1;
+		for (k = 0; k < m; k++)
+		{
+			key = (int)(order[k] >> 32);
+			j = i0 + (size_t)(order[k] & 0xffffffffu);
+			if (key != lastKey)
+			{
+				release(dem, t);
+				t = acquire(dem, key, &full);
+				lastKey = key;
+				status = full ? -1 : status;
+			}
+			latDeg = lat[j] * 180.0 / PI;
+			lonDeg = lon[j] * 180.0 / PI;
+			tileKey(latDeg, lonDeg, &latFloor, &lonFloor);
+			lonDeg = lonFloor + fmod(fmod(lonDeg - lonFloor, 360.0) + 360.0, 360.0);
+			h[j] = full ? NAN : sampleTile(t, latDeg, lonDeg, latFloor, lonFloor);
+		}
+		release(dem, t);
+		t = NULL;
+	}
+
+	return status;
+}
+
+/*
+------------------------------------------------------
+demCounters
+
+PURPOSE:		Report the cache activity since demOpen
+INPUT ARGUMENTS:	dem
+OUTPUT ARGUMENTS:	*hits (lookup runs served by a mapped tile), *maps (tiles mapped),
+			*evictions (tiles unmapped to make room)
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	None
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:
+------------------------------------------------------
+*/
+
+void demCounters(struct demCache *dem, uint64_t *hits, uint64_t *maps, uint64_t *evictions)
+{
+	pthread_mutex_lock(&dem->lock);
+	*hits = dem->hits;
+	*maps = dem->maps;
+	*evictions = dem->evictions;
+	pthread_mutex_unlock(&dem->lock);
+}
+
+/*
+------------------------------------------------------
+refractTerrainBatch
+
+PURPOSE:		Compute refracted ground station coordinates with the station height from the terrain
+INPUT ARGUMENTS:	dem, mast (height of the station above the terrain, in metres), n, spacecraft
+			coordinates (x,y,z) and ground station coordinates (a,b,c) as arrays
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f) as arrays
+RETURNED VALUE:		0 on success, -1 if memory could not be obtained or a tile could not be cached
+FUNCTIONS CALLED:	demHeights, geodeticFromCartesian, malloc, refractPointModel
+VER./DATE:		1.1 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The refracting shell of refractPointModel, at the terrain height under each
+			station plus mast instead of GS_HEIGHT. The station coordinates are used
+			as given; the terrain is looked up at their geodetic latitude and longitude.
+------------------------------------------------------
+*/
+
+int refractTerrainBatch(struct demCache *dem, double mast, size_t n, const double *x, const double *y,
+	const double *z, const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	struct refractModel model = { .atmos = ATMOS_SHELL, .stationHeight = 0.0, .profile = NULL, .table = NULL,
+		.earth = EARTH_SPHERE };
+	double *lat, *lon, *h, height;
+	size_t i0, m, k;
+	int status = 0;
+
+	lat = malloc(3 * DEM_BATCH * sizeof(double));
+	if (lat == NULL)
+	{
+		return -1;
+	}
+	lon = lat + DEM_BATCH;
+	h = lon + DEM_BATCH;
+
+	for (i0 = 0; i0 < n; i0 += DEM_BATCH)
+	{
+		m = n - i0 < DEM_BATCH ? n - i0 : DEM_BATCH;
+		for (k = 0; k < m; k++)
+		{
+			geodeticFromCartesian(a[i0 + k], b[i0 + k], c[i0 + k], &lat[k], &lon[k], &height);
+		}
+		if (demHeights(dem, m, lat, lon, h) != 0)
+		{
+			status = -1;
+		}
+		for (k = 0; k < m; k++)
+		{
+			model.stationHeight = h[k] + mast;
+			refractPointModel(&model, x[i0 + k], y[i0 + k], z[i0 + k], a[i0 + k], b[i0 + k], c[i0 + k],
+				&d[i0 + k], &e[i0 + k], &f[i0 + k], NULL);
+		}
+	}
+	free(lat);
+
+	return status;
+}
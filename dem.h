@@ -0,0 +1,39 @@
+#ifndef DEM_H
+#define DEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Terrain heights from a directory of SRTM-style elevation tiles
+
+Each tile covers 1 x 1 degree and is named after its south-west corner, e.g.
+N45W122.hgt for 45..46 N, 122..121 W. It holds side x side big-endian 16-bit
+heights in metres, rows from north to south, the edges shared with the
+neighbours; side is 1201 (3 arc-seconds) or 3601 (1 arc-second), from the
+file size. DEM_VOID marks a missing sample. A missing tile is sea level.
+Latitudes are WGS84 geodetic, as the tiles are gridded.
+*/
+#define DEM_VOID -32768         // Sample with no data
+#define DEM_TILES 64800         // 1 degree tiles on the globe
+#define DEM_BATCH 4096          // Points grouped by tile at a time by demHeights
+
+struct demCache;
+
+/*
+Function prototypes
+*/
+struct demCache *demOpen(const char *dir, int maxTiles);
+
+void demClose(struct demCache *dem);
+
+double demHeight(struct demCache *dem, double lat, double lon);
+
+int demHeights(struct demCache *dem, size_t n, const double *lat, const double *lon, double *h);
+
+void demCounters(struct demCache *dem, uint64_t *hits, uint64_t *maps, uint64_t *evictions);
+
+int refractTerrainBatch(struct demCache *dem, double mast, size_t n, const double *x, const double *y,
+	const double *z, const double *a, const double *b, const double *c, double *d, double *e, double *f);
+
+#endif
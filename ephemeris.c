@@ -0,0 +1,552 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "refraction.h"
+#include "ephemeris.h"
+#include "pool.h"
+#include "writer.h"
+
+/*
+------------------------------------------------------
+ephemeris.c
+
+Reading and writing the binary ephemeris format of ephemeris.h, and the
+streaming drivers that refract a whole input file into a matching output file
+or into a writer of writer.c.
+
+Input and output files are mapped with mmap, and the batch kernels read and write
+the mapped blocks in place: no point is copied on the way in or out. The blocks
+are processed WINDOW_BLOCKS at a time (one pool job per window). Once a window is
+done its pages are released from the process, so files larger than memory
+stream through a bounded working set while the kernel reads ahead.
+------------------------------------------------------
+*/
+
+#define WINDOW_BLOCKS 64        // Blocks per pool job, about 18 MB of input and output at EPHEM_BLOCK
+
+struct streamArg
+{
+	const struct ephemFile *in, *out;
+	double *scratch;                // Output of the window when out is NULL (3 columns per block)
+	size_t first;                   // First block of the window
+};
+
+static size_t fileSize(uint32_t nCols, uint64_t count, uint32_t blockPoints)
+{
+	size_t nBlocks = (size_t)((count + blockPoints - 1) / blockPoints);
+
+	return sizeof(struct ephemHeader) + nBlocks * blockPoints * nCols * sizeof(double);
+}
+
+/*
+------------------------------------------------------
+ephemOpen
+
+PURPOSE:		Map an ephemeris file for reading
+INPUT ARGUMENTS:	path
+OUTPUT ARGUMENTS:	*f
+RETURNED VALUE:		0 on success, -1 if the file is missing, malformed or truncated
+FUNCTIONS CALLED:	close, fstat, madvise, mmap, open
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The mapping is read-only and advised for sequential access
+------------------------------------------------------
+*/
+
+int ephemOpen(struct ephemFile *f, const char *path)
+{
+	const struct ephemHeader *hdr;
+	struct stat st;
+
+	f->base = NULL;
+	f->fd = open(path, O_RDONLY);
+	if (f->fd < 0)
+	{
+		return -1;
+	}
+	if (fstat(f->fd, &st) != 0 || (size_t)st.st_size < sizeof(struct ephemHeader))
+	{
+		close(f->fd);
+		return -1;
+	}
+	f->size = (size_t)st.st_size;
+	f->base = mmap(NULL, f->size, PROT_READ, MAP_SHARED, f->fd, 0);
+	if (f->base == MAP_FAILED)
+	{
+		f->base = NULL;
+		close(f->fd);
+		return -1;
+	}
+
+	hdr = (const struct ephemHeader *)f->base;
+	if (hdr->magic != EPHEM_MAGIC || hdr->version != EPHEM_VERSION
+		|| (hdr->nCols != EPHEM_IN_COLS && hdr->nCols != EPHEM_OUT_COLS)
+		|| hdr->blockPoints == 0 || hdr->blockPoints % 8 != 0
+		|| fileSize(hdr->nCols, hdr->count, hdr->blockPoints) != f->size)
+	{
+		ephemClose(f);
+		return -1;
+	}
+	f->count = hdr->count;
+	f->nCols = hdr->nCols;
+	f->blockPoints = hdr->blockPoints;
+	f->nBlocks = (size_t)((f->count + f->blockPoints - 1) / f->blockPoints);
+	f->writable = 0;
+	f->released = 0;
+	madvise(f->base, f->size, MADV_SEQUENTIAL);
+
+	return 0;
+}
+
+/*
+------------------------------------------------------
+ephemCreate
+
+PURPOSE:		Create an ephemeris file of count points and map it for writing
+INPUT ARGUMENTS:	path, nCols, count, blockPoints (0 for EPHEM_BLOCK)
+OUTPUT ARGUMENTS:	*f
+RETURNED VALUE:		0 on success, -1 on failure
+FUNCTIONS CALLED:	close, ftruncate, mmap, open
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The file is sized up front and left sparse; the blocks are filled
+			through ephemColumn
+------------------------------------------------------
+*/
+
+int ephemCreate(struct ephemFile *f, const char *path, uint32_t nCols, uint64_t count, uint32_t blockPoints)
+{
+	struct ephemHeader *hdr;
+
+	if (blockPoints == 0)
+	{
+		blockPoints = EPHEM_BLOCK;
+	}
+	f->base = NULL;
+	if ((nCols != EPHEM_IN_COLS && nCols != EPHEM_OUT_COLS) || blockPoints % 8 != 0)
+	{
+		return -1;
+	}
+	f->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (f->fd < 0)
+	{
+		return -1;
+	}
+	f->size = fileSize(nCols, count, blockPoints);
+	if (ftruncate(f->fd, (off_t)f->size) != 0)
+	{
+		close(f->fd);
+		return -1;
+	}
+	f->base = mmap(NULL, f->size, PROT_READ | PROT_WRITE, MAP_SHARED, f->fd, 0);
+	if (f->base == MAP_FAILED)
+	{
+		f->base = NULL;
+		close(f->fd);
+		return -1;
+	}
+
+	hdr = (struct ephemHeader *)f->base;
+	hdr->magic = EPHEM_MAGIC;
+	hdr->version = EPHEM_VERSION;
+	hdr->nCols = nCols;
+	hdr->blockPoints = blockPoints;
+	hdr->count = count;
+	hdr->earthRad = EARTHRAD;
+	f->count = count;
+	f->nCols = nCols;
+	f->blockPoints = blockPoints;
+	f->nBlocks = (size_t)((count + blockPoints - 1) / blockPoints);
+	f->writable = 1;
+	f->released = 0;
+
+	return 0;
+}
+
+/*
+------------------------------------------------------
+ephemClose
+
+PURPOSE:		Unmap and close a file opened by ephemOpen or ephemCreate
+INPUT ARGUMENTS:	f
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	close, munmap
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Written blocks reach the file through the page cache
+------------------------------------------------------
+*/
+
+void ephemClose(struct ephemFile *f)
+{
+	if (f->base != NULL)
+	{
+		munmap(f->base, f->size);
+		f->base = NULL;
+	}
+	close(f->fd);
+	f->fd = -1;
+}
+
+/*
+------------------------------------------------------
+ephemColumn
+
+PURPOSE:		Locate one column of one block in the mapping
+INPUT ARGUMENTS:	f, block, col (0..nCols-1, in the order of ephemeris.h)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		Pointer to blockPoints doubles
+FUNCTIONS CALLED:	None
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:
+------------------------------------------------------
+*/
+
+double *ephemColumn(const struct ephemFile *f, size_t block, int col)
+{
+	return (double *)(f->base + sizeof(struct ephemHeader)
+		+ (block * f->nCols + (size_t)col) * f->blockPoints * sizeof(double));
+}
+
+/* Number of valid points in a block; only the last block can be short */
+size_t ephemBlockLength(const struct ephemFile *f, size_t block)
+{
+	uint64_t first = (uint64_t)block * f->blockPoints;
+
+	return f->count - first < f->blockPoints ? (size_t)(f->count - first) : f->blockPoints;
+}
+
+/*
+------------------------------------------------------
+ephemRelease
+
+PURPOSE:		Drop the mapped pages of every block before block from the process
+INPUT ARGUMENTS:	f, block
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	madvise, msync
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The data stays in the file; pages written through a file from ephemCreate
+			are first queued for writeback. Pages are released whole, so the page
+			holding the start of block stays mapped.
+------------------------------------------------------
+*/
+
+void ephemRelease(struct ephemFile *f, size_t block)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t end = (size_t)((unsigned char *)ephemColumn(f, block, 0) - f->base) / page * page;
+
+	if (end <= f->released)
+	{
+		return;
+	}
+	if (f->writable)
+	{
+		msync(f->base + f->released, end - f->released, MS_ASYNC);
+	}
+	madvise(f->base + f->released, end - f->released, MADV_DONTNEED);
+	f->released = end;
+}
+
+/*
+------------------------------------------------------
+ephemWriterOpen
+
+PURPOSE:		Start writing an ephemeris file of unknown length
+INPUT ARGUMENTS:	path, nCols
+OUTPUT ARGUMENTS:	*w
+RETURNED VALUE:		0 on success, -1 on failure
+FUNCTIONS CALLED:	fopen, fwrite, malloc
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Points are added with ephemWriterAppend; ephemWriterClose completes the header
+------------------------------------------------------
+*/
+
+int ephemWriterOpen(struct ephemWriter *w, const char *path, uint32_t nCols)
+{
+	struct ephemHeader hdr;
+
+	memset(&hdr, 0, sizeof(hdr));
+	w->nCols = nCols;
+	w->count = 0;
+	w->fill = 0;
+	w->block = malloc((size_t)nCols * EPHEM_BLOCK * sizeof(double));
+	w->fp = w->block != NULL ? fopen(path, "wb") : NULL;
+	if (w->fp == NULL || fwrite(&hdr, sizeof(hdr), 1, w->fp) != 1)
+	{
+		if (w->fp != NULL)
+		{
+			fclose(w->fp);
+		}
+		free(w->block);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+------------------------------------------------------
+ephemWriterAppend
+
+PURPOSE:		Add n points to a file started with ephemWriterOpen
+INPUT ARGUMENTS:	w, n, cols (nCols column pointers of n values each)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		0 on success, -1 on a write error
+FUNCTIONS CALLED:	fwrite, memcpy
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:
+------------------------------------------------------
+*/
+
+int ephemWriterAppend(struct ephemWriter *w, size_t n, const double *const *cols)
+{
+	size_t done = 0, m;
+	uint32_t k;
+
+	while (done < n)
+	{
+		m = EPHEM_BLOCK - w->fill < n - done ? EPHEM_BLOCK - w->fill : n - done;
+		for (k = 0; k < w->nCols; k++)
+		{
+			memcpy(w->block + (size_t)k * EPHEM_BLOCK + w->fill, cols[k] + done, m * sizeof(double));
+		}
+		w->fill += m;
+		w->count += m;
+		done += m;
+
+		if (w->fill == EPHEM_BLOCK)
+		{
+			if (fwrite(w->block, sizeof(double), (size_t)w->nCols * EPHEM_BLOCK, w->fp) != (size_t)w->nCols * EPHEM_BLOCK)
+			{
+				return -1;
+			}
+			w->fill = 0;
+		}
+	}
+
+	return 0;
+}
+
+/*
+------------------------------------------------------
+ephemWriterClose
+
+PURPOSE:		Write the last, padded block and the header, and close the file
+INPUT ARGUMENTS:	w
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		0 on success, -1 on a write error
+FUNCTIONS CALLED:	fclose, fseek, fwrite, memset
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:
+------------------------------------------------------
+*/
+
+int ephemWriterClose(struct ephemWriter *w)
+{
+	struct ephemHeader hdr;
+	uint32_t k;
+	int ok = 1;
+
+	if (w->fill > 0)
+	{
+		for (k = 0; k < w->nCols; k++)
+		{
+			memset(w->block + (size_t)k * EPHEM_BLOCK + w->fill, 0, (EPHEM_BLOCK - w->fill) * sizeof(double));
+		}
+		ok = fwrite(w->block, sizeof(double), (size_t)w->nCols * EPHEM_BLOCK, w->fp) == (size_t)w->nCols * EPHEM_BLOCK;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = EPHEM_MAGIC;
+	hdr.version = EPHEM_VERSION;
+	hdr.nCols = w->nCols;
+	hdr.blockPoints = EPHEM_BLOCK;
+	hdr.count = w->count;
+	hdr.earthRad = EARTHRAD;
+	ok = ok && fseek(w->fp, 0, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, w->fp) == 1;
+	free(w->block);
+	w->block = NULL;
+
+	return (fclose(w->fp) == 0 && ok) ? 0 : -1;
+}
+
+static void streamBlock(void *p, size_t chunk, int worker)
+{
+	const struct streamArg *sa = p;
+	size_t block = sa->first + chunk;
+	size_t len = sa->in->blockPoints;
+	double *d, *e, *f;
+
+	(void)worker;
+	if (sa->out != NULL)
+	{
+		d = ephemColumn(sa->out, block, 0);
+		e = ephemColumn(sa->out, block, 1);
+		f = ephemColumn(sa->out, block, 2);
+	}
+	else
+	{
+		d = sa->scratch + chunk * EPHEM_OUT_COLS * len;
+		e = d + len;
+		f = e + len;
+	}
+	refractBatch(ephemBlockLength(sa->in, block),
+		ephemColumn(sa->in, block, 0), ephemColumn(sa->in, block, 1), ephemColumn(sa->in, block, 2),
+		ephemColumn(sa->in, block, 3), ephemColumn(sa->in, block, 4), ephemColumn(sa->in, block, 5),
+		d, e, f);
+}
+
+/* Compute the blocks [sa->first, sa->first + nb) and start reading the ones after them */
+static void streamWindow(struct refractPool *pool, struct streamArg *sa, size_t nb)
+{
+	const struct ephemFile *in = sa->in;
+	size_t page, from, len, k;
+
+	if (sa->first + nb < in->nBlocks)
+	{
+		page = (size_t)sysconf(_SC_PAGESIZE);
+		from = (size_t)((unsigned char *)ephemColumn(in, sa->first + nb, 0) - in->base) / page * page;
+		len = (size_t)nb * in->nCols * in->blockPoints * sizeof(double);
+		madvise(in->base + from, from + len < in->size ? len : in->size - from, MADV_WILLNEED);
+	}
+
+	if (pool != NULL)
+	{
+		refractPoolRun(pool, nb, streamBlock, sa);
+	}
+	else
+	{
+		for (k = 0; k < nb; k++)
+		{
+			streamBlock(sa, k, 0);
+		}
+	}
+}
+
+/*
+------------------------------------------------------
+ephemStream
+
+PURPOSE:		Refract every point of an input ephemeris file into an output file
+INPUT ARGUMENTS:	pool (NULL to run on the calling thread), inPath, outPath
+OUTPUT ARGUMENTS:	*count, the number of points processed, if count is not NULL
+RETURNED VALUE:		0 on success, -1 if the input is not a valid input file or the
+			output cannot be created
+FUNCTIONS CALLED:	ephemClose, ephemCreate, ephemOpen, ephemRelease, madvise, refractBatch, refractPoolRun
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The output has the block size of the input. Each block is one
+			refractBatch call, so results do not depend on the pool size.
+------------------------------------------------------
+*/
+
+int ephemStream(struct refractPool *pool, const char *inPath, const char *outPath, uint64_t *count)
+{
+	struct ephemFile in, out;
+	struct streamArg sa;
+	size_t nb;
+
+	if (ephemOpen(&in, inPath) != 0)
+	{
+		return -1;
+	}
+	if (in.nCols != EPHEM_IN_COLS || ephemCreate(&out, outPath, EPHEM_OUT_COLS, in.count, in.blockPoints) != 0)
+	{
+		ephemClose(&in);
+		return -1;
+	}
+
+	sa.in = &in;
+	sa.out = &out;
+	sa.scratch = NULL;
+	for (sa.first = 0; sa.first < in.nBlocks; sa.first += nb)
+	{
+		nb = in.nBlocks - sa.first < WINDOW_BLOCKS ? in.nBlocks - sa.first : WINDOW_BLOCKS;
+		streamWindow(pool, &sa, nb);
+		ephemRelease(&in, sa.first + nb);
+		ephemRelease(&out, sa.first + nb);
+	}
+
+	if (count != NULL)
+	{
+		*count = in.count;
+	}
+	ephemClose(&out);
+	ephemClose(&in);
+
+	return 0;
+}
+
+/*
+------------------------------------------------------
+ephemStreamWriter
+
+PURPOSE:		Refract every point of an input ephemeris file into a writer
+INPUT ARGUMENTS:	pool (NULL to run on the calling thread), inPath, w
+OUTPUT ARGUMENTS:	*count, the number of points processed, if count is not NULL
+RETURNED VALUE:		0 on success, -1 if the input is not a valid input file or a write failed
+FUNCTIONS CALLED:	ephemClose, ephemOpen, ephemRelease, madvise, malloc, refractBatch, refractPoolRun,
+			refractWriterPut
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The results of a window are handed to the writer thread while the
+			next window is computed. The writer is not closed.
+------------------------------------------------------
+*/
+
+int ephemStreamWriter(struct refractPool *pool, const char *inPath, struct refractWriter *w, uint64_t *count)
+{
+	struct ephemFile in;
+	struct streamArg sa;
+	size_t nb, k, m, len;
+	double *d;
+	int status = 0;
+
+	if (ephemOpen(&in, inPath) != 0)
+	{
+		return -1;
+	}
+	len = in.blockPoints;
+	sa.scratch = malloc((size_t)WINDOW_BLOCKS * EPHEM_OUT_COLS * len * sizeof(double));
+	if (in.nCols != EPHEM_IN_COLS || sa.scratch == NULL)
+	{
+		free(sa.scratch);
+		ephemClose(&in);
+		return -1;
+	}
+
+	sa.in = &in;
+	sa.out = NULL;
+	for (sa.first = 0; sa.first < in.nBlocks && status == 0; sa.first += nb)
+	{
+		nb = in.nBlocks - sa.first < WINDOW_BLOCKS ? in.nBlocks - sa.first : WINDOW_BLOCKS;
+		streamWindow(pool, &sa, nb);
+		for (k = 0; k < nb && status == 0; k++)
+		{
+			d = sa.scratch + k * EPHEM_OUT_COLS * len;
+			m = ephemBlockLength(&in, sa.first + k);
+			status = refractWriterPut(w, m, d, d + len, d + 2 * len);
+		}
+		ephemRelease(&in, sa.first + nb);
+	}
+
+	if (count != NULL)
+	{
+		*count = in.count;
+	}
+	free(sa.scratch);
+	ephemClose(&in);
+
+	return status;
+}
@@ -0,0 +1,92 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+Binary ephemeris / ground station files
+
+A file is a 64-byte header (struct ephemHeader) followed by blocks of
+blockPoints points. Each block holds nCols columns of blockPoints native
+(IEEE 754, little-endian on x86) doubles, one column after the other:
+
+	input files  (nCols = 6):  x[blockPoints] y[...] z[...] a[...] b[...] c[...]
+	output files (nCols = 3):  d[blockPoints] e[...] f[...]
+
+with (x,y,z) the spacecraft, (a,b,c) the unrefracted and (d,e,f) the refracted
+ground station coordinates in metres, as for refractBatch. The last block is
+padded to full length; values past count are unspecified. Every column of every
+block starts on a 64-byte boundary of the file, so a block can be handed to the
+batch kernels straight from the mapping.
+*/
+#define EPHEM_MAGIC 0x48504552u         // "REPH" read as little-endian bytes
+#define EPHEM_VERSION 1u
+#define EPHEM_BLOCK 4096                // Points per block written by ephemWriterOpen and ephemCreate
+#define EPHEM_IN_COLS 6
+#define EPHEM_OUT_COLS 3
+
+struct ephemHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nCols;                 // EPHEM_IN_COLS or EPHEM_OUT_COLS
+	uint32_t blockPoints;           // Points per block; a multiple of 8
+	uint64_t count;                 // Number of points
+	double earthRad;                // EARTHRAD of the program that wrote the file
+	uint64_t reserved[4];
+};
+
+/* A mapped ephemeris file */
+struct ephemFile
+{
+	int fd;
+	unsigned char *base;            // Start of the mapping (the header)
+	size_t size;                    // Bytes mapped
+	uint64_t count;
+	uint32_t nCols, blockPoints;
+	size_t nBlocks;
+	int writable;                   // Mapped by ephemCreate
+	size_t released;                // Bytes at the start already dropped by ephemRelease
+};
+
+/* Sequential writer that does not need the number of points in advance */
+struct ephemWriter
+{
+	FILE *fp;
+	uint32_t nCols;
+	uint64_t count;
+	size_t fill;                    // Points in the current block
+	double *block;                  // nCols * EPHEM_BLOCK
+};
+
+struct refractPool;
+struct refractWriter;
+
+/*
+Function prototypes
+*/
+int ephemOpen(struct ephemFile *f, const char *path);
+
+int ephemCreate(struct ephemFile *f, const char *path, uint32_t nCols, uint64_t count, uint32_t blockPoints);
+
+void ephemClose(struct ephemFile *f);
+
+double *ephemColumn(const struct ephemFile *f, size_t block, int col);
+
+size_t ephemBlockLength(const struct ephemFile *f, size_t block);
+
+void ephemRelease(struct ephemFile *f, size_t block);
+
+int ephemWriterOpen(struct ephemWriter *w, const char *path, uint32_t nCols);
+
+int ephemWriterAppend(struct ephemWriter *w, size_t n, const double *const *cols);
+
+int ephemWriterClose(struct ephemWriter *w);
+
+int ephemStream(struct refractPool *pool, const char *inPath, const char *outPath, uint64_t *count);
+
+int ephemStreamWriter(struct refractPool *pool, const char *inPath, struct refractWriter *w, uint64_t *count);
+
+#endif
@@ -0,0 +1,188 @@
+#include <math.h>
+#include "geodesy.h"
+
+/*
+------------------------------------------------------
+geodesy.c
+
+Conversions between Earth-centred Cartesian coordinates and WGS84 geodetic
+latitude, longitude and height, without iteration.
+
+Vermeille's closed form gives, for a point P = (x, y, z), a scalar k from which
+every geodetic quantity follows:
+
+	p = (x^2 + y^2) / a^2,  q = (1 - e^2) z^2 / a^2,  r = (p + q - e^4) / 6
+	s = e^4 p q / (4 r^3),  t = cbrt(1 + s + sqrt(s (2 + s))),  u = r (1 + t + 1/t)
+	v = sqrt(u^2 + e^4 q),  w = e^2 (u + v - q) / (2 v),  k = sqrt(u + v + w^2) - w
+
+The cube root goes away: with t = exp(acosh(1 + s) / 3), 1 + t + 1/t is
+1 + 2 cosh(acosh(1 + s) / 3), the root near 3 of a Chebyshev cubic, and its
+Taylor series in s (VERMEILLE_SERIES, geodesy.h) is exact in double precision
+for s < 3e-3, i.e. for any point farther than half the semi-major axis from
+Earth centre. That leaves two divisions and two square roots for k.
+
+With D = k sqrt(x^2 + y^2) / (k + e^2), the height is (k + e^2 - 1) / k sqrt(D^2 + z^2)
+and the foot of the normal through P is (x / (k + e^2), y / (k + e^2), z (1 - e^2) / k),
+so the surface projection takes no trigonometric function at all.
+
+The steps are a dependency chain, and its latency, not the operation count, sets
+the cost of a single point. vermeilleK rearranges w, 1 / k and 1 / (k + e^2) so
+that each division starts before the square root it used to wait for, and the
+height takes its root without waiting for the foot; the series is summed in
+pairs of terms. refractPointModel on the ellipsoid stays within about 1.5x of
+the sphere per point.
+
+Points nearer Earth centre than a / 2 are outside the scope of both the series
+and the refraction model.
+
+REFERENCES:
+Vermeille, H. (2004): Computing geodetic coordinates from geocentric coordinates,
+			Journal of Geodesy 78, pp. 94-95
+------------------------------------------------------
+*/
+
+/*
+Vermeille's k for a point at distance sqrt(rho2) from the polar axis and z from the equator,
+with 1 / k in *ik and 1 / (k + e^2) in *ike
+*/
+static double vermeilleK(double rho2, double z, double *ik, double *ike)
+{
+	const double e4 = WGS84_E2 * WGS84_E2;
+	double p, q, r, s, u, v2, v, h, w, uv, root, g;
+
+	p = rho2 * (1.0 / (WGS84_A * WGS84_A));
+	q = z * z * ((1.0 - WGS84_E2) / (WGS84_A * WGS84_A));
+	r = (p + q - e4) * (1.0 / 6.0);
+	s = e4 * p * q / ((4.0 * r) * (r * r));
+	u = r * VERMEILLE_SERIES(s);
+
+	/* w = e^2 (u + v - q) / (2 v) = e^2 / 2 + e^2 (u - q) v / (2 v^2): the division runs alongside the square root */
+	v2 = u * u + e4 * q;
+	h = WGS84_E2 * (u - q) * (0.5 / v2);
+	v = sqrt(v2);
+	w = h * v + 0.5 * WGS84_E2;
+
+	/*
+	With k = root - w and root^2 = u + v + w^2, multiplying by the conjugates gives
+	1 / k = (root + w) / (u + v) and 1 / (k + e^2) = (root + w - e^2) / (u + v + 2 e^2 w - e^4),
+	so one division, alongside the last square root, serves both
+	*/
+	uv = u + v;
+	g = 1.0 / (uv * (uv + (2.0 * WGS84_E2 * w - e4)));
+	root = sqrt(uv + w * w);
+	*ik = (root + w) * (uv + (2.0 * WGS84_E2 * w - e4)) * g;
+	*ike = (root + (w - WGS84_E2)) * uv * g;
+
+	return root - w;
+}
+
+/*
+------------------------------------------------------
+wgs84Foot
+
+PURPOSE:		Project a point onto the WGS84 ellipsoid along the ellipsoid normal
+INPUT ARGUMENTS:	Coordinates of the point (x,y,z)
+OUTPUT ARGUMENTS:	Coordinates of the foot of the normal (*fx,*fy,*fz)
+RETURNED VALUE:		Geodetic height of the point, in metres
+FUNCTIONS CALLED:	sqrt, vermeilleK
+VER./DATE:		1.1 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The ellipsoidal counterpart of satProjection, for points farther than a / 2
+			from Earth centre
+------------------------------------------------------
+*/
+
+double wgs84Foot(double x, double y, double z, double *fx, double *fy, double *fz)
+{
+	double rho2, k, ik, ike, ke2;
+
+	rho2 = x * x + y * y;
+	k = vermeilleK(rho2, z, &ik, &ike);
+	*fx = x * ike;
+	*fy = y * ike;
+	*fz = z * (1.0 - WGS84_E2) * ik;
+
+	/* sqrt(D^2 + z^2) = sqrt(k^2 rho2 + (k + e^2)^2 z^2) / (k + e^2) with D = k sqrt(rho2) / (k + e^2) */
+	ke2 = k + WGS84_E2;
+	return (k + (WGS84_E2 - 1.0)) * ik * ike * sqrt(k * k * rho2 + ke2 * ke2 * z * z);
+}
+
+/*
+------------------------------------------------------
+wgs84Radius
+
+PURPOSE:		Gaussian mean radius of curvature of the WGS84 ellipsoid under a point
+INPUT ARGUMENTS:	Coordinates of the point (a,b,c)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		sqrt(M N) = b / (1 - e^2 sin^2 lat), in metres
+FUNCTIONS CALLED:	None
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The latitude is that of the ellipsoid normal at (a,b,c) scaled onto the surface,
+			exact on the surface and within e^2 h / a of the geodetic latitude at height h.
+			The EARTH_WGS84 model uses it in place of EARTHRAD at the ground station.
+------------------------------------------------------
+*/
+
+double wgs84Radius(double a, double b, double c)
+{
+	double nxy2;
+
+	/* The normal is ((1 - e^2) a, (1 - e^2) b, c) up to a factor; sin^2 lat multiplied out */
+	nxy2 = (a * a + b * b) * ((1.0 - WGS84_E2) * (1.0 - WGS84_E2));
+
+	return WGS84_A * (1.0 - WGS84_F) * (nxy2 + c * c) / (nxy2 + (1.0 - WGS84_E2) * c * c);
+}
+
+/*
+------------------------------------------------------
+geodeticFromCartesian
+
+PURPOSE:		Convert Earth-centred Cartesian coordinates to WGS84 geodetic coordinates
+INPUT ARGUMENTS:	Coordinates of the point (x,y,z), in metres
+OUTPUT ARGUMENTS:	Geodetic latitude and longitude in radians, height in metres
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	atan, atan2, sqrt, vermeilleK
+VER./DATE:		1.1 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Closed form, no iteration; the half-angle form of the latitude is stable at the poles
+------------------------------------------------------
+*/
+
+void geodeticFromCartesian(double x, double y, double z, double *lat, double *lon, double *h)
+{
+	double rho, k, ik, ike, D, L;
+
+	rho = sqrt(x * x + y * y);
+	k = vermeilleK(rho * rho, z, &ik, &ike);
+	D = k * rho * ike;
+	L = sqrt(D * D + z * z);
+	*lat = 2.0 * atan(z / (D + L));
+	*lon = atan2(y, x);
+	*h = (k + (WGS84_E2 - 1.0)) * ik * L;
+}
+
+/*
+------------------------------------------------------
+cartesianFromGeodetic
+
+PURPOSE:		Convert WGS84 geodetic coordinates to Earth-centred Cartesian coordinates
+INPUT ARGUMENTS:	Geodetic latitude and longitude in radians, height in metres
+OUTPUT ARGUMENTS:	Coordinates of the point (*x,*y,*z), in metres
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	cos, sin, sqrt
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:
+------------------------------------------------------
+*/
+
+void cartesianFromGeodetic(double lat, double lon, double h, double *x, double *y, double *z)
+{
+	double sinLat = sin(lat), cosLat = cos(lat), N;
+
+	N = WGS84_A / sqrt(1.0 - WGS84_E2 * sinLat * sinLat);
+	*x = (N + h) * cosLat * cos(lon);
+	*y = (N + h) * cosLat * sin(lon);
+	*z = (N * (1.0 - WGS84_E2) + h) * sinLat;
+}
@@ -0,0 +1,35 @@
+#ifndef GEODESY_H
+#define GEODESY_H
+
+/*
+WGS84 ellipsoid: closed-form geodetic coordinates (Vermeille 2004) and the
+ellipsoidal surface projection used by the EARTH_WGS84 model
+*/
+#define WGS84_A 6378137.0                               // Semi-major axis, in metres
+#define WGS84_F (1.0 / 298.257223563)                   // Flattening
+#define WGS84_E2 (WGS84_F * (2.0 - WGS84_F))            // First eccentricity squared
+
+/* 1 + 2 cosh(acosh(1 + s) / 3) to s^5, Vermeille's 1 + t + 1/t (geodesy.c), in pairs of terms (Estrin) */
+#define VERMEILLE_SERIES(s) ((3.0 + (s) * (2.0 / 9)) + (s) * (s) * ((-8.0 / 243 + (s) * (56.0 / 6561)) \
+	+ (s) * (s) * (-160.0 / 59049 + (s) * (4576.0 / 4782969))))
+
+/*
+Function prototypes
+*/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+double wgs84Foot(double x, double y, double z, double *fx, double *fy, double *fz);
+
+double wgs84Radius(double a, double b, double c);
+
+void geodeticFromCartesian(double x, double y, double z, double *lat, double *lon, double *h);
+
+void cartesianFromGeodetic(double lat, double lon, double h, double *x, double *y, double *z);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
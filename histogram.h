@@ -0,0 +1,60 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+Log-linear latency histogram shared by realtime.c and profile.c: values below
+16 have a bucket each, above that every power of 2 is split into 8 buckets, so
+a bucket is at most 12.5% wide. Values of 2^40 and more share the last bucket.
+*/
+#define HIST_BUCKETS 304
+
+static inline int histBucket(uint64_t v)
+{
+	int e, i;
+
+	if (v < 16)
+	{
+		return (int)v;
+	}
+	e = 63 - __builtin_clzll(v);
+	i = 16 + (e - 4) * 8 + (int)((v >> (e - 3)) & 7);
+	return i < HIST_BUCKETS ? i : HIST_BUCKETS - 1;
+}
+
+/* Largest value that falls in bucket i */
+static inline uint64_t histBucketTop(int i)
+{
+	int e;
+
+	if (i < 16)
+	{
+		return (uint64_t)i;
+	}
+	e = (i - 16) / 8 + 4;
+	return ((uint64_t)(8 + (i - 16) % 8 + 1) << (e - 3)) - 1;
+}
+
+/* Upper edge of the bucket holding the given fraction of the total count, or 0 for an empty histogram */
+static inline uint64_t histPercentile(const uint64_t *h, double fraction)
+{
+	uint64_t total = 0, seen = 0;
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+	{
+		total += h[i];
+	}
+	for (i = 0; i < HIST_BUCKETS && total > 0; i++)
+	{
+		seen += h[i];
+		if ((double)seen >= fraction * (double)total)
+		{
+			return histBucketTop(i);
+		}
+	}
+	return 0;
+}
+
+#endif
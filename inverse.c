@@ -0,0 +1,191 @@
+#include <math.h>
+#include "refraction.h"
+#include "inverse.h"
+
+/*
+------------------------------------------------------
+inverse.c
+
+refractPoint moves the true ground station a towards the spacecraft projection
+P along the line joining them, by L = EARTHRAD dAng. The apparent station d
+therefore lies on the same line, and with rho = |P - a| and rho' = |P - d|
+
+	rho' = rho - L(rho)
+
+so the inverse is a one-dimensional root of
+
+	F(rho) = rho - EARTHRAD dAng(z_0(rho)) - rho'
+	z_0(rho) = atan(rho / H) + rho / EARTHRAD,  H = alt_sat - EARTHRAD
+	dAng(z_0) = z_0 - asin(k sin z_0),  k = EARTHRAD / (EARTHRAD + station height)
+
+after which a = P + (d - P) rho / rho'. F is solved with Halley's method using
+the analytic first and second derivatives of the zenithAngle / deltaAngle chain:
+
+	z_0'  = 1 / (H (1 + q^2)) + 1 / EARTHRAD,  z_0'' = -2 q / (H^2 (1 + q^2)^2),  q = rho / H
+	dAng' = 1 - k cos z_0 / sqrt(w),  dAng'' = (1 - k^2) k sin z_0 / w^(3/2),  w = 1 - k^2 sin^2 z_0
+	F'  = 1 - EARTHRAD dAng' z_0'
+	F'' = -EARTHRAD (dAng'' z_0'^2 + dAng' z_0'')
+
+The start is rho' + EARTHRAD dAng with dAng from the previous solution (warm
+start) or evaluated at rho'. Since F' is within 1e-4 of 1 away from the horizon,
+this converges in 1-3 iterations. The iteration stops after a step below
+INVERSE_TOL: convergence is cubic, so the error left is then far below the
+rounding of EARTHRAD dAng itself (about 1e-9 m at large zenith angles).
+
+Within a fraction of a degree of z_0 = 90 degrees dAng grows so fast that
+rho - L(rho) stops increasing (F' <= 0): two true stations then map to the
+same apparent one, and the solver returns the one on the increasing branch
+(F' > 0). Solutions with F' <= 0, or past 90 degrees, are rejected. Close to
+the fold the error of the solution grows as 1 / F'.
+------------------------------------------------------
+*/
+
+/*
+------------------------------------------------------
+refractInverse
+
+PURPOSE:		Find the true ground station whose refracted position is the desired apparent point
+INPUT ARGUMENTS:	model (NULL for the refracting shell of deltaAngle), spacecraft coordinates (x,y,z),
+			apparent ground station coordinates (d,e,f), *dAngHint if dAngHint is not NULL
+			and *dAngHint >= 0 (dAng of a nearby solution)
+OUTPUT ARGUMENTS:	True ground station coordinates (*a,*b,*c); the dAng of the solution in *dAngHint
+RETURNED VALUE:		Number of Halley iterations, or -1 if the model is not the refracting shell on the sphere,
+			the iteration did not converge within INVERSE_MAX_ITER, or the solution
+			lies in the fold at the horizon (see above)
+FUNCTIONS CALLED:	asin, atan, cos, sin, sqrt
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The pointing direction from the spacecraft is (a,b,c) - (x,y,z).
+			refractPoint applied to the result reproduces (d,e,f) to about 1e-9 m.
+------------------------------------------------------
+*/
+
+int refractInverse(const struct refractModel *model, double x, double y, double z, double d, double e, double f,
+	double *a, double *b, double *c, double *dAngHint)
+{
+	double alt_sat, t, satProj_x, satProj_y, satProj_z, dx, dy, dz, target, H, k, rho, step, q, q2,
+		z_0, sz, cz, w, dAng, dAng1, dAng2, z1, z2, F, F1, F2, s;
+	int iter;
+
+	if (model != NULL && (model->atmos != ATMOS_SHELL || model->earth != EARTH_SPHERE))
+	{
+		return -1;
+	}
+	k = EARTHRAD / (EARTHRAD + (model != NULL ? model->stationHeight : GS_HEIGHT));
+
+	alt_sat = sqrt(x * x + y * y + z * z);
+	t = EARTHRAD / alt_sat;
+	satProj_x = t * x;
+	satProj_y = t * y;
+	satProj_z = t * z;
+	dx = d - satProj_x;
+	dy = e - satProj_y;
+	dz = f - satProj_z;
+	target = sqrt(dx * dx + dy * dy + dz * dz);
+	H = alt_sat - EARTHRAD;
+
+	if (target == 0.0)
+	{
+		*a = d;
+		*b = e;
+		*c = f;
+		if (dAngHint != NULL)
+		{
+			*dAngHint = 0.0;
+		}
+		return 0;
+	}
+
+	/* Start from one fixed point step, rho = rho' + L(rho') or the warm start */
+	if (dAngHint != NULL && *dAngHint >= 0.0)
+	{
+		dAng = *dAngHint;
+	}
+	else
+	{
+		z_0 = atan(target / H) + target / EARTHRAD;
+		dAng = z_0 - asin(k * sin(z_0));
+	}
+	rho = target + EARTHRAD * dAng;
+
+	for (iter = 1; iter <= INVERSE_MAX_ITER; iter++)
+	{
+		q = rho / H;
+		q2 = 1.0 + q * q;
+		z_0 = atan(q) + rho / EARTHRAD;
+		sz = sin(z_0);
+		cz = cos(z_0);
+		w = 1.0 - k * k * sz * sz;
+		dAng = z_0 - asin(k * sz);
+		dAng1 = 1.0 - k * cz / sqrt(w);
+		dAng2 = (1.0 - k * k) * k * sz / (w * sqrt(w));
+		z1 = 1.0 / (H * q2) + 1.0 / EARTHRAD;
+		z2 = -2.0 * q / (H * H * q2 * q2);
+
+		F = rho - EARTHRAD * dAng - target;
+		F1 = 1.0 - EARTHRAD * dAng1 * z1;
+		F2 = -EARTHRAD * (dAng2 * z1 * z1 + dAng1 * z2);
+		step = 2.0 * F * F1 / (2.0 * F1 * F1 - F * F2);
+		rho -= step;
+		if (fabs(step) <= INVERSE_TOL)
+		{
+			break;
+		}
+	}
+	if (iter > INVERSE_MAX_ITER || !(z_0 < PI / 2) || !(F1 > 0.0))
+	{
+		return -1;
+	}
+
+	s = rho / target;
+	*a = satProj_x + s * dx;
+	*b = satProj_y + s * dy;
+	*c = satProj_z + s * dz;
+	if (dAngHint != NULL)
+	{
+		*dAngHint = (rho - target) / EARTHRAD;
+	}
+
+	return iter;
+}
+
+/*
+------------------------------------------------------
+refractInverseBatch
+
+PURPOSE:		refractInverse for n points, each warm-started from the previous solution
+INPUT ARGUMENTS:	model, n, spacecraft coordinates (x,y,z) and apparent ground station coordinates (d,e,f) as arrays
+OUTPUT ARGUMENTS:	True ground station coordinates (a,b,c) as arrays
+RETURNED VALUE:		Largest number of iterations taken by a point, or -1 if any point failed
+FUNCTIONS CALLED:	refractInverse
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Intended for consecutive samples of a pass; unrelated points still
+			converge, only with an extra iteration. Failed points are left as (NaN, NaN, NaN).
+------------------------------------------------------
+*/
+
+int refractInverseBatch(const struct refractModel *model, size_t n, const double *x, const double *y, const double *z,
+	const double *d, const double *e, const double *f, double *a, double *b, double *c)
+{
+	double hint = -1.0;
+	size_t i;
+	int iter, worst = 0;
+
+	for (i = 0; i < n; i++)
+	{
+		iter = refractInverse(model, x[i], y[i], z[i], d[i], e[i], f[i], &a[i], &b[i], &c[i], &hint);
+		if (iter < 0)
+		{
+			a[i] = b[i] = c[i] = NAN;
+			hint = -1.0;
+			worst = -1;
+		}
+		else if (worst >= 0 && iter > worst)
+		{
+			worst = iter;
+		}
+	}
+
+	return worst;
+}
@@ -0,0 +1,23 @@
+#ifndef INVERSE_H
+#define INVERSE_H
+
+#include <stddef.h>
+
+/*
+Inverse of refractPoint: the true ground station for a desired apparent one
+*/
+#define INVERSE_MAX_ITER 8
+#define INVERSE_TOL 1e-6        // Last Halley step on the projection-to-station distance, in metres
+
+struct refractModel;
+
+/*
+Function prototypes
+*/
+int refractInverse(const struct refractModel *model, double x, double y, double z, double d, double e, double f,
+	double *a, double *b, double *c, double *dAngHint);
+
+int refractInverseBatch(const struct refractModel *model, size_t n, const double *x, const double *y, const double *z,
+	const double *d, const double *e, const double *f, double *a, double *b, double *c);
+
+#endif
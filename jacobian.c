@@ -0,0 +1,334 @@
+#include <math.h>
+#include <string.h>
+#include "refraction.h"
+#include "raytrace.h"
+#include "approx.h"
+#include "geodesy.h"
+#include "jacobian.h"
+
+/*
+------------------------------------------------------
+jacobian.c
+
+Hand-derived partials of refractPointModel. With s the spacecraft, g the station,
+P the projection of s onto the surface, h the height of s above it, n the unit
+normal there and R the radius of the surface under g,
+
+	v = P - g,  D = |v|,  z_0 = atan(D / h) + D / R,  q = R dAng(z_0, R) / D
+	output = g + q v
+
+the derivatives are
+
+	dv/dg = -I,  dh/ds = n^T,  dR/ds = 0,  dh/dg = 0
+	dD    = (v / D)^T dv
+	dz_0  = (h dD - D dh) / (h^2 + D^2) + dD / R - D dR / R^2
+	dq    = (dAng dR + R (dAng/dz_0 dz_0 + dAng/dR dR) - q dD) / D
+
+	d output / ds = v (dq/ds)^T + q dP/ds
+	d output / dg = (1 - q) I + v (dq/dg)^T
+
+On the sphere, with r = |s| and u = s / r, P = EARTHRAD s / r, n = u, R is
+EARTHRAD and dP/ds = (EARTHRAD / r) (I - u u^T).
+
+On the WGS84 ellipsoid P is the foot of the normal (wgs84Foot). Moving s moves
+P along the surface by its tangential part, shrunk by 1 + h / M along the
+meridian and 1 + h / N along the prime vertical, M and N the radii of
+curvature at P:
+
+	dP/ds = N / (N + h) (I - n n^T) - beta m m^T,  m = z - sin(lat) n
+	beta  = (N / (N + h) - M / (M + h)) / cos^2(lat) = e^2 h N / ((1 - e^2 sin^2 lat) (M + h) (N + h))
+
+with z the polar axis, so nothing is singular at the poles. R is wgs84Radius,
+K (alpha rho^2 + c^2) / (alpha rho^2 + (1 - e^2) c^2) with alpha = (1 - e^2)^2,
+K the semi-minor axis and rho^2 = a^2 + b^2, and differentiates in closed form.
+
+dAng/dz_0 is 1 - R cos(z_0) / ((R + H) cos(zed)) for the refracting shell at
+height H, and dAng/dR is -H sin(z_0) / ((R + H)^2 cos(zed)). For ATMOS_RAYTRACE
+dAng/dz_0 is a central difference in z_0 alone and dAng/dR is 0. At D = 0 the
+output is g and q tends to R dAng/dz_0 (1 / h + 1 / R) with dq = 0.
+
+The outputs are those of refractPointModel, so one call replaces the evaluation
+and the six perturbed evaluations of a finite difference Jacobian, on either
+Earth model.
+------------------------------------------------------
+*/
+
+/* Angular displacement of the ray traced model, tabulated or not */
+static double rayDAng(const struct refractModel *model, double z_0)
+{
+	return model->table != NULL && (z_0 <= model->table->z0Max || model->profile == NULL)
+		? refractApproxDAng(model->table, z_0) : raytraceDAng(model->profile, model->stationHeight, z_0, NULL);
+}
+
+/* dAng at z_0 on a surface of the given radius as refractPointModel computes it, and its derivatives by z_0 and radius */
+static double dAngSlope(const struct refractModel *model, double z_0, double radius, double *dAng, double *dRadius)
+{
+	double height, s, cosZed;
+
+	if (model != NULL && model->atmos == ATMOS_RAYTRACE)
+	{
+		*dAng = rayDAng(model, z_0);
+		*dRadius = 0.0;
+		return (rayDAng(model, z_0 + JACOBIAN_RAYTRACE_STEP) - rayDAng(model, z_0 - JACOBIAN_RAYTRACE_STEP))
+			/ (2.0 * JACOBIAN_RAYTRACE_STEP);
+	}
+
+	height = model == NULL ? GS_HEIGHT : model->stationHeight;
+	s = (sin(z_0) * radius) / (radius + height);
+	*dAng = z_0 - asin(s);
+	cosZed = sqrt(1.0 - s * s);
+	*dRadius = -(sin(z_0) * height) / ((radius + height) * (radius + height)) / cosZed;
+	return 1.0 - (cos(z_0) * radius) / (radius + height) / cosZed;
+}
+
+/* Partials dP/ds (symmetric, row-major) of the foot P of the normal through a point at height h above it */
+static void footPartials(double px, double py, double pz, double h, double *jFoot, double *n)
+{
+	double len, sinLat, w2, N, M, cN, beta, m[3];
+	int i, j;
+
+	/* Outward normal at P, the gradient of the ellipsoid */
+	n[0] = px;
+	n[1] = py;
+	n[2] = pz / (1.0 - WGS84_E2);
+	len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	for (i = 0; i < 3; i++)
+	{
+		n[i] /= len;
+	}
+
+	sinLat = n[2];
+	w2 = 1.0 - WGS84_E2 * sinLat * sinLat;
+	N = WGS84_A / sqrt(w2);
+	M = N * (1.0 - WGS84_E2) / w2;
+	cN = N / (N + h);
+	beta = WGS84_E2 * h * N / (w2 * (M + h) * (N + h));
+	m[0] = -sinLat * n[0];
+	m[1] = -sinLat * n[1];
+	m[2] = 1.0 - sinLat * n[2];
+	for (i = 0; i < 3; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			jFoot[3 * i + j] = cN * ((i == j) - n[i] * n[j]) - beta * m[i] * m[j];
+		}
+	}
+}
+
+/* Gradient of wgs84Radius at (a,b,c) */
+static void radiusGradient(double a, double b, double c, double *grad)
+{
+	const double alpha = (1.0 - WGS84_E2) * (1.0 - WGS84_E2), K = WGS84_A * (1.0 - WGS84_F);
+	double rho2 = a * a + b * b, den, f;
+
+	den = alpha * rho2 + (1.0 - WGS84_E2) * c * c;
+	f = 2.0 * K * alpha * WGS84_E2 / (den * den);
+	grad[0] = -f * a * c * c;
+	grad[1] = -f * b * c * c;
+	grad[2] = f * rho2 * c;
+}
+
+/*
+------------------------------------------------------
+refractPointJacobian
+
+PURPOSE:		Compute the refracted ground station coordinates and their partial derivatives
+INPUT ARGUMENTS:	Atmosphere model (NULL for the refracting shell of deltaAngle),
+			spacecraft coordinates (x,y,z) and unrefracted ground station coordinates (a,b,c)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (*d,*e,*f); derivatives by (x,y,z) in
+			jSat[9] and by (a,b,c) in jSta[9], row-major, each skipped if NULL
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	atan, dAngSlope, footPartials, radiusGradient, sqrt, wgs84Foot, wgs84Radius
+VER./DATE:		1.2 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			(*d,*e,*f) are bit-identical to refractPointModel. Nothing is printed.
+			The partials are analytic on both Earth models; a call costs about one
+			refractPointModel, plus two dAng lookups for ATMOS_RAYTRACE.
+------------------------------------------------------
+*/
+
+void refractPointJacobian(const struct refractModel *model, double x, double y, double z, double a, double b, double c,
+	double *d, double *e, double *f, double *jSat, double *jSta)
+{
+	double alt_sat, t, satProj_x, satProj_y, satProj_z, height_sat, radius, v[3], n[3], jFoot[9], gradR[3],
+		distGS2satProj, zenAng, theta, z_0, dAng, slope, dAngRadius, linearDisplacement, q, invD, invDen,
+		gradD_s[3], gradq_s[3], gradq_g[3];
+	int wgs84 = model != NULL && model->earth == EARTH_WGS84, i, j;
+
+	/* Value, as refractPointModel */
+	if (wgs84)
+	{
+		height_sat = wgs84Foot(x, y, z, &satProj_x, &satProj_y, &satProj_z);
+		radius = wgs84Radius(a, b, c);
+		alt_sat = t = 0.0;
+	}
+	else
+	{
+		alt_sat = sqrt(x * x + y * y + z * z);
+		t = EARTHRAD / alt_sat;
+		satProj_x = t * x;
+		satProj_y = t * y;
+		satProj_z = t * z;
+		radius = EARTHRAD;
+		height_sat = alt_sat - EARTHRAD;
+	}
+	v[0] = satProj_x - a;
+	v[1] = satProj_y - b;
+	v[2] = satProj_z - c;
+	distGS2satProj = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	zenAng = atan(distGS2satProj / height_sat);
+	theta = distGS2satProj / radius;
+	z_0 = zenAng + theta;
+	slope = dAngSlope(model, z_0, radius, &dAng, &dAngRadius);
+	linearDisplacement = radius * dAng;
+	if (linearDisplacement == 0.0)
+	{
+		*d = a;
+		*e = b;
+		*f = c;
+	}
+	else
+	{
+		*d = a + (linearDisplacement / distGS2satProj) * v[0];
+		*e = b + (linearDisplacement / distGS2satProj) * v[1];
+		*f = c + (linearDisplacement / distGS2satProj) * v[2];
+	}
+	if (jSat == NULL && jSta == NULL)
+	{
+		return;
+	}
+
+	/* Partials of the projection and the height by the spacecraft, of the radius by the station */
+	if (wgs84)
+	{
+		footPartials(satProj_x, satProj_y, satProj_z, height_sat, jFoot, n);
+		radiusGradient(a, b, c, gradR);
+	}
+	else
+	{
+		n[0] = x / alt_sat;
+		n[1] = y / alt_sat;
+		n[2] = z / alt_sat;
+		for (i = 0; i < 3; i++)
+		{
+			for (j = 0; j < 3; j++)
+			{
+				jFoot[3 * i + j] = t * ((i == j) - n[i] * n[j]);
+			}
+			gradR[i] = 0.0;
+		}
+	}
+
+	/* Gradients of D and q */
+	if (distGS2satProj > 0.0)
+	{
+		invD = 1.0 / distGS2satProj;
+		q = linearDisplacement * invD;
+		invDen = 1.0 / (height_sat * height_sat + distGS2satProj * distGS2satProj);
+		for (j = 0; j < 3; j++)
+		{
+			gradD_s[j] = (jFoot[3 * j] * v[0] + jFoot[3 * j + 1] * v[1] + jFoot[3 * j + 2] * v[2]) * invD;
+			gradq_s[j] = (radius * slope * ((height_sat * gradD_s[j] - distGS2satProj * n[j]) * invDen
+				+ gradD_s[j] / radius) - q * gradD_s[j]) * invD;
+			gradq_g[j] = (-(radius * slope * (height_sat * invDen + 1.0 / radius) - q) * v[j] * invD
+				+ (dAng + radius * dAngRadius - slope * distGS2satProj / radius) * gradR[j]) * invD;
+		}
+	}
+	else
+	{
+		q = radius * slope * (1.0 / height_sat + 1.0 / radius);
+		for (j = 0; j < 3; j++)
+		{
+			gradq_s[j] = 0.0;
+			gradq_g[j] = 0.0;
+		}
+	}
+
+	for (i = 0; i < 3; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			if (jSat != NULL)
+			{
+				jSat[3 * i + j] = v[i] * gradq_s[j] + q * jFoot[3 * i + j];
+			}
+			if (jSta != NULL)
+			{
+				jSta[3 * i + j] = (1.0 - q) * (i == j) + v[i] * gradq_g[j];
+			}
+		}
+	}
+
+	return;
+}
+
+/* out += J C J^T for row-major 3x3 matrices, C symmetric */
+static void addSandwich(const double *J, const double *C, double *out)
+{
+	double JC[9], s;
+	int i, j;
+
+	for (i = 0; i < 3; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			JC[3 * i + j] = J[3 * i] * C[j] + J[3 * i + 1] * C[3 + j] + J[3 * i + 2] * C[6 + j];
+		}
+	}
+	for (i = 0; i < 3; i++)
+	{
+		for (j = i; j < 3; j++)
+		{
+			s = JC[3 * i] * J[3 * j] + JC[3 * i + 1] * J[3 * j + 1] + JC[3 * i + 2] * J[3 * j + 2];
+			out[3 * i + j] += s;
+			if (j != i)
+			{
+				out[3 * j + i] += s;
+			}
+		}
+	}
+}
+
+/*
+------------------------------------------------------
+refractBatchCovariance
+
+PURPOSE:		Compute refracted ground station coordinates and their covariance for n points
+INPUT ARGUMENTS:	Atmosphere model (NULL for the refracting shell), n, spacecraft coordinates
+			(x,y,z) and ground station coordinates (a,b,c) as arrays, covSat and covSta
+			(9 doubles per point, row-major 3x3 covariances of (x,y,z) and (a,b,c);
+			NULL for an exactly known input)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f) as arrays, cov (9 doubles per point)
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	addSandwich, refractPointJacobian
+VER./DATE:		1.1 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			First order propagation, the spacecraft and station errors taken as
+			independent: cov = Js covSat Js^T + Jg covSta Jg^T. A point costs one
+			refractPointJacobian and two 3x3 products, on either Earth model.
+------------------------------------------------------
+*/
+
+void refractBatchCovariance(const struct refractModel *model, size_t n, const double *x, const double *y,
+	const double *z, const double *a, const double *b, const double *c, const double *covSat, const double *covSta,
+	double *d, double *e, double *f, double *cov)
+{
+	double jSat[9], jSta[9];
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		refractPointJacobian(model, x[i], y[i], z[i], a[i], b[i], c[i], &d[i], &e[i], &f[i], jSat, jSta);
+		memset(cov + 9 * i, 0, 9 * sizeof(double));
+		if (covSat != NULL)
+		{
+			addSandwich(jSat, covSat + 9 * i, cov + 9 * i);
+		}
+		if (covSta != NULL)
+		{
+			addSandwich(jSta, covSta + 9 * i, cov + 9 * i);
+		}
+	}
+
+	return;
+}
@@ -0,0 +1,30 @@
+#ifndef JACOBIAN_H
+#define JACOBIAN_H
+
+#include <stddef.h>
+
+/*
+Analytic partial derivatives of the refracted ground station (d,e,f) with respect
+to the spacecraft (x,y,z) and the unrefracted ground station (a,b,c), and
+propagation of their 3x3 covariances. Matrices are row-major double[9]:
+jSat[3 * i + j] is the derivative of output i by spacecraft coordinate j.
+
+On the sphere and on the WGS84 ellipsoid alike, a point costs about one
+refractPointModel evaluation; ATMOS_RAYTRACE models add two dAng evaluations
+for the slope in z_0.
+*/
+#define JACOBIAN_RAYTRACE_STEP 1e-6     // Step in z_0 of the central difference of dAng for ATMOS_RAYTRACE, in radians
+
+struct refractModel;
+
+/*
+Function prototypes
+*/
+void refractPointJacobian(const struct refractModel *model, double x, double y, double z, double a, double b, double c,
+	double *d, double *e, double *f, double *jSat, double *jSta);
+
+void refractBatchCovariance(const struct refractModel *model, size_t n, const double *x, const double *y,
+	const double *z, const double *a, const double *b, const double *c, const double *covSat, const double *covSta,
+	double *d, double *e, double *f, double *cov);
+
+#endif
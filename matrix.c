@@ -0,0 +1,187 @@
+#include "refraction.h"
+#include "matrix.h"
+#include "pool.h"
+#include "visibility.h"
+
+/*
+------------------------------------------------------
+matrix.c
+
+refractMatrix fills nSat x nSta row-major matrices, d[s * nSta + j] being the
+refracted position of station j seen from spacecraft s. The matrix is cut into
+tiles of MATRIX_TILE_SATS spacecraft by MATRIX_TILE_STATIONS stations, and the
+tiles are spread over the pool. Within a tile, every spacecraft goes through
+refractBatchStations against the tile's stations: its radius and projection
+are computed once per tile instead of once per pair, and the station
+coordinates are reused from L1 by every spacecraft of the tile.
+
+refractMatrixSparse first finds the visible pairs with the visibility index,
+grouped by spacecraft, then refracts each spacecraft's run of stations the same
+way after gathering their coordinates.
+
+Results are bit-identical to refractBatch over the same pairs.
+------------------------------------------------------
+*/
+
+#define SPARSE_CHUNK 4096       // Pairs per pool chunk of refractMatrixSparse
+
+struct denseArg
+{
+	size_t nSat, nSta, tilesSta;
+	const double *x, *y, *z, *a, *b, *c;
+	double *d, *e, *f;
+};
+
+struct sparseArg
+{
+	size_t n;
+	const struct visPair *pairs;
+	const double *x, *y, *z, *a, *b, *c;
+	double *d, *e, *f;
+};
+
+static void denseTile(void *p, size_t chunk, int worker)
+{
+	const struct denseArg *da = p;
+	size_t s0 = chunk / da->tilesSta * MATRIX_TILE_SATS, j0 = chunk % da->tilesSta * MATRIX_TILE_STATIONS;
+	size_t s1 = s0 + MATRIX_TILE_SATS < da->nSat ? s0 + MATRIX_TILE_SATS : da->nSat;
+	size_t m = j0 + MATRIX_TILE_STATIONS < da->nSta ? MATRIX_TILE_STATIONS : da->nSta - j0;
+	size_t s, row;
+
+	(void)worker;
+	for (s = s0; s < s1; s++)
+	{
+		row = s * da->nSta + j0;
+		refractBatchStations(da->x[s], da->y[s], da->z[s], m, da->a + j0, da->b + j0, da->c + j0,
+			da->d + row, da->e + row, da->f + row);
+	}
+}
+
+static void sparseChunk(void *p, size_t chunk, int worker)
+{
+	const struct sparseArg *sa = p;
+	double a[MATRIX_TILE_STATIONS], b[MATRIX_TILE_STATIONS], c[MATRIX_TILE_STATIONS];
+	size_t k = chunk * SPARSE_CHUNK, end = k + SPARSE_CHUNK < sa->n ? k + SPARSE_CHUNK : sa->n;
+	size_t sat, m;
+	int j;
+
+	(void)worker;
+	while (k < end)
+	{
+		/* Gather a run of stations seen from one spacecraft */
+		sat = sa->pairs[k].sat;
+		for (m = 0; k + m < end && m < MATRIX_TILE_STATIONS && sa->pairs[k + m].sat == sat; m++)
+		{
+			j = sa->pairs[k + m].station;
+			a[m] = sa->a[j];
+			b[m] = sa->b[j];
+			c[m] = sa->c[j];
+		}
+		refractBatchStations(sa->x[sat], sa->y[sat], sa->z[sat], m, a, b, c, sa->d + k, sa->e + k, sa->f + k);
+		k += m;
+	}
+}
+
+/* Run task over nchunks on the pool, or on the calling thread if pool is NULL */
+static void runChunks(struct refractPool *pool, size_t nchunks, refractPoolTask task, void *arg)
+{
+	size_t i;
+
+	if (pool != NULL && refractPoolThreads(pool) > 1 && nchunks > 1)
+	{
+		refractPoolRun(pool, nchunks, task, arg);
+		return;
+	}
+	for (i = 0; i < nchunks; i++)
+	{
+		task(arg, i, 0);
+	}
+}
+
+/*
+------------------------------------------------------
+refractMatrix
+
+PURPOSE:		Refract every station for every spacecraft
+INPUT ARGUMENTS:	pool (NULL to run on the calling thread), nSat, spacecraft coordinates (x,y,z),
+			nSta, ground station coordinates (a,b,c), all as arrays
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f) as nSat x nSta row-major matrices
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	refractBatchStations, refractPoolRun
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Pairs below the horizon are computed too, as refractBatch would; use
+			refractMatrixSparse to skip them
+------------------------------------------------------
+*/
+
+void refractMatrix(struct refractPool *pool, size_t nSat, const double *x, const double *y, const double *z,
+	size_t nSta, const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	struct denseArg da;
+
+	if (nSat == 0 || nSta == 0)
+	{
+		return;
+	}
+	da.nSat = nSat;
+	da.nSta = nSta;
+	da.tilesSta = (nSta + MATRIX_TILE_STATIONS - 1) / MATRIX_TILE_STATIONS;
+	da.x = x;
+	da.y = y;
+	da.z = z;
+	da.a = a;
+	da.b = b;
+	da.c = c;
+	da.d = d;
+	da.e = e;
+	da.f = f;
+	runChunks(pool, (nSat + MATRIX_TILE_SATS - 1) / MATRIX_TILE_SATS * da.tilesSta, denseTile, &da);
+}
+
+/*
+------------------------------------------------------
+refractMatrixSparse
+
+PURPOSE:		Refract the stations that see each spacecraft within a zenith angle
+INPUT ARGUMENTS:	pool (NULL to run on the calling thread), ix (built from a,b,c), nSat,
+			spacecraft coordinates (x,y,z) as arrays, ground station coordinates (a,b,c)
+			as given to visIndexBuild, zMax (largest z_0, in radians), max (capacity)
+OUTPUT ARGUMENTS:	The visible pairs in pairs[0..], grouped by spacecraft, and the refracted
+			station of pair k in (d[k],e[k],f[k])
+RETURNED VALUE:		Number of visible pairs. If it exceeds max, nothing is refracted and the
+			call should be repeated with room for that many pairs.
+FUNCTIONS CALLED:	refractBatchStations, refractPoolRun, visQueryBatch
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The visibility query runs on the calling thread
+------------------------------------------------------
+*/
+
+size_t refractMatrixSparse(struct refractPool *pool, const struct visIndex *ix, size_t nSat,
+	const double *x, const double *y, const double *z, const double *a, const double *b, const double *c,
+	double zMax, struct visPair *pairs, double *d, double *e, double *f, size_t max)
+{
+	struct sparseArg sa;
+	size_t n;
+
+	n = visQueryBatch(ix, nSat, x, y, z, zMax, pairs, max);
+	if (n > max)
+	{
+		return n;
+	}
+	sa.n = n;
+	sa.pairs = pairs;
+	sa.x = x;
+	sa.y = y;
+	sa.z = z;
+	sa.a = a;
+	sa.b = b;
+	sa.c = c;
+	sa.d = d;
+	sa.e = e;
+	sa.f = f;
+	runChunks(pool, (n + SPARSE_CHUNK - 1) / SPARSE_CHUNK, sparseChunk, &sa);
+
+	return n;
+}
@@ -0,0 +1,27 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stddef.h>
+
+/*
+Refraction for every (spacecraft, ground station) pair of a constellation and a
+station network, dense or restricted to the visible pairs
+*/
+#define MATRIX_TILE_SATS 32             // Spacecraft per tile
+#define MATRIX_TILE_STATIONS 256        // Stations per tile; 6 KB of station coordinates stay in L1
+
+struct refractPool;
+struct visIndex;
+struct visPair;
+
+/*
+Function prototypes
+*/
+void refractMatrix(struct refractPool *pool, size_t nSat, const double *x, const double *y, const double *z,
+	size_t nSta, const double *a, const double *b, const double *c, double *d, double *e, double *f);
+
+size_t refractMatrixSparse(struct refractPool *pool, const struct visIndex *ix, size_t nSat,
+	const double *x, const double *y, const double *z, const double *a, const double *b, const double *c,
+	double zMax, struct visPair *pairs, double *d, double *e, double *f, size_t max);
+
+#endif
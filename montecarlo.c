@@ -0,0 +1,570 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "refraction.h"
+#include "raytrace.h"
+#include "pool.h"
+#include "montecarlo.h"
+
+/*
+------------------------------------------------------
+montecarlo.c
+
+Sample i draws its parameters from a Philox4x32-10 counter-based generator
+(Salmon et al., SC11) keyed by the seed, with the counter (i, draw). Every
+parameter has its own slot of variates, so a sample's values depend only on the
+seed and i, not on which thread ran it or on the other distributions.
+
+Samples are cut into chunks of MC_CHUNK. Each chunk is reduced on one thread into
+its own moments, and the chunks are merged in index order, MC_ROUND at a time.
+So the result is bit-identical for any number of threads, and the memory does
+not grow with the number of samples.
+------------------------------------------------------
+*/
+
+#define MC_SLOTS 8              // Variates per sample: T, P, lapse, tropopause, station height, offset x, y, z
+#define MC_ATMOS_SLOTS 4        // Leading slots that only the ray traced atmosphere uses
+
+struct mcAccum
+{
+	uint64_t samples, rejected;
+	struct mcStat dAng, displacement, dev[3];
+	double comoment[9];
+};
+
+struct mcArg
+{
+	const struct mcConfig *cfg;
+	struct mcAccum *part;           // One per chunk of the round
+	uint64_t firstChunk;
+	double ref[3];                  // Correction at the centre of every distribution
+};
+
+/* Philox4x32-10 block of ctr under key */
+static void philox(uint32_t ctr[4], uint32_t k0, uint32_t k1)
+{
+	uint64_t p0, p1;
+	uint32_t c0, c2;
+	int r;
+
+	for (r = 0; r < 10; r++)
+	{
+		p0 = (uint64_t)0xD2511F53u * ctr[0];
+		p1 = (uint64_t)0xCD9E8D57u * ctr[2];
+		c0 = (uint32_t)(p1 >> 32) ^ ctr[1] ^ k0;
+		c2 = (uint32_t)(p0 >> 32) ^ ctr[3] ^ k1;
+		ctr[1] = (uint32_t)p1;
+		ctr[3] = (uint32_t)p0;
+		ctr[0] = c0;
+		ctr[2] = c2;
+		k0 += 0x9E3779B9u;
+		k1 += 0xBB67AE85u;
+	}
+}
+
+/* Uniform variates in (0,1) and standard normal variates (Box-Muller) of every slot of sample i */
+static void drawSample(uint64_t seed, uint64_t i, double *u, double *nrm)
+{
+	uint32_t ctr[4];
+	double r;
+	int k;
+
+	for (k = 0; k < MC_SLOTS; k += 2)
+	{
+		ctr[0] = (uint32_t)i;
+		ctr[1] = (uint32_t)(i >> 32);
+		ctr[2] = (uint32_t)k;
+		ctr[3] = 0;
+		philox(ctr, (uint32_t)seed, (uint32_t)(seed >> 32));
+		u[k] = ((double)((((uint64_t)ctr[0] << 32) | ctr[1]) >> 11) + 0.5) * 0x1p-53;
+		u[k + 1] = ((double)((((uint64_t)ctr[2] << 32) | ctr[3]) >> 11) + 0.5) * 0x1p-53;
+		r = sqrt(-2.0 * log(u[k]));
+		nrm[k] = r * cos(2.0 * PI * u[k + 1]);
+		nrm[k + 1] = r * sin(2.0 * PI * u[k + 1]);
+	}
+}
+
+static double sampleDist(const struct mcDist *dist, double u, double nrm)
+{
+	switch (dist->kind)
+	{
+	case MC_NORMAL:
+		return dist->p1 + dist->p2 * nrm;
+	case MC_UNIFORM:
+		return dist->p1 + (dist->p2 - dist->p1) * u;
+	default:
+		return dist->p1;
+	}
+}
+
+static double centre(const struct mcDist *dist)
+{
+	return dist->kind == MC_UNIFORM ? 0.5 * (dist->p1 + dist->p2) : dist->p1;
+}
+
+static void statInit(struct mcStat *st)
+{
+	st->n = 0;
+	st->mean = 0.0;
+	st->m2 = 0.0;
+	st->min = INFINITY;
+	st->max = -INFINITY;
+}
+
+/* Welford update; returns the deviation from the old mean */
+static double statAdd(struct mcStat *st, double v)
+{
+	double delta = v - st->mean;
+
+	st->n++;
+	st->mean += delta / (double)st->n;
+	st->m2 += delta * (v - st->mean);
+	st->min = v < st->min ? v : st->min;
+	st->max = v > st->max ? v : st->max;
+	return delta;
+}
+
+static void statMerge(struct mcStat *dst, const struct mcStat *src)
+{
+	double n, delta;
+
+	if (src->n == 0)
+	{
+		return;
+	}
+	n = (double)(dst->n + src->n);
+	delta = src->mean - dst->mean;
+	dst->mean += delta * (double)src->n / n;
+	dst->m2 += src->m2 + delta * delta * (double)dst->n * (double)src->n / n;
+	dst->n += src->n;
+	dst->min = src->min < dst->min ? src->min : dst->min;
+	dst->max = src->max > dst->max ? src->max : dst->max;
+}
+
+static void accumInit(struct mcAccum *acc)
+{
+	int i;
+
+	memset(acc, 0, sizeof(*acc));
+	statInit(&acc->dAng);
+	statInit(&acc->displacement);
+	for (i = 0; i < 3; i++)
+	{
+		statInit(&acc->dev[i]);
+	}
+}
+
+/* Fold src into dst; dst holds the samples before src */
+static void accumMerge(struct mcAccum *dst, const struct mcAccum *src)
+{
+	double delta[3], w;
+	int i, j;
+
+	if (dst->dev[0].n > 0 && src->dev[0].n > 0)
+	{
+		w = (double)dst->dev[0].n * (double)src->dev[0].n / (double)(dst->dev[0].n + src->dev[0].n);
+		for (i = 0; i < 3; i++)
+		{
+			delta[i] = src->dev[i].mean - dst->dev[i].mean;
+		}
+		for (i = 0; i < 3; i++)
+		{
+			for (j = 0; j < 3; j++)
+			{
+				dst->comoment[3 * i + j] += delta[i] * delta[j] * w;
+			}
+		}
+	}
+	for (i = 0; i < 9; i++)
+	{
+		dst->comoment[i] += src->comoment[i];
+	}
+	dst->samples += src->samples;
+	dst->rejected += src->rejected;
+	statMerge(&dst->dAng, &src->dAng);
+	statMerge(&dst->displacement, &src->displacement);
+	for (i = 0; i < 3; i++)
+	{
+		statMerge(&dst->dev[i], &src->dev[i]);
+	}
+}
+
+/* Refract the geometry of cfg under the given parameters; -1 if the atmosphere is invalid */
+static int correction(const struct mcConfig *cfg, const double *p, double *d, double *e, double *f, double *dAng)
+{
+	struct atmosProfile profile;
+	struct refractModel model;
+	struct refractResult res;
+
+	model.atmos = cfg->atmos;
+	model.stationHeight = p[4];
+	model.profile = NULL;
+	model.table = NULL;
+	model.earth = EARTH_SPHERE;
+	if (cfg->atmos == ATMOS_RAYTRACE)
+	{
+		if (atmosProfileInit(&profile, p[0], p[1], p[2], p[3]) != 0)
+		{
+			return -1;
+		}
+		model.profile = &profile;
+	}
+	refractPointModel(&model, cfg->x + p[5], cfg->y + p[6], cfg->z + p[7], cfg->a, cfg->b, cfg->c, d, e, f, &res);
+	*dAng = res.dAng;
+
+	return isfinite(*d) && isfinite(*e) && isfinite(*f) ? 0 : -1;
+}
+
+/* Parameters of every slot at the centre of their distributions */
+static void centreParams(const struct mcConfig *cfg, double *p)
+{
+	p[0] = centre(&cfg->tSealevel);
+	p[1] = centre(&cfg->pSealevel);
+	p[2] = centre(&cfg->lapseRate);
+	p[3] = centre(&cfg->tropopause);
+	p[4] = centre(&cfg->stationHeight);
+	p[5] = p[6] = p[7] = centre(&cfg->satOffset);
+}
+
+static void runChunk(void *arg, size_t chunk, int worker)
+{
+	const struct mcArg *ma = arg;
+	const struct mcConfig *cfg = ma->cfg;
+	const struct mcDist *dist[MC_SLOTS] = { &cfg->tSealevel, &cfg->pSealevel, &cfg->lapseRate, &cfg->tropopause,
+		&cfg->stationHeight, &cfg->satOffset, &cfg->satOffset, &cfg->satOffset };
+	struct mcAccum *acc = &ma->part[chunk];
+	const double *ref = ma->ref;
+	double u[MC_SLOTS], nrm[MC_SLOTS], p[MC_SLOTS], out[3], delta[3], dAng;
+	uint64_t i, first, last;
+	int k, j;
+
+	(void)worker;
+	accumInit(acc);
+	first = (ma->firstChunk + chunk) * MC_CHUNK;
+	last = first + MC_CHUNK < cfg->samples ? first + MC_CHUNK : cfg->samples;
+	for (i = first; i < last; i++)
+	{
+		drawSample(cfg->seed, i, u, nrm);
+		for (k = 0; k < MC_SLOTS; k++)
+		{
+			p[k] = sampleDist(dist[k], u[k], nrm[k]);
+		}
+		acc->samples++;
+		if (correction(cfg, p, &out[0], &out[1], &out[2], &dAng) != 0)
+		{
+			acc->rejected++;
+			continue;
+		}
+		statAdd(&acc->dAng, dAng);
+		statAdd(&acc->displacement, EARTHRAD * dAng);
+		for (k = 0; k < 3; k++)
+		{
+			delta[k] = statAdd(&acc->dev[k], out[k] - ref[k]);
+		}
+		for (k = 0; k < 3; k++)
+		{
+			for (j = 0; j < 3; j++)
+			{
+				acc->comoment[3 * k + j] += delta[k] * (out[j] - ref[j] - acc->dev[j].mean);
+			}
+		}
+	}
+}
+
+/*
+------------------------------------------------------
+mcConfigDefault
+
+PURPOSE:		Fill a configuration with the unperturbed model
+INPUT ARGUMENTS:	None
+OUTPUT ARGUMENTS:	*cfg
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	None
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The geometry is left NaN and must be set
+------------------------------------------------------
+*/
+
+void mcConfigDefault(struct mcConfig *cfg)
+{
+	const struct mcDist fixed = { MC_FIXED, 0.0, 0.0 };
+
+	cfg->atmos = ATMOS_SHELL;
+	cfg->x = cfg->y = cfg->z = cfg->a = cfg->b = cfg->c = NAN;
+	cfg->tSealevel = cfg->pSealevel = cfg->lapseRate = cfg->tropopause = fixed;
+	cfg->tSealevel.p1 = 288.15;
+	cfg->pSealevel.p1 = 101325.0;
+	cfg->lapseRate.p1 = 0.0065;
+	cfg->tropopause.p1 = 11000.0;
+	cfg->stationHeight = fixed;
+	cfg->stationHeight.p1 = GS_HEIGHT;
+	cfg->satOffset = fixed;
+	cfg->seed = 0;
+	cfg->samples = 0;
+}
+
+/* Distribution from "fixed v", "normal mean sd" or "uniform lo hi"; -1 if malformed */
+static int parseDist(const char *text, struct mcDist *dist)
+{
+	char kind[16];
+	int fields = sscanf(text, "%15s %lf %lf", kind, &dist->p1, &dist->p2);
+
+	if (fields == 2 && strcmp(kind, "fixed") == 0)
+	{
+		dist->kind = MC_FIXED;
+		return 0;
+	}
+	if (fields == 3 && strcmp(kind, "normal") == 0 && dist->p2 >= 0.0)
+	{
+		dist->kind = MC_NORMAL;
+		return 0;
+	}
+	if (fields == 3 && strcmp(kind, "uniform") == 0 && dist->p2 >= dist->p1)
+	{
+		dist->kind = MC_UNIFORM;
+		return 0;
+	}
+	return -1;
+}
+
+/*
+------------------------------------------------------
+mcConfigLoad
+
+PURPOSE:		Read a configuration file (montecarlo.h)
+INPUT ARGUMENTS:	path
+OUTPUT ARGUMENTS:	*cfg, starting from mcConfigDefault
+RETURNED VALUE:		0 on success, -1 if the file cannot be read, a line is malformed or an
+			atmosphere distribution is given with atmos shell
+FUNCTIONS CALLED:	fgets, mcConfigDefault, parseDist, sscanf
+VER./DATE:		1.1 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The line number of a malformed line is reported on stderr. The shell
+			model has no atmosphere parameters, so T_sealevel, P_sealevel, lapse
+			and tropopause are refused unless atmos is raytrace.
+------------------------------------------------------
+*/
+
+int mcConfigLoad(struct mcConfig *cfg, const char *path)
+{
+	static const struct { const char *key; size_t offset; } dists[] =
+	{
+		{ "T_sealevel", offsetof(struct mcConfig, tSealevel) },
+		{ "P_sealevel", offsetof(struct mcConfig, pSealevel) },
+		{ "lapse", offsetof(struct mcConfig, lapseRate) },
+		{ "tropopause", offsetof(struct mcConfig, tropopause) },
+		{ "station_height", offsetof(struct mcConfig, stationHeight) },
+		{ "sat_offset", offsetof(struct mcConfig, satOffset) }
+	};
+	char line[256], key[32], word[16], *hash;
+	unsigned long long number;
+	int lineNo = 0, atmosLine = 0, ok, n;
+	size_t i;
+	FILE *fp = fopen(path, "r");
+
+	if (fp == NULL)
+	{
+		return -1;
+	}
+	mcConfigDefault(cfg);
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		lineNo++;
+		hash = strchr(line, '#');
+		if (hash != NULL)
+		{
+			*hash = '\0';
+		}
+		if (sscanf(line, "%31s%n", key, &n) != 1)
+		{
+			continue;
+		}
+
+		ok = 0;
+		if (strcmp(key, "samples") == 0)
+		{
+			ok = sscanf(line + n, "%llu", &number) == 1;
+			cfg->samples = number;
+		}
+		else if (strcmp(key, "seed") == 0)
+		{
+			ok = sscanf(line + n, "%llu", &number) == 1;
+			cfg->seed = number;
+		}
+		else if (strcmp(key, "atmos") == 0 && sscanf(line + n, "%15s", word) == 1)
+		{
+			ok = strcmp(word, "shell") == 0 || strcmp(word, "raytrace") == 0;
+			cfg->atmos = strcmp(word, "raytrace") == 0 ? ATMOS_RAYTRACE : ATMOS_SHELL;
+		}
+		else if (strcmp(key, "geometry") == 0)
+		{
+			ok = sscanf(line + n, "%lf %lf %lf %lf %lf %lf", &cfg->x, &cfg->y, &cfg->z,
+				&cfg->a, &cfg->b, &cfg->c) == 6;
+		}
+		else
+		{
+			for (i = 0; i < sizeof(dists) / sizeof(dists[0]); i++)
+			{
+				if (strcmp(key, dists[i].key) == 0)
+				{
+					ok = parseDist(line + n, (struct mcDist *)((char *)cfg + dists[i].offset)) == 0;
+					atmosLine = i < MC_ATMOS_SLOTS && atmosLine == 0 ? lineNo : atmosLine;
+				}
+			}
+		}
+		if (!ok)
+		{
+			fprintf(stderr, "%s:%d: bad setting\n", path, lineNo);
+			fclose(fp);
+			return -1;
+		}
+	}
+	fclose(fp);
+	if (atmosLine != 0 && cfg->atmos != ATMOS_RAYTRACE)
+	{
+		fprintf(stderr, "%s:%d: atmosphere distributions need atmos raytrace\n", path, atmosLine);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+------------------------------------------------------
+refractMonteCarlo
+
+PURPOSE:		Run cfg->samples perturbed corrections and reduce them to moments
+INPUT ARGUMENTS:	pool (NULL to run on the calling thread), cfg
+OUTPUT ARGUMENTS:	*res
+RETURNED VALUE:		0 on success, -1 if the geometry is not set, an atmosphere parameter is
+			drawn with the shell model or memory could not be obtained
+FUNCTIONS CALLED:	accumMerge, centreParams, correction, refractPoolRun, runChunk
+VER./DATE:		1.1 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The result depends on cfg only, not on the pool size. Samples whose
+			atmosphere atmosProfileInit refuses, or whose correction is not finite,
+			are counted in res->rejected and left out of the moments. The shell
+			model ignores the atmosphere parameters, so they must be MC_FIXED
+			unless cfg->atmos is ATMOS_RAYTRACE.
+------------------------------------------------------
+*/
+
+int refractMonteCarlo(struct refractPool *pool, const struct mcConfig *cfg, struct mcResult *res)
+{
+	struct mcAccum total, *part;
+	struct mcArg ma;
+	uint64_t nchunks, round, count, k;
+	double p[MC_SLOTS], dAng;
+	int i;
+
+	memset(res, 0, sizeof(*res));
+	if (!isfinite(cfg->x) || !isfinite(cfg->y) || !isfinite(cfg->z)
+		|| !isfinite(cfg->a) || !isfinite(cfg->b) || !isfinite(cfg->c))
+	{
+		return -1;
+	}
+	if (cfg->atmos != ATMOS_RAYTRACE && (cfg->tSealevel.kind != MC_FIXED || cfg->pSealevel.kind != MC_FIXED
+		|| cfg->lapseRate.kind != MC_FIXED || cfg->tropopause.kind != MC_FIXED))
+	{
+		return -1;
+	}
+	part = malloc(MC_ROUND * sizeof(*part));
+	if (part == NULL)
+	{
+		return -1;
+	}
+
+	centreParams(cfg, p);
+	if (correction(cfg, p, &ma.ref[0], &ma.ref[1], &ma.ref[2], &dAng) != 0)
+	{
+		ma.ref[0] = cfg->a;
+		ma.ref[1] = cfg->b;
+		ma.ref[2] = cfg->c;
+	}
+
+	accumInit(&total);
+	ma.cfg = cfg;
+	ma.part = part;
+	nchunks = (cfg->samples + MC_CHUNK - 1) / MC_CHUNK;
+	for (round = 0; round < nchunks; round += MC_ROUND)
+	{
+		count = nchunks - round < MC_ROUND ? nchunks - round : MC_ROUND;
+		ma.firstChunk = round;
+		if (pool != NULL && refractPoolThreads(pool) > 1 && count > 1)
+		{
+			refractPoolRun(pool, (size_t)count, runChunk, &ma);
+		}
+		else
+		{
+			for (k = 0; k < count; k++)
+			{
+				runChunk(&ma, (size_t)k, 0);
+			}
+		}
+		for (k = 0; k < count; k++)
+		{
+			accumMerge(&total, &part[k]);
+		}
+	}
+	free(part);
+
+	res->d0 = ma.ref[0];
+	res->e0 = ma.ref[1];
+	res->f0 = ma.ref[2];
+	res->samples = total.samples;
+	res->rejected = total.rejected;
+	res->dAng = total.dAng;
+	res->displacement = total.displacement;
+	for (i = 0; i < 3; i++)
+	{
+		res->dev[i] = total.dev[i];
+	}
+	memcpy(res->comoment, total.comoment, sizeof(res->comoment));
+
+	return 0;
+}
+
+static void reportStat(FILE *fp, const char *name, const struct mcStat *st, const char *end)
+{
+	fprintf(fp, "\"%s\": {\"mean\": %.9e, \"sd\": %.9e, \"min\": %.9e, \"max\": %.9e}%s", name, st->mean,
+		st->n > 1 ? sqrt(st->m2 / (double)(st->n - 1)) : 0.0, st->n > 0 ? st->min : 0.0, st->n > 0 ? st->max : 0.0,
+		end);
+}
+
+/*
+------------------------------------------------------
+mcReport
+
+PURPOSE:		Write the result of refractMonteCarlo as JSON
+INPUT ARGUMENTS:	fp, res
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	fprintf, reportStat
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Standard deviations and the covariance use n - 1
+------------------------------------------------------
+*/
+
+void mcReport(FILE *fp, const struct mcResult *res)
+{
+	double n1 = res->dev[0].n > 1 ? (double)(res->dev[0].n - 1) : 1.0;
+	int i;
+
+	fprintf(fp, "{\n\"samples\": %llu,\n\"rejected\": %llu,\n", (unsigned long long)res->samples,
+		(unsigned long long)res->rejected);
+	fprintf(fp, "\"nominal\": [%.6f, %.6f, %.6f],\n", res->d0, res->e0, res->f0);
+	reportStat(fp, "dAng", &res->dAng, ",\n");
+	reportStat(fp, "displacement", &res->displacement, ",\n");
+	fprintf(fp, "\"deviation\": {\n");
+	reportStat(fp, "d", &res->dev[0], ",\n");
+	reportStat(fp, "e", &res->dev[1], ",\n");
+	reportStat(fp, "f", &res->dev[2], "\n},\n");
+	fprintf(fp, "\"covariance\": [");
+	for (i = 0; i < 3; i++)
+	{
+		fprintf(fp, "[%.9e, %.9e, %.9e]%s", res->comoment[3 * i] / n1, res->comoment[3 * i + 1] / n1,
+			res->comoment[3 * i + 2] / n1, i < 2 ? ", " : "]\n}\n");
+	}
+}
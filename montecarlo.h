@@ -0,0 +1,84 @@
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+Monte Carlo sensitivity of the refraction correction to the atmosphere, the
+station height and the spacecraft position
+
+Configuration files are text, one setting per line, '#' starting a comment:
+
+	samples         1000000
+	seed            42
+	atmos           raytrace                        (or shell)
+	geometry        x y z a b c                     (metres, as refractPoint)
+	T_sealevel      normal 288.15 5                 (K)
+	P_sealevel      fixed 101325                    (Pa)
+	lapse           uniform 0.0055 0.0075           (K/m)
+	tropopause      normal 11000 500                (m)
+	station_height  normal 15 2                     (m)
+	sat_offset      normal 0 10                     (m, added to each spacecraft coordinate)
+
+Distributions are "fixed v", "normal mean sd" or "uniform lo hi". Unset
+parameters keep atmosProfileUSSA76, GS_HEIGHT and no offset. The shell model
+has no atmosphere parameters: T_sealevel, P_sealevel, lapse and tropopause
+need atmos raytrace and are refused otherwise.
+*/
+#define MC_FIXED 0
+#define MC_NORMAL 1
+#define MC_UNIFORM 2
+
+#define MC_CHUNK 4096           // Samples per pool chunk
+#define MC_ROUND 256            // Chunks reduced per round; bounds the memory of a run
+
+struct refractPool;
+
+struct mcDist
+{
+	int kind;                       // MC_FIXED, MC_NORMAL or MC_UNIFORM
+	double p1, p2;                  // Value; mean and standard deviation; lower and upper bound
+};
+
+struct mcConfig
+{
+	int atmos;                      // ATMOS_SHELL or ATMOS_RAYTRACE
+	double x, y, z, a, b, c;        // Nominal spacecraft and ground station
+	struct mcDist tSealevel, pSealevel, lapseRate, tropopause;     // atmosProfileInit parameters
+	struct mcDist stationHeight;
+	struct mcDist satOffset;
+	uint64_t seed;
+	uint64_t samples;
+};
+
+/* Streaming moments of one quantity (Welford, merged with Chan et al.) */
+struct mcStat
+{
+	uint64_t n;
+	double mean, m2, min, max;
+};
+
+struct mcResult
+{
+	uint64_t samples;               // Samples drawn
+	uint64_t rejected;              // Samples without a valid atmosphere or a finite correction
+	double d0, e0, f0;              // Correction with every parameter at its centre
+	struct mcStat dAng;             // Angular displacement, in radians
+	struct mcStat displacement;     // Linear displacement EARTHRAD dAng, in metres
+	struct mcStat dev[3];           // Refracted station minus (d0,e0,f0), in metres
+	double comoment[9];             // Sums of products of the dev deviations from their means
+};
+
+/*
+Function prototypes
+*/
+void mcConfigDefault(struct mcConfig *cfg);
+
+int mcConfigLoad(struct mcConfig *cfg, const char *path);
+
+int refractMonteCarlo(struct refractPool *pool, const struct mcConfig *cfg, struct mcResult *res);
+
+void mcReport(FILE *fp, const struct mcResult *res);
+
+#endif
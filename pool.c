@@ -0,0 +1,426 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "refraction.h"
+#include "pool.h"
+
+/*
+------------------------------------------------------
+pool.c
+
+Persistent worker threads for large batches. A job is a number of chunks; the
+chunks are dealt out evenly as one contiguous range per thread. Each thread takes
+chunks from the front of its own range, and a thread that runs dry steals the back
+half of another thread's range. Ranges are packed (begin, end) pairs updated by
+compare-and-swap, so no lock is taken while a job runs.
+
+refractPoolBatch splits the points into chunks of CHUNK_POINTS and runs refractBatch
+on each. Every point is computed by the same kernel whatever chunk it falls in,
+so the results are bit-identical to a single refractBatch call over all n points.
+------------------------------------------------------
+*/
+
+#define CHUNK_POINTS 4096       // Points per chunk; a multiple of every kernel's vector width
+#define CACHE_LINE 64
+
+struct range
+{
+	_Alignas(CACHE_LINE) _Atomic uint64_t span;     // begin chunk in the low 32 bits, end chunk in the high 32 bits
+};
+
+struct refractPool
+{
+	int nthreads;
+	pthread_t *threads;
+	struct range *ranges;
+
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t idle;
+	unsigned long generation;       // Incremented for every job; workers wait for a change
+	int busy;                       // Workers that have not yet finished the current job
+	int stop;
+
+	refractPoolTask task;
+	void *arg;
+};
+
+struct workerArg
+{
+	struct refractPool *pool;
+	int worker;
+};
+
+struct batchArg
+{
+	size_t n;
+	const double *x, *y, *z, *a, *b, *c;
+	double *d, *e, *f;
+};
+
+static uint64_t packSpan(uint32_t begin, uint32_t end)
+{
+	return ((uint64_t)end << 32) | begin;
+}
+
+/* Take one chunk from the front of the worker's own range */
+static int popOwn(struct range *own, size_t *chunk)
+{
+	uint64_t span, next;
+	uint32_t begin, end;
+
+	span = atomic_load(&own->span);
+	do
+	{
+		begin = (uint32_t)span;
+		end = (uint32_t)(span >> 32);
+		if (begin >= end)
+		{
+			return 0;
+		}
+		next = packSpan(begin + 1, end);
+	} while (!atomic_compare_exchange_weak(&own->span, &span, next));
+
+	*chunk = begin;
+	return 1;
+}
+
+/* Move the back half of a victim's range into the thief's (empty) range */
+static int stealHalf(struct range *victim, struct range *own)
+{
+	uint64_t span, next;
+	uint32_t begin, end, half;
+
+	span = atomic_load(&victim->span);
+	do
+	{
+		begin = (uint32_t)span;
+		end = (uint32_t)(span >> 32);
+		if (begin >= end)
+		{
+			return 0;
+		}
+		half = (end - begin + 1) / 2;
+		next = packSpan(begin, end - half);
+	} while (!atomic_compare_exchange_weak(&victim->span, &span, next));
+
+	atomic_store(&own->span, packSpan(end - half, end));
+	return 1;
+}
+
+/*
+------------------------------------------------------
+workLoop
+
+PURPOSE:		Run chunks of the current job until no thread has any left
+INPUT ARGUMENTS:	pool, index of the calling thread
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	popOwn, stealHalf, task
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Victims are scanned starting after the thief, so thieves spread out
+------------------------------------------------------
+*/
+
+static void workLoop(struct refractPool *pool, int worker)
+{
+	struct range *own = &pool->ranges[worker];
+	size_t chunk;
+	int i, stolen;
+
+	for (;;)
+	{
+		while (popOwn(own, &chunk))
+		{
+			pool->task(pool->arg, chunk, worker);
+		}
+
+		stolen = 0;
+		for (i = 1; i < pool->nthreads && !stolen; i++)
+		{
+			stolen = stealHalf(&pool->ranges[(worker + i) % pool->nthreads], own);
+		}
+		if (!stolen)
+		{
+			return;
+		}
+	}
+}
+
+static void *workerMain(void *p)
+{
+	struct workerArg *wa = p;
+	struct refractPool *pool = wa->pool;
+	int worker = wa->worker;
+	unsigned long seen = 0;
+
+	free(wa);
+
+	for (;;)
+	{
+		pthread_mutex_lock(&pool->lock);
+		while (!pool->stop && pool->generation == seen)
+		{
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		}
+		if (pool->stop)
+		{
+			pthread_mutex_unlock(&pool->lock);
+			return NULL;
+		}
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		workLoop(pool, worker);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->busy == 0)
+		{
+			pthread_cond_signal(&pool->idle);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+/*
+------------------------------------------------------
+refractPoolCreate
+
+PURPOSE:		Start a pool of worker threads
+INPUT ARGUMENTS:	nthreads, total number of threads including the caller (0 = one per online CPU)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		New pool, or NULL if memory or threads could not be obtained
+FUNCTIONS CALLED:	calloc, pthread_create, sysconf
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The calling thread of refractPoolRun acts as worker 0,
+			so nthreads - 1 threads are started
+------------------------------------------------------
+*/
+
+struct refractPool *refractPoolCreate(int nthreads)
+{
+	struct refractPool *pool;
+	struct workerArg *wa;
+	int i;
+
+	if (nthreads <= 0)
+	{
+		nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		if (nthreads <= 0)
+		{
+			nthreads = 1;
+		}
+	}
+
+	pool = calloc(1, sizeof(*pool));
+	if (pool == NULL)
+	{
+		return NULL;
+	}
+	pool->threads = calloc((size_t)nthreads, sizeof(*pool->threads));
+	pool->ranges = aligned_alloc(CACHE_LINE, (size_t)nthreads * sizeof(*pool->ranges));
+	if (pool->threads == NULL || pool->ranges == NULL)
+	{
+		free(pool->threads);
+		free(pool->ranges);
+		free(pool);
+		return NULL;
+	}
+	for (i = 0; i < nthreads; i++)
+	{
+		atomic_init(&pool->ranges[i].span, 0);
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->idle, NULL);
+
+	pool->nthreads = 1;
+	for (i = 1; i < nthreads; i++)
+	{
+		wa = malloc(sizeof(*wa));
+		if (wa == NULL)
+		{
+			break;
+		}
+		wa->pool = pool;
+		wa->worker = i;
+		if (pthread_create(&pool->threads[i], NULL, workerMain, wa) != 0)
+		{
+			free(wa);
+			break;
+		}
+		pool->nthreads++;
+	}
+
+	if (pool->nthreads < nthreads)
+	{
+		refractPoolDestroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+/*
+------------------------------------------------------
+refractPoolDestroy
+
+PURPOSE:		Stop and join the worker threads and release the pool
+INPUT ARGUMENTS:	pool (may be NULL)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	free, pthread_join
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Must not be called while a job is running
+------------------------------------------------------
+*/
+
+void refractPoolDestroy(struct refractPool *pool)
+{
+	int i;
+
+	if (pool == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 1; i < pool->nthreads; i++)
+	{
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->wake);
+	pthread_cond_destroy(&pool->idle);
+	free(pool->threads);
+	free(pool->ranges);
+	free(pool);
+
+	return;
+}
+
+int refractPoolThreads(const struct refractPool *pool)
+{
+	return pool->nthreads;
+}
+
+/*
+------------------------------------------------------
+refractPoolRun
+
+PURPOSE:		Run task once for every chunk index in [0, nchunks) across the pool
+INPUT ARGUMENTS:	pool, nchunks, task, arg (passed through to task)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	workLoop
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Returns once every chunk has run. Only one job may run on a pool at a time.
+			nchunks must be below 2^32.
+------------------------------------------------------
+*/
+
+void refractPoolRun(struct refractPool *pool, size_t nchunks, refractPoolTask task, void *arg)
+{
+	size_t per, extra, begin, end;
+	int i;
+
+	if (nchunks == 0)
+	{
+		return;
+	}
+
+	/* Deal out the chunks as one contiguous range per thread */
+	per = nchunks / (size_t)pool->nthreads;
+	extra = nchunks % (size_t)pool->nthreads;
+	begin = 0;
+	for (i = 0; i < pool->nthreads; i++)
+	{
+		end = begin + per + ((size_t)i < extra ? 1 : 0);
+		atomic_store(&pool->ranges[i].span, packSpan((uint32_t)begin, (uint32_t)end));
+		begin = end;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->task = task;
+	pool->arg = arg;
+	pool->busy = pool->nthreads - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	workLoop(pool, 0);
+
+	/* Wait until every worker has left the job before its arguments go out of scope */
+	pthread_mutex_lock(&pool->lock);
+	while (pool->busy > 0)
+	{
+		pthread_cond_wait(&pool->idle, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return;
+}
+
+static void batchChunk(void *p, size_t chunk, int worker)
+{
+	struct batchArg *ba = p;
+	size_t i = chunk * CHUNK_POINTS;
+	size_t m = ba->n - i < CHUNK_POINTS ? ba->n - i : CHUNK_POINTS;
+
+	(void)worker;
+	refractBatch(m, ba->x + i, ba->y + i, ba->z + i, ba->a + i, ba->b + i, ba->c + i,
+		ba->d + i, ba->e + i, ba->f + i);
+}
+
+/*
+------------------------------------------------------
+refractPoolBatch
+
+PURPOSE:		Multithreaded refractBatch
+INPUT ARGUMENTS:	pool, n, spacecraft coordinates (x,y,z) and ground station coordinates (a,b,c) as arrays
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f) as arrays
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	refractBatch, refractPoolRun
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Small batches run on the calling thread only
+------------------------------------------------------
+*/
+
+void refractPoolBatch(struct refractPool *pool, size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	struct batchArg ba;
+
+	if (pool == NULL || pool->nthreads == 1 || n <= CHUNK_POINTS)
+	{
+		refractBatch(n, x, y, z, a, b, c, d, e, f);
+		return;
+	}
+
+	ba.n = n;
+	ba.x = x;
+	ba.y = y;
+	ba.z = z;
+	ba.a = a;
+	ba.b = b;
+	ba.c = c;
+	ba.d = d;
+	ba.e = e;
+	ba.f = f;
+	refractPoolRun(pool, (n + CHUNK_POINTS - 1) / CHUNK_POINTS, batchChunk, &ba);
+
+	return;
+}
@@ -0,0 +1,28 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/*
+Thread pool that splits batch work across cores with work stealing
+*/
+struct refractPool;
+
+/* Task run once per chunk index; worker is the index of the calling thread (0 = caller) */
+typedef void (*refractPoolTask)(void *arg, size_t chunk, int worker);
+
+/*
+Function prototypes
+*/
+struct refractPool *refractPoolCreate(int nthreads);
+
+void refractPoolDestroy(struct refractPool *pool);
+
+int refractPoolThreads(const struct refractPool *pool);
+
+void refractPoolRun(struct refractPool *pool, size_t nchunks, refractPoolTask task, void *arg);
+
+void refractPoolBatch(struct refractPool *pool, size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f);
+
+#endif
@@ -0,0 +1,280 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_RDTSC
+#endif
+#include "profile.h"
+#include "histogram.h"
+
+/*
+------------------------------------------------------
+profile.c
+
+Every thread that records gets its own set of counters and histograms, allocated
+on its first record and pushed onto a global list with compare-and-swap; the
+counters are only ever written by their thread, so recording takes no lock and
+no read-modify-write instruction. profileReport sums the lists of all threads,
+including threads that have exited, so it can run at any time; while other
+threads record, the report may miss their last few calls.
+
+Ticks are converted to ns with the rate of the tick counter against
+CLOCK_MONOTONIC measured between the first record and the report.
+------------------------------------------------------
+*/
+
+#define CALIBRATE_NS 10000000   // Shortest interval for the tick rate; the report waits for it if needed
+
+struct profileStage
+{
+	_Atomic uint64_t calls, nan, domain, ticks, max;
+	_Atomic uint64_t hist[HIST_BUCKETS];
+};
+
+struct profileThread
+{
+	struct profileThread *next;
+	struct profileStage stage[PROFILE_STAGES];
+};
+
+static const char *const stageNames[PROFILE_STAGES] =
+{
+	"satProjection", "zenithAngle", "refractiveIndex", "deltaAngle", "displacement"
+};
+
+static _Atomic(struct profileThread *) threads;
+static _Thread_local struct profileThread *self;
+static _Atomic uint64_t originTicks, originNs;
+static const char *atExitPath;
+
+static uint64_t monotonicNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void bump(_Atomic uint64_t *counter, uint64_t by)
+{
+	atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + by, memory_order_relaxed);
+}
+
+/* Counters of the calling thread, or NULL if they could not be allocated */
+static struct profileThread *threadCounters(void)
+{
+	struct profileThread *t, *head;
+	uint64_t zero = 0;
+
+	if (self != NULL)
+	{
+		return self;
+	}
+	t = calloc(1, sizeof(*t));
+	if (t == NULL)
+	{
+		return NULL;
+	}
+	if (atomic_compare_exchange_strong(&originNs, &zero, monotonicNs()))
+	{
+		atomic_store(&originTicks, profileTicks());
+	}
+	head = atomic_load(&threads);
+	do
+	{
+		t->next = head;
+	} while (!atomic_compare_exchange_weak(&threads, &head, t));
+
+	self = t;
+	return t;
+}
+
+/*
+------------------------------------------------------
+profileTicks
+
+PURPOSE:		Read the stage timer
+INPUT ARGUMENTS:	None
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		Time stamp counter on x86, CLOCK_MONOTONIC in ns elsewhere
+FUNCTIONS CALLED:	__rdtsc, clock_gettime
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			rdtsc is not serializing; a stage of a few ns is only resolved to
+			within the reordering window of the processor
+------------------------------------------------------
+*/
+
+uint64_t profileTicks(void)
+{
+#ifdef PROFILE_RDTSC
+	return __rdtsc();
+#else
+	return monotonicNs();
+#endif
+}
+
+/*
+------------------------------------------------------
+profileRecord
+
+PURPOSE:		Record one call of a stage that started at the given tick
+INPUT ARGUMENTS:	stage (PROFILE_*), start tick, value computed by the stage (for the NaN count)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		Current tick, the start of the next stage for PROFILE_LAP
+FUNCTIONS CALLED:	histBucket, profileTicks, threadCounters
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			None
+------------------------------------------------------
+*/
+
+uint64_t profileRecord(int stage, uint64_t start, double value)
+{
+	struct profileThread *t = threadCounters();
+	struct profileStage *s;
+	uint64_t now = profileTicks(), elapsed = now - start;
+
+	if (t == NULL)
+	{
+		return now;
+	}
+	s = &t->stage[stage];
+	bump(&s->calls, 1);
+	bump(&s->ticks, elapsed);
+	bump(&s->hist[histBucket(elapsed)], 1);
+	if (elapsed > atomic_load_explicit(&s->max, memory_order_relaxed))
+	{
+		atomic_store_explicit(&s->max, elapsed, memory_order_relaxed);
+	}
+	if (isnan(value))
+	{
+		bump(&s->nan, 1);
+	}
+
+	/* Do not charge the bookkeeping to the next stage */
+	return profileTicks();
+}
+
+/* Count a domain error in a stage */
+void profileDomainError(int stage)
+{
+	struct profileThread *t = threadCounters();
+
+	if (t != NULL)
+	{
+		bump(&t->stage[stage].domain, 1);
+	}
+}
+
+/* Percentile in ticks, no higher than the stage maximum (the bucket edge may be) */
+static uint64_t stagePercentile(const uint64_t *h, double fraction, uint64_t max)
+{
+	uint64_t p = histPercentile(h, fraction);
+
+	return p < max ? p : max;
+}
+
+/*
+------------------------------------------------------
+profileReport
+
+PURPOSE:		Write the counters and latency percentiles of every stage, summed over all threads
+INPUT ARGUMENTS:	fp
+OUTPUT ARGUMENTS:	JSON object on fp
+RETURNED VALUE:		0, or -1 on a write error
+FUNCTIONS CALLED:	fprintf, monotonicNs, profileTicks, stagePercentile
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Percentiles are upper bucket edges, within 12.5% above the true value,
+			clamped to the maximum
+------------------------------------------------------
+*/
+
+int profileReport(FILE *fp)
+{
+	uint64_t h[PROFILE_STAGES][HIST_BUCKETS] = { { 0 } };
+	uint64_t calls[PROFILE_STAGES] = { 0 }, nan[PROFILE_STAGES] = { 0 }, domain[PROFILE_STAGES] = { 0 },
+		ticks[PROFILE_STAGES] = { 0 }, max[PROFILE_STAGES] = { 0 }, m;
+	const struct profileThread *t;
+	const char *timer = "clock_gettime";
+	double nsPerTick = 1.0;
+	int i, b, nthreads = 0;
+
+	for (t = atomic_load(&threads); t != NULL; t = t->next, nthreads++)
+	{
+		for (i = 0; i < PROFILE_STAGES; i++)
+		{
+			calls[i] += atomic_load_explicit(&t->stage[i].calls, memory_order_relaxed);
+			nan[i] += atomic_load_explicit(&t->stage[i].nan, memory_order_relaxed);
+			domain[i] += atomic_load_explicit(&t->stage[i].domain, memory_order_relaxed);
+			ticks[i] += atomic_load_explicit(&t->stage[i].ticks, memory_order_relaxed);
+			m = atomic_load_explicit(&t->stage[i].max, memory_order_relaxed);
+			max[i] = m > max[i] ? m : max[i];
+			for (b = 0; b < HIST_BUCKETS; b++)
+			{
+				h[i][b] += atomic_load_explicit(&t->stage[i].hist[b], memory_order_relaxed);
+			}
+		}
+	}
+
+#ifdef PROFILE_RDTSC
+	{
+		uint64_t n0 = atomic_load(&originNs), t0 = atomic_load(&originTicks);
+
+		if (n0 == 0)
+		{
+			n0 = monotonicNs();
+			t0 = profileTicks();
+		}
+		while (monotonicNs() - n0 < CALIBRATE_NS)
+		{
+			;
+		}
+		nsPerTick = (double)(monotonicNs() - n0) / (double)(profileTicks() - t0);
+		timer = "rdtsc";
+	}
+#endif
+
+	fprintf(fp, "{\n\"timer\": \"%s\",\n\"ns_per_tick\": %.6f,\n\"threads\": %d,\n\"stages\": [\n",
+		timer, nsPerTick, nthreads);
+	for (i = 0; i < PROFILE_STAGES; i++)
+	{
+		fprintf(fp, "{\"name\": \"%s\", \"calls\": %llu, \"nan\": %llu, \"domain_errors\": %llu, \"mean_ns\": %.2f, "
+			"\"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, \"p999_ns\": %.1f, \"max_ns\": %.1f}%s\n",
+			stageNames[i], (unsigned long long)calls[i], (unsigned long long)nan[i], (unsigned long long)domain[i],
+			calls[i] > 0 ? (double)ticks[i] * nsPerTick / (double)calls[i] : 0.0,
+			(double)stagePercentile(h[i], 0.5, max[i]) * nsPerTick,
+			(double)stagePercentile(h[i], 0.9, max[i]) * nsPerTick,
+			(double)stagePercentile(h[i], 0.99, max[i]) * nsPerTick,
+			(double)stagePercentile(h[i], 0.999, max[i]) * nsPerTick,
+			(double)max[i] * nsPerTick, i + 1 < PROFILE_STAGES ? "," : "");
+	}
+	fprintf(fp, "]\n}\n");
+
+	return ferror(fp) ? -1 : 0;
+}
+
+static void reportAtExit(void)
+{
+	FILE *fp = fopen(atExitPath, "w");
+
+	if (fp != NULL)
+	{
+		profileReport(fp);
+		fclose(fp);
+	}
+}
+
+/* Write profileReport to path when the program exits */
+void profileReportAtExit(const char *path)
+{
+	if (atExitPath == NULL)
+	{
+		atexit(reportAtExit);
+	}
+	atExitPath = path;
+}
@@ -0,0 +1,46 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+Per-stage instrumentation, compiled in with -DREFRACTION_PROFILE
+
+Each stage records, per thread, its number of calls, a histogram of its time in
+timer ticks (rdtsc on x86, CLOCK_MONOTONIC ns elsewhere), the number of NaN
+results and the number of domain errors (asin of more than 1, pow of a negative
+temperature factor, spacecraft below the surface). Without REFRACTION_PROFILE
+the macros below compile to nothing.
+*/
+#define PROFILE_SAT_PROJECTION 0
+#define PROFILE_ZENITH_ANGLE 1          // Includes satProjection when called as zenithAngle
+#define PROFILE_REFRACTIVE_INDEX 2
+#define PROFILE_DELTA_ANGLE 3           // Includes zenithAngle when called as deltaAngle
+#define PROFILE_DISPLACEMENT 4
+#define PROFILE_STAGES 5
+
+#ifdef REFRACTION_PROFILE
+#define PROFILE_START(t) uint64_t t = profileTicks()
+#define PROFILE_LAP(stage, t, value) ((t) = profileRecord(stage, t, value))
+#define PROFILE_DOMAIN(stage, bad) ((bad) ? profileDomainError(stage) : (void)0)
+#else
+#define PROFILE_START(t) ((void)0)
+#define PROFILE_LAP(stage, t, value) ((void)0)
+#define PROFILE_DOMAIN(stage, bad) ((void)0)
+#endif
+
+/*
+Function prototypes
+*/
+uint64_t profileTicks(void);
+
+uint64_t profileRecord(int stage, uint64_t start, double value);
+
+void profileDomainError(int stage);
+
+int profileReport(FILE *fp);
+
+void profileReportAtExit(const char *path);
+
+#endif
@@ -0,0 +1,353 @@
+#include <math.h>
+#include "refraction.h"
+#include "approx.h"
+#include "raytrace.h"
+
+/*
+------------------------------------------------------
+raytrace.c
+
+Angular displacement of the ground station by ray tracing through a layered,
+spherically symmetric atmosphere, as an alternative to the refracting shell of
+deltaAngle.
+
+Along a ray in a spherically symmetric medium n r sin(z) = k is constant
+(Bouguer's formula), and the central angle swept between radii r0 and r1 is
+the integral of k / (r sqrt(n^2 r^2 - k^2)) dr. The straight line from the
+ground station to the spacecraft has k = r0 sin(z_0). The ray that leaves the
+spacecraft along that line is bent down by the atmosphere and meets the ground
+after sweeping a smaller central angle; the difference is the angular
+displacement dAng:
+
+	dAng = integral from r0 to rTop of  k/r [1/sqrt(r^2 - k^2) - 1/sqrt(n^2 r^2 - k^2)] dr
+
+Substituting r = r0 + u^2 removes the inverse square root behaviour at the
+ground for rays near the horizon. The integral is evaluated with adaptive
+15-point Gauss-Kronrod quadrature, starting from one segment per layer and
+bisecting the segment with the largest error estimate. It is capped at
+RAY_SEGMENTS segments so that the cost of a ray is bounded. Where per-point cost
+matters, raytraceBuildTable tabulates dAng against z_0 once per profile.
+
+The refractivity follows the US Standard Atmosphere 1976 temperature and
+pressure layers with the dry Smith-Weintraub formula, n - 1 = 77.6e-6 P/T
+(P in hPa). The layer base temperatures, pressures and hydrostatic exponents
+are computed once by atmosProfileInit.
+
+REFERENCES:
+U.S. Standard Atmosphere, 1976 (NOAA-S/T 76-1562)
+Smith, E. and Weintraub, S. (1953): The constants in the equation for atmospheric
+			refractive index at radio frequencies
+------------------------------------------------------
+*/
+
+#define G0M_R 0.034163195       // g0 M / R for the US Standard Atmosphere, in K/m
+#define R_GEOPOT 6356766.0      // Earth radius used for geopotential height, in metres
+#define RAY_SEGMENTS 32         // Largest number of quadrature segments per ray
+#define RAY_ABS_TOL 1e-13       // Absolute tolerance on dAng, in radians
+#define RAY_REL_TOL 1e-9        // Relative tolerance on dAng
+
+struct rayArg
+{
+	const struct atmosProfile *p;
+	double r0, k, k2;
+};
+
+/* Standard layer bases above the tropopause and gradients of every layer except the first */
+static const double stdBase[ATMOS_LAYERS + 1] = { 0, 11000, 20000, 32000, 47000, 51000, 71000, 84852 };
+static const double stdLapse[ATMOS_LAYERS] = { -0.0065, 0.0, 0.001, 0.0028, 0.0, -0.0028, -0.002 };
+
+/* 15-point Kronrod abscissae (descending, last is the centre) and weights, and the embedded 7-point Gauss weights */
+static const double xgk[8] = {
+	0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+	0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+	0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+	0.207784955007898467600689403773245, 0.000000000000000000000000000000000
+};
+static const double wgk[8] = {
+	0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+	0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+	0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+	0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+};
+static const double wg[4] = {
+	0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+	0.381830050505118944950369775488975, 0.417959183673469387755102040816327
+};
+
+/*
+------------------------------------------------------
+atmosProfileInit
+
+PURPOSE:		Precompute the layer coefficients of a US Standard Atmosphere type profile
+INPUT ARGUMENTS:	Sea-level temperature (K) and pressure (Pa), tropospheric lapse rate (K/m, positive
+			for temperature falling with height), geopotential height of the tropopause (m)
+OUTPUT ARGUMENTS:	*p
+RETURNED VALUE:		0 on success, -1 if the parameters give no valid profile
+FUNCTIONS CALLED:	exp, pow
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Layers above the tropopause keep their standard base heights and gradients;
+			their temperatures follow from the temperature at the tropopause
+------------------------------------------------------
+*/
+
+int atmosProfileInit(struct atmosProfile *p, double T_sealevel, double P_sealevel, double lapseRate, double tropopause)
+{
+	double dh, tTop;
+	int i;
+
+	if (!(T_sealevel > 0.0) || !(P_sealevel > 0.0) || !(tropopause > 0.0) || !(tropopause < stdBase[2]))
+	{
+		return -1;
+	}
+
+	for (i = 0; i <= ATMOS_LAYERS; i++)
+	{
+		p->base[i] = stdBase[i];
+	}
+	p->base[1] = tropopause;
+	for (i = 0; i < ATMOS_LAYERS; i++)
+	{
+		p->lapse[i] = stdLapse[i];
+	}
+	p->lapse[0] = -lapseRate;
+
+	p->tBase[0] = T_sealevel;
+	p->pBase[0] = P_sealevel;
+	for (i = 0; i < ATMOS_LAYERS; i++)
+	{
+		dh = p->base[i + 1] - p->base[i];
+		tTop = p->tBase[i] + p->lapse[i] * dh;
+		if (!(tTop > 0.0))
+		{
+			return -1;
+		}
+		if (p->lapse[i] == 0.0)
+		{
+			p->expo[i] = G0M_R / p->tBase[i];
+		}
+		else
+		{
+			p->expo[i] = G0M_R / p->lapse[i];
+		}
+		if (i + 1 < ATMOS_LAYERS)
+		{
+			p->tBase[i + 1] = tTop;
+			p->pBase[i + 1] = p->lapse[i] == 0.0 ? p->pBase[i] * exp(-p->expo[i] * dh)
+				: p->pBase[i] * pow(p->tBase[i] / tTop, p->expo[i]);
+		}
+	}
+
+	/* Geometric radius of the top of the profile */
+	p->rTop = EARTHRAD + R_GEOPOT * p->base[ATMOS_LAYERS] / (R_GEOPOT - p->base[ATMOS_LAYERS]);
+
+	return 0;
+}
+
+void atmosProfileUSSA76(struct atmosProfile *p)
+{
+	atmosProfileInit(p, 288.15, 101325.0, 0.0065, 11000.0);
+}
+
+/*
+------------------------------------------------------
+atmosRefractivity
+
+PURPOSE:		Refractivity n - 1 of the profile
+INPUT ARGUMENTS:	p, geometric height above the Earth surface (m)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		n - 1
+FUNCTIONS CALLED:	exp, pow
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Zero above the top of the profile
+------------------------------------------------------
+*/
+
+double atmosRefractivity(const struct atmosProfile *p, double height)
+{
+	double H, T, P;
+	int i;
+
+	if (height < 0.0)
+	{
+		height = 0.0;
+	}
+	H = R_GEOPOT * height / (R_GEOPOT + height);
+	if (H >= p->base[ATMOS_LAYERS])
+	{
+		return 0.0;
+	}
+
+	for (i = 0; i < ATMOS_LAYERS - 1 && H >= p->base[i + 1]; i++)
+	{
+	}
+
+	T = p->tBase[i] + p->lapse[i] * (H - p->base[i]);
+	P = p->lapse[i] == 0.0 ? p->pBase[i] * exp(-p->expo[i] * (H - p->base[i]))
+		: p->pBase[i] * pow(p->tBase[i] / T, p->expo[i]);
+
+	return 77.6e-6 * (P / 100.0) / T;
+}
+
+/* Integrand of dAng after the substitution r = r0 + u^2 */
+static double rayIntegrand(const struct rayArg *ra, double u)
+{
+	double r, n;
+
+	r = ra->r0 + u * u;
+	n = 1.0 + atmosRefractivity(ra->p, r - EARTHRAD);
+
+	return 2.0 * u * ra->k / r * (1.0 / sqrt(r * r - ra->k2) - 1.0 / sqrt(n * n * r * r - ra->k2));
+}
+
+/* 15-point Gauss-Kronrod rule over [lo, hi] with the Kronrod-Gauss difference as error estimate */
+static double gk15(const struct rayArg *ra, double lo, double hi, double *err)
+{
+	double centre, half, fc, f1, f2, resK, resG;
+	int j;
+
+	centre = 0.5 * (lo + hi);
+	half = 0.5 * (hi - lo);
+
+	fc = rayIntegrand(ra, centre);
+	resK = wgk[7] * fc;
+	resG = wg[3] * fc;
+	for (j = 0; j < 7; j++)
+	{
+		f1 = rayIntegrand(ra, centre - half * xgk[j]);
+		f2 = rayIntegrand(ra, centre + half * xgk[j]);
+		resK += wgk[j] * (f1 + f2);
+		if (j % 2 == 1)
+		{
+			resG += wg[j / 2] * (f1 + f2);
+		}
+	}
+
+	*err = fabs((resK - resG) * half);
+	return resK * half;
+}
+
+/*
+------------------------------------------------------
+raytraceDAng
+
+PURPOSE:		Angular displacement of the ground station by ray tracing through a profile
+INPUT ARGUMENTS:	p, station height above the Earth surface (m), zenith angle of the
+			spacecraft at the ground station z_0 (radians)
+OUTPUT ARGUMENTS:	*evals, the number of refractivity evaluations, if evals is not NULL
+RETURNED VALUE:		dAng, in radians; NaN if z_0 is not below the horizon (pi/2)
+FUNCTIONS CALLED:	gk15, sin, sqrt
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			At most 15 * (2 RAY_SEGMENTS - ATMOS_LAYERS) evaluations
+------------------------------------------------------
+*/
+
+double raytraceDAng(const struct atmosProfile *p, double stationHeight, double z_0, int *evals)
+{
+	struct rayArg ra;
+	double lo[RAY_SEGMENTS], hi[RAY_SEGMENTS], val[RAY_SEGMENTS], err[RAY_SEGMENTS];
+	double total, totalErr, mid, rb;
+	int nseg, nsplit, worst, i;
+
+	if (evals != NULL)
+	{
+		*evals = 0;
+	}
+	if (!(z_0 < 2.0 * atan(1.0)))
+	{
+		return NAN;
+	}
+	ra.p = p;
+	ra.r0 = EARTHRAD + stationHeight;
+	if (z_0 <= 0.0 || ra.r0 >= p->rTop)
+	{
+		return 0.0;
+	}
+	ra.k = ra.r0 * sin(z_0);
+	ra.k2 = ra.k * ra.k;
+
+	/* Start with one segment per layer, so that the kinks of the profile fall on segment ends */
+	nseg = 0;
+	total = 0.0;
+	totalErr = 0.0;
+	for (i = 1; i <= ATMOS_LAYERS; i++)
+	{
+		rb = EARTHRAD + R_GEOPOT * p->base[i] / (R_GEOPOT - p->base[i]);
+		if (rb <= ra.r0)
+		{
+			continue;
+		}
+		lo[nseg] = nseg == 0 ? 0.0 : hi[nseg - 1];
+		hi[nseg] = i == ATMOS_LAYERS ? sqrt(p->rTop - ra.r0) : sqrt(rb - ra.r0);
+		val[nseg] = gk15(&ra, lo[nseg], hi[nseg], &err[nseg]);
+		total += val[nseg];
+		totalErr += err[nseg];
+		nseg++;
+	}
+	nsplit = 0;
+
+	while (totalErr > RAY_ABS_TOL && totalErr > RAY_REL_TOL * fabs(total) && nseg < RAY_SEGMENTS)
+	{
+		/* Bisect the segment with the largest error estimate */
+		worst = 0;
+		for (i = 1; i < nseg; i++)
+		{
+			if (err[i] > err[worst])
+			{
+				worst = i;
+			}
+		}
+		mid = 0.5 * (lo[worst] + hi[worst]);
+		lo[nseg] = mid;
+		hi[nseg] = hi[worst];
+		hi[worst] = mid;
+		val[worst] = gk15(&ra, lo[worst], hi[worst], &err[worst]);
+		val[nseg] = gk15(&ra, lo[nseg], hi[nseg], &err[nseg]);
+		nseg++;
+		nsplit++;
+
+		total = 0.0;
+		totalErr = 0.0;
+		for (i = 0; i < nseg; i++)
+		{
+			total += val[i];
+			totalErr += err[i];
+		}
+	}
+
+	if (evals != NULL)
+	{
+		*evals = 15 * (nseg + nsplit);
+	}
+	return total;
+}
+
+static double fixedDAng(void *arg, double z_0)
+{
+	const struct raytraceFixed *fixed = arg;
+
+	return raytraceDAng(fixed->profile, fixed->stationHeight, z_0, NULL);
+}
+
+/*
+------------------------------------------------------
+raytraceBuildTable
+
+PURPOSE:		Tabulate the ray traced dAng for one profile and station height
+INPUT ARGUMENTS:	fixed (profile and station height; must outlive the table), z0Max (radians), nCells
+OUTPUT ARGUMENTS:	*tbl
+RETURNED VALUE:		0 on success, -1 on failure
+FUNCTIONS CALLED:	refractApproxBuildFn
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Set refractModel.table to the result to make ATMOS_RAYTRACE a table lookup per point.
+			tbl->maxError holds the worst-case table error against raytraceDAng.
+------------------------------------------------------
+*/
+
+int raytraceBuildTable(struct refractApprox *tbl, struct raytraceFixed *fixed, double z0Max, int nCells)
+{
+	return refractApproxBuildFn(tbl, z0Max, nCells, fixedDAng, fixed);
+}
@@ -0,0 +1,41 @@
+#ifndef RAYTRACE_H
+#define RAYTRACE_H
+
+/*
+Layered atmosphere for ray tracing (US Standard Atmosphere 1976 up to 84.852 km geopotential)
+*/
+#define ATMOS_LAYERS 7
+
+struct refractApprox;
+
+struct atmosProfile
+{
+	double base[ATMOS_LAYERS + 1];  // Geopotential base height of each layer and the top of the profile, in metres
+	double lapse[ATMOS_LAYERS];     // Temperature gradient in each layer, in K/m
+	double tBase[ATMOS_LAYERS];     // Temperature at the base of each layer, in K
+	double pBase[ATMOS_LAYERS];     // Pressure at the base of each layer, in Pa
+	double expo[ATMOS_LAYERS];      // Hydrostatic exponent g0 M / (R lapse), or g0 M / (R T) in isothermal layers
+	double rTop;                    // Distance of the top of the profile from Earth centre, in metres
+};
+
+/* Ray traced displacement model for a fixed profile and station height, see raytraceBuildTable */
+struct raytraceFixed
+{
+	const struct atmosProfile *profile;
+	double stationHeight;
+};
+
+/*
+Function prototypes
+*/
+int atmosProfileInit(struct atmosProfile *p, double T_sealevel, double P_sealevel, double lapseRate, double tropopause);
+
+void atmosProfileUSSA76(struct atmosProfile *p);
+
+double atmosRefractivity(const struct atmosProfile *p, double height);
+
+double raytraceDAng(const struct atmosProfile *p, double stationHeight, double z_0, int *evals);
+
+int raytraceBuildTable(struct refractApprox *tbl, struct raytraceFixed *fixed, double z0Max, int nCells);
+
+#endif
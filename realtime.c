@@ -0,0 +1,462 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "refraction.h"
+#include "realtime.h"
+#include "histogram.h"
+
+/*
+------------------------------------------------------
+realtime.c
+
+The caller's producer thread pushes spacecraft states into the input ring; a
+consumer thread, optionally pinned to a core, pops them, applies
+refractPointModel (satProjection -> zenithAngle -> deltaAngle and the
+displacement) and pushes the pointing into the output ring, from which the
+caller's controller thread polls.
+
+Each ring has exactly one producer and one consumer. The producer owns the tail
+and the consumer the head, each on its own cache line; a slot is handed over by
+a release store of the index and picked up by an acquire load. Each side keeps
+a private copy of the other side's index and reloads it only when the ring
+looks full (or empty), so in steady state neither side reads the other's line.
+Rings and the latency histogram are allocated by refractRealtimeStart; after
+that nothing allocates, locks or makes a system call except clock_gettime
+(vDSO) and, when the input ring stays empty, sched_yield.
+
+The latency of a state is measured from its stamp to the moment the pointing is
+pushed into the output ring. A full ring is never waited on: the state or the
+pointing is dropped and counted, since a late pointing is of no use to the
+controller.
+------------------------------------------------------
+*/
+
+#define CACHE_LINE 64
+#define RT_IDLE_SPINS 4096      // Empty polls of the input ring between sched_yield calls
+
+union rtSlot
+{
+	struct rtState state;
+	struct rtPointing pointing;
+};
+
+struct rtRing
+{
+	_Alignas(CACHE_LINE) _Atomic size_t tail;       // Written by the producer
+	size_t headSeen;                                // Producer's last view of head
+	_Alignas(CACHE_LINE) _Atomic size_t head;       // Written by the consumer
+	size_t tailSeen;                                // Consumer's last view of tail
+	_Alignas(CACHE_LINE) size_t mask;
+	union rtSlot *slots;
+};
+
+struct refractRealtime
+{
+	struct rtRing in, out;
+	const struct refractModel *model;
+	uint64_t deadline;
+	pthread_t thread;
+	_Atomic int stop;
+
+	/* Written only by the consumer thread, except droppedIn by the producer */
+	_Alignas(CACHE_LINE) _Atomic uint64_t processed;
+	_Atomic uint64_t missed;
+	_Atomic uint64_t droppedOut;
+	_Atomic uint64_t maxLatency;
+	_Atomic uint64_t hist[HIST_BUCKETS];
+	_Alignas(CACHE_LINE) _Atomic uint64_t droppedIn;
+};
+
+static void cpuRelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+/* Single-writer counter update; readers may see it late but never torn */
+static void bump(_Atomic uint64_t *counter, uint64_t by)
+{
+	atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + by, memory_order_relaxed);
+}
+
+static int ringInit(struct rtRing *r, size_t capacity)
+{
+	size_t n = 2;
+
+	while (n < capacity)
+	{
+		n <<= 1;
+	}
+	r->slots = aligned_alloc(CACHE_LINE, n * sizeof(union rtSlot));
+	if (r->slots == NULL)
+	{
+		return -1;
+	}
+	memset(r->slots, 0, n * sizeof(union rtSlot));
+	r->mask = n - 1;
+	r->headSeen = 0;
+	r->tailSeen = 0;
+	atomic_init(&r->head, 0);
+	atomic_init(&r->tail, 0);
+	return 0;
+}
+
+/* Producer side: claim the next slot, or NULL if the ring is full */
+static union rtSlot *ringSlot(struct rtRing *r)
+{
+	size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+	if (tail - r->headSeen > r->mask)
+	{
+		r->headSeen = atomic_load_explicit(&r->head, memory_order_acquire);
+		if (tail - r->headSeen > r->mask)
+		{
+			return NULL;
+		}
+	}
+	return &r->slots[tail & r->mask];
+}
+
+static void ringPublish(struct rtRing *r)
+{
+	atomic_store_explicit(&r->tail, atomic_load_explicit(&r->tail, memory_order_relaxed) + 1, memory_order_release);
+}
+
+/* Consumer side: the oldest filled slot, or NULL if the ring is empty */
+static union rtSlot *ringFront(struct rtRing *r)
+{
+	size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+	if (head == r->tailSeen)
+	{
+		r->tailSeen = atomic_load_explicit(&r->tail, memory_order_acquire);
+		if (head == r->tailSeen)
+		{
+			return NULL;
+		}
+	}
+	return &r->slots[head & r->mask];
+}
+
+static void ringRelease(struct rtRing *r)
+{
+	atomic_store_explicit(&r->head, atomic_load_explicit(&r->head, memory_order_relaxed) + 1, memory_order_release);
+}
+
+/*
+------------------------------------------------------
+rtNow
+
+PURPOSE:		Monotonic time for state stamps
+INPUT ARGUMENTS:	None
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		CLOCK_MONOTONIC time in ns
+FUNCTIONS CALLED:	clock_gettime
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			None
+------------------------------------------------------
+*/
+
+uint64_t rtNow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/*
+------------------------------------------------------
+rtPinThread
+
+PURPOSE:		Pin the calling thread to one CPU
+INPUT ARGUMENTS:	cpu (negative to leave the thread unpinned)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		0 on success, -1 if the affinity could not be set
+FUNCTIONS CALLED:	pthread_setaffinity_np
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			For the producer and controller threads; the consumer is pinned
+			by refractRealtimeStart
+------------------------------------------------------
+*/
+
+int rtPinThread(int cpu)
+{
+	cpu_set_t set;
+
+	if (cpu < 0)
+	{
+		return 0;
+	}
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+static void *consumerMain(void *p)
+{
+	struct refractRealtime *rt = p;
+	const union rtSlot *in;
+	union rtSlot *out;
+	struct rtState s;
+	double d, e, f;
+	uint64_t latency;
+	int idle = 0;
+
+	while (!atomic_load_explicit(&rt->stop, memory_order_relaxed))
+	{
+		in = ringFront(&rt->in);
+		if (in == NULL)
+		{
+			if (++idle >= RT_IDLE_SPINS)
+			{
+				sched_yield();
+				idle = 0;
+			}
+			cpuRelax();
+			continue;
+		}
+		idle = 0;
+		s = in->state;
+		ringRelease(&rt->in);
+
+		refractPointModel(rt->model, s.x, s.y, s.z, s.a, s.b, s.c, &d, &e, &f, NULL);
+
+		out = ringSlot(&rt->out);
+		latency = rtNow() - s.stamp;
+		if (out == NULL)
+		{
+			bump(&rt->droppedOut, 1);
+		}
+		else
+		{
+			out->pointing.seq = s.seq;
+			out->pointing.stamp = s.stamp;
+			out->pointing.latency = latency;
+			out->pointing.d = d;
+			out->pointing.e = e;
+			out->pointing.f = f;
+			ringPublish(&rt->out);
+		}
+
+		bump(&rt->processed, 1);
+		if (latency > rt->deadline)
+		{
+			bump(&rt->missed, 1);
+		}
+		if (latency > atomic_load_explicit(&rt->maxLatency, memory_order_relaxed))
+		{
+			atomic_store_explicit(&rt->maxLatency, latency, memory_order_relaxed);
+		}
+		bump(&rt->hist[histBucket(latency)], 1);
+	}
+
+	return NULL;
+}
+
+/*
+------------------------------------------------------
+refractRealtimeStart
+
+PURPOSE:		Allocate the rings and start the refraction consumer thread
+INPUT ARGUMENTS:	model (NULL for the refracting shell of deltaAngle), capacity of each ring
+			(rounded up to a power of 2), deadline in ns (0 for RT_DEADLINE_NS),
+			cpu for the consumer thread (negative to leave it unpinned)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		New pipeline, or NULL if memory could not be obtained, the thread
+			could not be started or not pinned to cpu
+FUNCTIONS CALLED:	aligned_alloc, pthread_attr_setaffinity_np, pthread_create, ringInit
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			*model must stay valid until refractRealtimeStop. The consumer
+			busy-polls, so give it a core of its own.
+------------------------------------------------------
+*/
+
+struct refractRealtime *refractRealtimeStart(const struct refractModel *model, size_t capacity, uint64_t deadline,
+	int cpu)
+{
+	struct refractRealtime *rt;
+	pthread_attr_t attr;
+	cpu_set_t set;
+	int status;
+
+	rt = aligned_alloc(CACHE_LINE, sizeof(*rt));
+	if (rt == NULL)
+	{
+		return NULL;
+	}
+	memset(rt, 0, sizeof(*rt));
+	if (ringInit(&rt->in, capacity) != 0 || ringInit(&rt->out, capacity) != 0)
+	{
+		free(rt->in.slots);
+		free(rt);
+		return NULL;
+	}
+	rt->model = model;
+	rt->deadline = deadline > 0 ? deadline : RT_DEADLINE_NS;
+	atomic_init(&rt->stop, 0);
+
+	/* A CPU beyond cpu_set_t would leave the set empty; refuse it like one the system lacks */
+	pthread_attr_init(&attr);
+	status = 0;
+	if (cpu >= 0)
+	{
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		status = cpu < CPU_SETSIZE ? pthread_attr_setaffinity_np(&attr, sizeof(set), &set) : EINVAL;
+	}
+	if (status == 0)
+	{
+		status = pthread_create(&rt->thread, &attr, consumerMain, rt);
+	}
+	pthread_attr_destroy(&attr);
+	if (status != 0)
+	{
+		free(rt->in.slots);
+		free(rt->out.slots);
+		free(rt);
+		return NULL;
+	}
+
+	return rt;
+}
+
+/*
+------------------------------------------------------
+refractRealtimePush
+
+PURPOSE:		Hand one spacecraft state to the consumer thread
+INPUT ARGUMENTS:	rt, *s (a zero stamp is replaced by the current time)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		0 if queued, -1 if the input ring was full (the state is dropped and counted)
+FUNCTIONS CALLED:	ringPublish, ringSlot, rtNow
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Must always be called from the same thread
+------------------------------------------------------
+*/
+
+int refractRealtimePush(struct refractRealtime *rt, const struct rtState *s)
+{
+	union rtSlot *slot = ringSlot(&rt->in);
+
+	if (slot == NULL)
+	{
+		bump(&rt->droppedIn, 1);
+		return -1;
+	}
+	slot->state = *s;
+	if (slot->state.stamp == 0)
+	{
+		slot->state.stamp = rtNow();
+	}
+	ringPublish(&rt->in);
+	return 0;
+}
+
+/*
+------------------------------------------------------
+refractRealtimePoll
+
+PURPOSE:		Take the oldest published pointing
+INPUT ARGUMENTS:	rt
+OUTPUT ARGUMENTS:	*p
+RETURNED VALUE:		1 if a pointing was taken, 0 if none is waiting
+FUNCTIONS CALLED:	ringFront, ringRelease
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Must always be called from the same thread (which may be the producer's)
+------------------------------------------------------
+*/
+
+int refractRealtimePoll(struct refractRealtime *rt, struct rtPointing *p)
+{
+	const union rtSlot *slot = ringFront(&rt->out);
+
+	if (slot == NULL)
+	{
+		return 0;
+	}
+	*p = slot->pointing;
+	ringRelease(&rt->out);
+	return 1;
+}
+
+/*
+------------------------------------------------------
+refractRealtimeStats
+
+PURPOSE:		Counters and latency percentiles so far
+INPUT ARGUMENTS:	rt
+OUTPUT ARGUMENTS:	*stats
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	histPercentile
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			May be called from any thread while the pipeline runs; the counters are
+			then read one by one and may disagree by the states in flight.
+			Percentiles are upper bucket edges, within 12.5% above the true value.
+------------------------------------------------------
+*/
+
+void refractRealtimeStats(struct refractRealtime *rt, struct rtStats *stats)
+{
+	uint64_t h[HIST_BUCKETS];
+	int i;
+
+	stats->processed = atomic_load_explicit(&rt->processed, memory_order_relaxed);
+	stats->missed = atomic_load_explicit(&rt->missed, memory_order_relaxed);
+	stats->droppedIn = atomic_load_explicit(&rt->droppedIn, memory_order_relaxed);
+	stats->droppedOut = atomic_load_explicit(&rt->droppedOut, memory_order_relaxed);
+	stats->max = atomic_load_explicit(&rt->maxLatency, memory_order_relaxed);
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+	{
+		h[i] = atomic_load_explicit(&rt->hist[i], memory_order_relaxed);
+	}
+	stats->p50 = histPercentile(h, 0.5);
+	stats->p90 = histPercentile(h, 0.9);
+	stats->p99 = histPercentile(h, 0.99);
+	stats->p999 = histPercentile(h, 0.999);
+	stats->p50 = stats->p50 < stats->max ? stats->p50 : stats->max;
+	stats->p90 = stats->p90 < stats->max ? stats->p90 : stats->max;
+	stats->p99 = stats->p99 < stats->max ? stats->p99 : stats->max;
+	stats->p999 = stats->p999 < stats->max ? stats->p999 : stats->max;
+}
+
+/*
+------------------------------------------------------
+refractRealtimeStop
+
+PURPOSE:		Stop the consumer thread and free the pipeline
+INPUT ARGUMENTS:	rt
+OUTPUT ARGUMENTS:	Final counters and percentiles in *stats if stats is not NULL
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	free, pthread_join, refractRealtimeStats
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			States still in the input ring are discarded
+------------------------------------------------------
+*/
+
+void refractRealtimeStop(struct refractRealtime *rt, struct rtStats *stats)
+{
+	atomic_store(&rt->stop, 1);
+	pthread_join(rt->thread, NULL);
+	if (stats != NULL)
+	{
+		refractRealtimeStats(rt, stats);
+	}
+	free(rt->in.slots);
+	free(rt->out.slots);
+	free(rt);
+}
@@ -0,0 +1,61 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Real-time pointing: spacecraft states in, refracted pointing out, through two
+lock-free single producer / single consumer rings and a pinned consumer thread
+*/
+#define RT_DEADLINE_NS 1000000  // Default budget from state stamp to published pointing, in ns (1 ms)
+
+struct refractModel;
+struct refractRealtime;
+
+/* Producer side: one spacecraft state and the station to point at */
+struct rtState
+{
+	uint64_t seq;                   // Caller's sequence number, copied to the pointing
+	uint64_t stamp;                 // CLOCK_MONOTONIC time the state became available, in ns (0 = stamp on push)
+	double x, y, z;                 // Spacecraft coordinates
+	double a, b, c;                 // Unrefracted ground station coordinates
+};
+
+/* Consumer side: the refracted station for one state */
+struct rtPointing
+{
+	uint64_t seq;
+	uint64_t stamp;                 // Stamp of the state
+	uint64_t latency;               // From stamp to publication, in ns
+	double d, e, f;                 // Refracted ground station coordinates
+};
+
+struct rtStats
+{
+	uint64_t processed;             // States refracted and published
+	uint64_t missed;                // Of those, published later than the deadline
+	uint64_t droppedIn;             // Calls of refractRealtimePush refused because the input ring was full
+	uint64_t droppedOut;            // Pointings discarded because the output ring was full
+	uint64_t p50, p90, p99, p999, max;      // Latency percentiles and maximum, in ns (upper bucket edges)
+};
+
+/*
+Function prototypes
+*/
+uint64_t rtNow(void);
+
+int rtPinThread(int cpu);
+
+struct refractRealtime *refractRealtimeStart(const struct refractModel *model, size_t capacity, uint64_t deadline,
+	int cpu);
+
+int refractRealtimePush(struct refractRealtime *rt, const struct rtState *s);
+
+int refractRealtimePoll(struct refractRealtime *rt, struct rtPointing *p);
+
+void refractRealtimeStats(struct refractRealtime *rt, struct rtStats *stats);
+
+void refractRealtimeStop(struct refractRealtime *rt, struct rtStats *stats);
+
+#endif
@@ -0,0 +1,338 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "refractd.h"
+
+/*
+------------------------------------------------------
+refractd-client.c
+
+Client side of the refraction daemon protocol (refractd.h). Each call sends
+one request and waits for its reply, so a socket must be used by one thread
+at a time; threads that want to run requests concurrently open a socket each,
+and the daemon coalesces their points into shared batches.
+
+Nothing here links the refraction code: a client needs only this file and
+refractd.h.
+------------------------------------------------------
+*/
+
+static uint64_t nextTag = 1;
+
+/* Send one request, with a descriptor if fd >= 0, and receive the reply with the same tag */
+static int exchange(int sock, struct rdHeader *h, const void *body, size_t len, int fd, void *reply,
+	size_t replyLen)
+{
+	union
+	{
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} ctl;
+	struct iovec iov[2];
+	struct msghdr msg;
+	struct rdHeader r;
+	ssize_t got;
+
+	h->magic = RD_MAGIC;
+	h->tag = __atomic_fetch_add(&nextTag, 1, __ATOMIC_RELAXED);
+	iov[0].iov_base = h;
+	iov[0].iov_len = sizeof(*h);
+	iov[1].iov_base = (void *)body;
+	iov[1].iov_len = len;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = len > 0 ? 2 : 1;
+	if (fd >= 0)
+	{
+		memset(&ctl, 0, sizeof(ctl));
+		msg.msg_control = ctl.buf;
+		msg.msg_controllen = sizeof(ctl.buf);
+		CMSG_FIRSTHDR(&msg)->cmsg_level = SOL_SOCKET;
+		CMSG_FIRSTHDR(&msg)->cmsg_type = SCM_RIGHTS;
+		CMSG_FIRSTHDR(&msg)->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(CMSG_FIRSTHDR(&msg)), &fd, sizeof(int));
+	}
+	while (sendmsg(sock, &msg, MSG_NOSIGNAL) < 0)
+	{
+		if (errno != EINTR)
+		{
+			return RD_EIO;
+		}
+	}
+
+	/* Replies to requests abandoned by an earlier failed call are skipped */
+	do
+	{
+		iov[0].iov_base = &r;
+		iov[0].iov_len = sizeof(r);
+		iov[1].iov_base = reply;
+		iov[1].iov_len = replyLen;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = replyLen > 0 ? 2 : 1;
+		got = recvmsg(sock, &msg, 0);
+		if (got < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (got < (ssize_t)sizeof(r) || r.magic != RD_MAGIC)
+		{
+			return RD_EIO;
+		}
+	} while (r.tag != h->tag);
+
+	if (r.status == 0 && (size_t)got != sizeof(r) + (r.op == RD_OP_REFRACT ? r.count * 3 * sizeof(double) : replyLen))
+	{
+		return RD_EPROTO;
+	}
+	return r.status;
+}
+
+/*
+------------------------------------------------------
+refractClientConnect
+
+PURPOSE:		Connect to the refraction daemon
+INPUT ARGUMENTS:	Socket path (NULL for RD_SOCKET)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		Connected socket, or -1
+FUNCTIONS CALLED:	connect, socket
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Close the socket with close(); the daemon then drops any attached segment
+------------------------------------------------------
+*/
+
+int refractClientConnect(const char *path)
+{
+	struct sockaddr_un addr;
+	int sock;
+
+	path = path != NULL ? path : RD_SOCKET;
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+	{
+		return -1;
+	}
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+/*
+------------------------------------------------------
+refractClientBatch
+
+PURPOSE:		refractBatch (or refractBatchWgs84) through the daemon
+INPUT ARGUMENTS:	sock, flags (0 or RD_WGS84), number of points n, columns of spacecraft
+			(x,y,z) and unrefracted ground station (a,b,c) coordinates
+OUTPUT ARGUMENTS:	Columns of refracted ground station coordinates (d,e,f)
+RETURNED VALUE:		0, or a negative RD_E* code
+FUNCTIONS CALLED:	exchange, free, malloc
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Sent in packets of at most RD_MAX_POINTS points, one at a time;
+			for many points refractClientShmBatch saves the copies
+------------------------------------------------------
+*/
+
+int refractClientBatch(int sock, int flags, size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f)
+{
+	size_t m = n < RD_MAX_POINTS ? n : RD_MAX_POINTS, i, k;
+	struct rdHeader h;
+	double *in, *out;
+	int status = 0;
+
+	if (n == 0)
+	{
+		return 0;
+	}
+	in = malloc(m * 9 * sizeof(double));
+	if (in == NULL)
+	{
+		return RD_EIO;
+	}
+	out = in + m * 6;
+
+	for (i = 0; i < n && status == 0; i += m)
+	{
+		m = n - i < RD_MAX_POINTS ? n - i : RD_MAX_POINTS;
+		for (k = 0; k < m; k++)
+		{
+			in[6 * k] = x[i + k];
+			in[6 * k + 1] = y[i + k];
+			in[6 * k + 2] = z[i + k];
+			in[6 * k + 3] = a[i + k];
+			in[6 * k + 4] = b[i + k];
+			in[6 * k + 5] = c[i + k];
+		}
+		memset(&h, 0, sizeof(h));
+		h.op = RD_OP_REFRACT;
+		h.flags = (uint16_t)flags;
+		h.count = (uint32_t)m;
+		status = exchange(sock, &h, in, m * 6 * sizeof(double), -1, out, m * 3 * sizeof(double));
+		for (k = 0; k < m && status == 0; k++)
+		{
+			d[i + k] = out[3 * k];
+			e[i + k] = out[3 * k + 1];
+			f[i + k] = out[3 * k + 2];
+		}
+	}
+
+	free(in);
+	return status;
+}
+
+/*
+------------------------------------------------------
+refractClientShmCreate
+
+PURPOSE:		Create a shared segment for bulk requests and attach it to the daemon
+INPUT ARGUMENTS:	sock, capacity in points
+OUTPUT ARGUMENTS:	*shm, with columns x..f of capacity doubles each
+RETURNED VALUE:		0, or a negative RD_E* code
+FUNCTIONS CALLED:	exchange, fcntl, ftruncate, memfd_create, mmap
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The segment is a memfd sealed against shrinking. A later call on the
+			same socket replaces the daemon's segment.
+------------------------------------------------------
+*/
+
+int refractClientShmCreate(int sock, size_t capacity, struct rdShm *shm)
+{
+	struct rdHeader h;
+	double *base;
+	int fd, status;
+
+	memset(shm, 0, sizeof(*shm));
+	if (capacity == 0 || capacity > UINT32_MAX)
+	{
+		return RD_EPROTO;
+	}
+	fd = memfd_create("refractd", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0)
+	{
+		return RD_EATTACH;
+	}
+	shm->size = capacity * 9 * sizeof(double);
+	if (ftruncate(fd, (off_t)shm->size) != 0 || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) != 0)
+	{
+		close(fd);
+		return RD_EATTACH;
+	}
+	base = mmap(NULL, shm->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED)
+	{
+		close(fd);
+		return RD_EATTACH;
+	}
+
+	memset(&h, 0, sizeof(h));
+	h.op = RD_OP_ATTACH;
+	h.offset = shm->size;
+	status = exchange(sock, &h, NULL, 0, fd, NULL, 0);
+	close(fd);
+	if (status != 0)
+	{
+		munmap(base, shm->size);
+		shm->size = 0;
+		return status;
+	}
+
+	shm->capacity = capacity;
+	shm->x = base;
+	shm->y = base + capacity;
+	shm->z = base + 2 * capacity;
+	shm->a = base + 3 * capacity;
+	shm->b = base + 4 * capacity;
+	shm->c = base + 5 * capacity;
+	shm->d = base + 6 * capacity;
+	shm->e = base + 7 * capacity;
+	shm->f = base + 8 * capacity;
+	return 0;
+}
+
+/*
+------------------------------------------------------
+refractClientShmBatch
+
+PURPOSE:		Refract the first n points of a shared segment in place
+INPUT ARGUMENTS:	sock, flags (0 or RD_WGS84), *shm with x..c filled in, n <= shm->capacity
+OUTPUT ARGUMENTS:	shm->d, shm->e, shm->f
+RETURNED VALUE:		0, or a negative RD_E* code
+FUNCTIONS CALLED:	exchange
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The daemon computes on the segment while the call waits
+------------------------------------------------------
+*/
+
+int refractClientShmBatch(int sock, int flags, struct rdShm *shm, size_t n)
+{
+	struct rdHeader h;
+
+	if (n > shm->capacity)
+	{
+		return RD_ENOSHM;
+	}
+	memset(&h, 0, sizeof(h));
+	h.op = RD_OP_SHM_REFRACT;
+	h.flags = (uint16_t)flags;
+	h.count = (uint32_t)n;
+	h.stride = (uint32_t)shm->capacity;
+	h.offset = 0;
+	return exchange(sock, &h, NULL, 0, -1, NULL, 0);
+}
+
+void refractClientShmClose(struct rdShm *shm)
+{
+	if (shm->size > 0)
+	{
+		munmap(shm->x, shm->size);
+	}
+	memset(shm, 0, sizeof(*shm));
+}
+
+/*
+------------------------------------------------------
+refractClientStats
+
+PURPOSE:		Throughput and latency counters of the daemon
+INPUT ARGUMENTS:	sock
+OUTPUT ARGUMENTS:	*stats
+RETURNED VALUE:		0, or a negative RD_E* code
+FUNCTIONS CALLED:	exchange
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Latencies are measured inside the daemon, from receipt of a request
+			to the send of its reply
+------------------------------------------------------
+*/
+
+int refractClientStats(int sock, struct rdStats *stats)
+{
+	struct rdHeader h;
+
+	memset(&h, 0, sizeof(h));
+	h.op = RD_OP_STATS;
+	return exchange(sock, &h, NULL, 0, -1, stats, sizeof(*stats));
+}
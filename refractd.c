@@ -0,0 +1,801 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "refraction.h"
+#include "pool.h"
+#include "realtime.h"
+#include "refractd.h"
+#include "histogram.h"
+
+/*
+------------------------------------------------------
+refractd.c
+
+Refraction daemon: serves the protocol of refractd.h on a Unix domain socket
+so that planning and tracking processes on the host get corrections without
+linking or warming up the math themselves.
+
+One thread runs an epoll loop over the listening socket, the clients, a
+timerfd and a signalfd. Every readable client is drained of its packets.
+Points of RD_OP_REFRACT requests are copied into one of two coalescing queues
+(sphere and WGS84), held as columns for refractBatch / refractBatchWgs84. A
+queue is run and its replies sent as soon as it holds the batch size, or once
+its oldest request has waited the coalescing window; the timerfd wakes the
+loop for the window. With a window of 0 a queue is run whenever the loop has
+drained every ready client, so concurrent requests still share a batch but
+none ever waits for company.
+
+RD_OP_SHM_REFRACT runs at once on the caller's block through refractPoolBatch
+(refractBatchWgs84 for RD_WGS84), with no copy in either direction. While it
+runs the loop serves no one else, so bulk callers hold small ones up by the
+duration of their block. Segments must be memfds sealed with F_SEAL_SHRINK:
+a client that could shrink its segment could fault the daemon with SIGBUS.
+
+Replies are sent without blocking. A client whose socket buffer is full has
+stopped reading and is disconnected; queued replies for a client that has
+gone are discarded, recognised by a generation count since the slot may have
+been reused.
+
+SIGUSR1 prints the counters to stderr; SIGINT and SIGTERM print them and exit.
+
+BUILD:			refraction.c must be compiled with -DREFRACTION_TRACE=0 -DREFRACTION_NO_MAIN.
+			Link with approx.c, batch.c, geodesy.c, pool.c, raytrace.c, realtime.c and trace.c.
+USAGE:			refractd [-s socket] [-w window us] [-b batch points] [-p threads]
+------------------------------------------------------
+*/
+
+#define RD_MAX_CLIENTS 256
+#define RD_EVENTS 64
+#define RD_DRAIN 32             // Packets read from one client per wakeup, for fairness
+#define RD_IN_PACKET (sizeof(struct rdHeader) + RD_MAX_POINTS * 6 * sizeof(double))
+#define RD_OUT_PACKET (sizeof(struct rdHeader) + RD_MAX_POINTS * 3 * sizeof(double))
+#define ID_LISTEN RD_MAX_CLIENTS        // epoll ids past the client slots
+#define ID_TIMER (RD_MAX_CLIENTS + 1)
+#define ID_SIGNAL (RD_MAX_CLIENTS + 2)
+
+struct client
+{
+	int fd;                         // -1 for a free slot
+	uint32_t gen;                   // Incremented when the slot is freed
+	unsigned char *shm;             // Attached segment, or NULL
+	size_t shmSize;
+};
+
+/* A coalesced request waiting for its queue to run */
+struct pending
+{
+	int client;
+	uint32_t gen;
+	uint64_t tag;
+	uint64_t stamp;                 // Receipt, for the latency
+	size_t first, count;            // Points in the queue
+};
+
+struct queue
+{
+	int flags;                      // RD_WGS84 or 0
+	size_t n, cap;                  // Points queued, room
+	double *x, *y, *z, *a, *b, *c, *d, *e, *f;
+	struct pending *req;
+	size_t nreq;
+	uint64_t oldest;                // Receipt of req[0]
+};
+
+struct refractDaemon
+{
+	int listenFd, epollFd, timerFd, signalFd;
+	struct client cl[RD_MAX_CLIENTS];
+	struct queue q[2];
+	struct refractPool *pool;
+	uint64_t window, armed;         // Coalescing window; deadline the timer is set for (0 = none)
+	size_t batch;
+	uint64_t start;
+	struct rdStats st;
+	uint64_t hist[HIST_BUCKETS];
+	_Alignas(64) unsigned char in[RD_IN_PACKET];
+	_Alignas(64) unsigned char out[RD_OUT_PACKET];
+};
+
+static int queueInit(struct queue *q, int flags, size_t cap)
+{
+	double **col[9] = { &q->x, &q->y, &q->z, &q->a, &q->b, &q->c, &q->d, &q->e, &q->f };
+	int i;
+
+	memset(q, 0, sizeof(*q));
+	q->flags = flags;
+	q->cap = (cap + 7) & ~(size_t)7;
+	for (i = 0; i < 9; i++)
+	{
+		*col[i] = aligned_alloc(64, q->cap * sizeof(double));
+		if (*col[i] == NULL)
+		{
+			return -1;
+		}
+		memset(*col[i], 0, q->cap * sizeof(double));
+	}
+	/* Every request holds at least one point */
+	q->req = malloc(q->cap * sizeof(*q->req));
+	return q->req == NULL ? -1 : 0;
+}
+
+static void queueFree(struct queue *q)
+{
+	free(q->x);
+	free(q->y);
+	free(q->z);
+	free(q->a);
+	free(q->b);
+	free(q->c);
+	free(q->d);
+	free(q->e);
+	free(q->f);
+	free(q->req);
+}
+
+static void closeClient(struct refractDaemon *dm, int id)
+{
+	struct client *cl = &dm->cl[id];
+
+	close(cl->fd);
+	if (cl->shm != NULL)
+	{
+		munmap(cl->shm, cl->shmSize);
+	}
+	cl->fd = -1;
+	cl->shm = NULL;
+	cl->shmSize = 0;
+	cl->gen++;
+	dm->st.clients--;
+}
+
+/*
+------------------------------------------------------
+sendReply
+
+PURPOSE:		Send one reply packet to a client without blocking
+INPUT ARGUMENTS:	dm, client id, header, body and its length in bytes, receipt
+			stamp of the request
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		0 if sent, -1 if the client was disconnected
+FUNCTIONS CALLED:	closeClient, histBucket, rtNow, sendmsg
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The latency of the request is recorded when the reply is sent
+------------------------------------------------------
+*/
+
+static int sendReply(struct refractDaemon *dm, int id, const struct rdHeader *h, const void *body, size_t len,
+	uint64_t stamp)
+{
+	struct iovec iov[2];
+	struct msghdr msg;
+	uint64_t latency;
+
+	iov[0].iov_base = (void *)h;
+	iov[0].iov_len = sizeof(*h);
+	iov[1].iov_base = (void *)body;
+	iov[1].iov_len = len;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = len > 0 ? 2 : 1;
+
+	if (sendmsg(dm->cl[id].fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{
+			dm->st.dropped++;
+		}
+		closeClient(dm, id);
+		return -1;
+	}
+
+	latency = rtNow() - stamp;
+	dm->hist[histBucket(latency)]++;
+	if (latency > dm->st.max)
+	{
+		dm->st.max = latency;
+	}
+	return 0;
+}
+
+static void replyStatus(struct refractDaemon *dm, int id, const struct rdHeader *req, int status, uint64_t stamp)
+{
+	struct rdHeader h = *req;
+
+	h.magic = RD_MAGIC;
+	h.count = 0;
+	h.status = status;
+	if (status < 0)
+	{
+		dm->st.errors++;
+	}
+	sendReply(dm, id, &h, NULL, 0, stamp);
+}
+
+/*
+------------------------------------------------------
+runQueue
+
+PURPOSE:		Refract every point of a coalescing queue and answer its requests
+INPUT ARGUMENTS:	dm, q
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	refractBatchWgs84, refractPoolBatch, sendReply
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Replies to clients that have gone since their request are skipped
+------------------------------------------------------
+*/
+
+static void runQueue(struct refractDaemon *dm, struct queue *q)
+{
+	const struct pending *p;
+	struct rdHeader *h = (struct rdHeader *)dm->out;
+	double *body = (double *)(dm->out + sizeof(*h));
+	size_t i, k;
+
+	if (q->nreq == 0)
+	{
+		return;
+	}
+	if (q->flags & RD_WGS84)
+	{
+		refractBatchWgs84(q->n, q->x, q->y, q->z, q->a, q->b, q->c, q->d, q->e, q->f);
+	}
+	else
+	{
+		refractPoolBatch(dm->pool, q->n, q->x, q->y, q->z, q->a, q->b, q->c, q->d, q->e, q->f);
+	}
+	dm->st.batches++;
+
+	for (i = 0; i < q->nreq; i++)
+	{
+		p = &q->req[i];
+		dm->st.requests++;
+		dm->st.points += p->count;
+		if (dm->cl[p->client].fd < 0 || dm->cl[p->client].gen != p->gen)
+		{
+			continue;
+		}
+		memset(h, 0, sizeof(*h));
+		h->magic = RD_MAGIC;
+		h->op = RD_OP_REFRACT;
+		h->flags = (uint16_t)q->flags;
+		h->count = (uint32_t)p->count;
+		h->tag = p->tag;
+		for (k = 0; k < p->count; k++)
+		{
+			body[3 * k] = q->d[p->first + k];
+			body[3 * k + 1] = q->e[p->first + k];
+			body[3 * k + 2] = q->f[p->first + k];
+		}
+		sendReply(dm, p->client, h, body, p->count * 3 * sizeof(double), p->stamp);
+	}
+	q->n = 0;
+	q->nreq = 0;
+}
+
+/* Queue the points of an RD_OP_REFRACT request, running the queue when it is full */
+static void enqueue(struct refractDaemon *dm, int id, const struct rdHeader *h, uint64_t stamp)
+{
+	struct queue *q = &dm->q[h->flags & RD_WGS84];
+	const double *pt = (const double *)(dm->in + sizeof(*h));
+	struct pending *p;
+	size_t k;
+
+	if (q->n + h->count > q->cap)
+	{
+		/* May disconnect this very client if its socket is full */
+		runQueue(dm, q);
+		if (dm->cl[id].fd < 0)
+		{
+			return;
+		}
+	}
+	if (q->nreq == 0)
+	{
+		q->oldest = stamp;
+	}
+	p = &q->req[q->nreq++];
+	p->client = id;
+	p->gen = dm->cl[id].gen;
+	p->tag = h->tag;
+	p->stamp = stamp;
+	p->first = q->n;
+	p->count = h->count;
+	for (k = 0; k < h->count; k++)
+	{
+		q->x[q->n] = pt[6 * k];
+		q->y[q->n] = pt[6 * k + 1];
+		q->z[q->n] = pt[6 * k + 2];
+		q->a[q->n] = pt[6 * k + 3];
+		q->b[q->n] = pt[6 * k + 4];
+		q->c[q->n] = pt[6 * k + 5];
+		q->n++;
+	}
+	if (q->n >= dm->batch)
+	{
+		runQueue(dm, q);
+	}
+}
+
+/* Map a client's segment in place of any earlier one; fd is consumed */
+static int attach(struct refractDaemon *dm, int id, const struct rdHeader *h, int fd)
+{
+	struct client *cl = &dm->cl[id];
+	struct stat sb;
+	void *base;
+	int seals;
+
+	if (fd < 0)
+	{
+		return RD_EATTACH;
+	}
+	seals = fcntl(fd, F_GET_SEALS);
+	if (seals < 0 || !(seals & F_SEAL_SHRINK) || fstat(fd, &sb) != 0 || h->offset == 0
+		|| h->offset > (uint64_t)sb.st_size || h->offset > SIZE_MAX)
+	{
+		close(fd);
+		return RD_EATTACH;
+	}
+	base = mmap(NULL, (size_t)h->offset, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		return RD_EATTACH;
+	}
+	if (cl->shm != NULL)
+	{
+		munmap(cl->shm, cl->shmSize);
+	}
+	cl->shm = base;
+	cl->shmSize = (size_t)h->offset;
+	return 0;
+}
+
+/* Refract a block of the client's segment in place */
+static int shmRefract(struct refractDaemon *dm, int id, const struct rdHeader *h)
+{
+	const struct client *cl = &dm->cl[id];
+	size_t n = h->count, stride = h->stride > 0 ? h->stride : h->count;
+	double *col;
+
+	if (cl->shm == NULL || stride < n || h->offset % sizeof(double) != 0 || h->offset > cl->shmSize
+		|| stride > (cl->shmSize - h->offset) / sizeof(double) / 9)
+	{
+		return RD_ENOSHM;
+	}
+	if (n == 0)
+	{
+		return 0;
+	}
+	col = (double *)(cl->shm + h->offset);
+	if (h->flags & RD_WGS84)
+	{
+		refractBatchWgs84(n, col, col + stride, col + 2 * stride, col + 3 * stride, col + 4 * stride,
+			col + 5 * stride, col + 6 * stride, col + 7 * stride, col + 8 * stride);
+	}
+	else
+	{
+		refractPoolBatch(dm->pool, n, col, col + stride, col + 2 * stride, col + 3 * stride, col + 4 * stride,
+			col + 5 * stride, col + 6 * stride, col + 7 * stride, col + 8 * stride);
+	}
+	dm->st.shmRequests++;
+	dm->st.shmPoints += n;
+	return 0;
+}
+
+static void fillStats(struct refractDaemon *dm, struct rdStats *st)
+{
+	*st = dm->st;
+	st->uptime = rtNow() - dm->start;
+	st->p50 = histPercentile(dm->hist, 0.5);
+	st->p90 = histPercentile(dm->hist, 0.9);
+	st->p99 = histPercentile(dm->hist, 0.99);
+	st->p999 = histPercentile(dm->hist, 0.999);
+	st->p50 = st->p50 < st->max ? st->p50 : st->max;
+	st->p90 = st->p90 < st->max ? st->p90 : st->max;
+	st->p99 = st->p99 < st->max ? st->p99 : st->max;
+	st->p999 = st->p999 < st->max ? st->p999 : st->max;
+}
+
+static void printStats(struct refractDaemon *dm)
+{
+	struct rdStats st;
+	double s;
+
+	fillStats(dm, &st);
+	s = st.uptime * 1e-9;
+	fprintf(stderr, "refractd: up %.1f s, %llu clients, %llu requests (%llu points, %.3g points/s) in %llu batches, "
+		"%llu shm requests (%llu points), %llu errors, %llu dropped\n"
+		"refractd: latency p50 %llu p90 %llu p99 %llu p99.9 %llu max %llu ns\n",
+		s, (unsigned long long)st.clients, (unsigned long long)st.requests, (unsigned long long)st.points,
+		s > 0 ? (st.points + st.shmPoints) / s : 0.0, (unsigned long long)st.batches,
+		(unsigned long long)st.shmRequests, (unsigned long long)st.shmPoints, (unsigned long long)st.errors,
+		(unsigned long long)st.dropped, (unsigned long long)st.p50, (unsigned long long)st.p90,
+		(unsigned long long)st.p99, (unsigned long long)st.p999, (unsigned long long)st.max);
+}
+
+/*
+------------------------------------------------------
+handlePacket
+
+PURPOSE:		Dispatch one request packet
+INPUT ARGUMENTS:	dm, client id, packet length (the packet is in dm->in), descriptor
+			passed with it (-1 for none), receipt stamp
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	attach, closeClient, enqueue, fillStats, replyStatus, sendReply, shmRefract
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			A packet too short for a header, or with the wrong magic, ends the connection
+------------------------------------------------------
+*/
+
+static void handlePacket(struct refractDaemon *dm, int id, size_t len, int fd, uint64_t stamp)
+{
+	const struct rdHeader *h = (const struct rdHeader *)dm->in;
+	struct rdHeader r;
+	struct rdStats st;
+
+	if (len < sizeof(*h) || h->magic != RD_MAGIC)
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		dm->st.errors++;
+		closeClient(dm, id);
+		return;
+	}
+	if (fd >= 0 && h->op != RD_OP_ATTACH)
+	{
+		close(fd);
+		fd = -1;
+	}
+
+	switch (h->op)
+	{
+	case RD_OP_REFRACT:
+		if (h->count > RD_MAX_POINTS || len != sizeof(*h) + h->count * 6 * sizeof(double))
+		{
+			replyStatus(dm, id, h, RD_EPROTO, stamp);
+		}
+		else if (h->count == 0)
+		{
+			replyStatus(dm, id, h, 0, stamp);
+		}
+		else
+		{
+			enqueue(dm, id, h, stamp);
+		}
+		break;
+	case RD_OP_ATTACH:
+		replyStatus(dm, id, h, attach(dm, id, h, fd), stamp);
+		break;
+	case RD_OP_SHM_REFRACT:
+		r = *h;
+		r.status = shmRefract(dm, id, h);
+		if (r.status < 0)
+		{
+			dm->st.errors++;
+		}
+		sendReply(dm, id, &r, NULL, 0, stamp);
+		break;
+	case RD_OP_STATS:
+		fillStats(dm, &st);
+		r = *h;
+		r.count = 0;
+		r.status = 0;
+		sendReply(dm, id, &r, &st, sizeof(st), stamp);
+		break;
+	default:
+		replyStatus(dm, id, h, RD_EPROTO, stamp);
+		break;
+	}
+}
+
+/* Read up to RD_DRAIN packets from a client */
+static void readClient(struct refractDaemon *dm, int id)
+{
+	union
+	{
+		struct cmsghdr align;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} ctl;
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	ssize_t len;
+	int i, fd;
+
+	for (i = 0; i < RD_DRAIN && dm->cl[id].fd >= 0; i++)
+	{
+		iov.iov_base = dm->in;
+		iov.iov_len = sizeof(dm->in);
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = ctl.buf;
+		msg.msg_controllen = sizeof(ctl.buf);
+
+		len = recvmsg(dm->cl[id].fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		{
+			return;
+		}
+		fd = -1;
+		for (cm = len > 0 ? CMSG_FIRSTHDR(&msg) : NULL; cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+		{
+			if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS && fd < 0)
+			{
+				memcpy(&fd, CMSG_DATA(cm), sizeof(fd));
+			}
+		}
+		if (len <= 0 || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+		{
+			if (fd >= 0)
+			{
+				close(fd);
+			}
+			if (len > 0)
+			{
+				dm->st.errors++;
+			}
+			closeClient(dm, id);
+			return;
+		}
+		handlePacket(dm, id, (size_t)len, fd, rtNow());
+	}
+}
+
+static void acceptClients(struct refractDaemon *dm)
+{
+	struct epoll_event ev;
+	int fd, id;
+
+	while ((fd = accept4(dm->listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+	{
+		for (id = 0; id < RD_MAX_CLIENTS && dm->cl[id].fd >= 0; id++)
+		{
+		}
+		if (id == RD_MAX_CLIENTS)
+		{
+			close(fd);
+			continue;
+		}
+		ev.events = EPOLLIN;
+		ev.data.u32 = (uint32_t)id;
+		if (epoll_ctl(dm->epollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+		{
+			close(fd);
+			continue;
+		}
+		dm->cl[id].fd = fd;
+		dm->st.clients++;
+	}
+}
+
+/* Run the queues that are full or due, and set the timer for the next deadline */
+static void schedule(struct refractDaemon *dm)
+{
+	struct itimerspec its;
+	uint64_t now = rtNow(), due = 0;
+	int i;
+
+	for (i = 0; i < 2; i++)
+	{
+		if (dm->q[i].nreq == 0)
+		{
+			continue;
+		}
+		if (dm->q[i].n >= dm->batch || now - dm->q[i].oldest >= dm->window)
+		{
+			runQueue(dm, &dm->q[i]);
+		}
+		else if (due == 0 || dm->q[i].oldest + dm->window < due)
+		{
+			due = dm->q[i].oldest + dm->window;
+		}
+	}
+	if (due != 0 && due != dm->armed)
+	{
+		memset(&its, 0, sizeof(its));
+		its.it_value.tv_sec = (time_t)(due / 1000000000u);
+		its.it_value.tv_nsec = (long)(due % 1000000000u);
+		timerfd_settime(dm->timerFd, TFD_TIMER_ABSTIME, &its, NULL);
+		dm->armed = due;
+	}
+}
+
+static int listenOn(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int addFd(int epollFd, int fd, uint32_t id)
+{
+	struct epoll_event ev;
+
+	ev.events = EPOLLIN;
+	ev.data.u32 = id;
+	return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int main(int argc, char **argv)
+{
+	static struct refractDaemon dm;
+	struct epoll_event ev[RD_EVENTS];
+	struct signalfd_siginfo si;
+	const char *path = RD_SOCKET;
+	double window = RD_WINDOW_NS * 1e-3;
+	long batch = RD_BATCH;
+	uint64_t expirations;
+	sigset_t sigs;
+	int threads = 0, running = 1, i, n;
+
+	for (i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "-s") == 0)
+		{
+			path = argv[i + 1];
+		}
+		else if (strcmp(argv[i], "-w") == 0)
+		{
+			window = atof(argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "-b") == 0)
+		{
+			batch = atol(argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "-p") == 0)
+		{
+			threads = atoi(argv[i + 1]);
+		}
+		else
+		{
+			break;
+		}
+	}
+	if (i < argc || window < 0 || batch < 1 || batch > RD_MAX_POINTS * 16)
+	{
+		fprintf(stderr, "usage: refractd [-s socket] [-w window us] [-b batch points (1-%d)] [-p threads]\n",
+			RD_MAX_POINTS * 16);
+		return 1;
+	}
+	dm.window = (uint64_t)(window * 1e3);
+	dm.batch = (size_t)batch;
+	for (i = 0; i < RD_MAX_CLIENTS; i++)
+	{
+		dm.cl[i].fd = -1;
+	}
+
+	if (queueInit(&dm.q[0], 0, dm.batch + RD_MAX_POINTS) != 0
+		|| queueInit(&dm.q[1], RD_WGS84, dm.batch + RD_MAX_POINTS) != 0)
+	{
+		fprintf(stderr, "cannot allocate the coalescing queues\n");
+		return 1;
+	}
+	dm.pool = refractPoolCreate(threads);
+	if (dm.pool == NULL)
+	{
+		fprintf(stderr, "cannot start %d threads\n", threads);
+		return 1;
+	}
+
+	sigemptyset(&sigs);
+	sigaddset(&sigs, SIGINT);
+	sigaddset(&sigs, SIGTERM);
+	sigaddset(&sigs, SIGUSR1);
+	sigprocmask(SIG_BLOCK, &sigs, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	dm.listenFd = listenOn(path);
+	dm.epollFd = epoll_create1(EPOLL_CLOEXEC);
+	dm.timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	dm.signalFd = signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (dm.listenFd < 0 || dm.epollFd < 0 || dm.timerFd < 0 || dm.signalFd < 0
+		|| addFd(dm.epollFd, dm.listenFd, ID_LISTEN) != 0 || addFd(dm.epollFd, dm.timerFd, ID_TIMER) != 0
+		|| addFd(dm.epollFd, dm.signalFd, ID_SIGNAL) != 0)
+	{
+		fprintf(stderr, "cannot listen on %s\n", path);
+		return 1;
+	}
+
+	/* Warm the kernels up before the first client */
+	dm.q[0].x[0] = dm.q[1].x[0] = EARTHRAD + 20200e3;
+	dm.q[0].a[0] = dm.q[1].a[0] = EARTHRAD;
+	refractBatch(1, dm.q[0].x, dm.q[0].y, dm.q[0].z, dm.q[0].a, dm.q[0].b, dm.q[0].c,
+		dm.q[0].d, dm.q[0].e, dm.q[0].f);
+	refractBatchWgs84(1, dm.q[1].x, dm.q[1].y, dm.q[1].z, dm.q[1].a, dm.q[1].b, dm.q[1].c,
+		dm.q[1].d, dm.q[1].e, dm.q[1].f);
+
+	dm.start = rtNow();
+	fprintf(stderr, "refractd: listening on %s, kernel %s, %d threads, window %.1f us, batch %zu\n", path,
+		refractBatchKernel(), refractPoolThreads(dm.pool), dm.window * 1e-3, dm.batch);
+
+	while (running)
+	{
+		n = epoll_wait(dm.epollFd, ev, RD_EVENTS, -1);
+		for (i = 0; i < n; i++)
+		{
+			if (ev[i].data.u32 == ID_LISTEN)
+			{
+				acceptClients(&dm);
+			}
+			else if (ev[i].data.u32 == ID_TIMER)
+			{
+				while (read(dm.timerFd, &expirations, sizeof(expirations)) > 0)
+				{
+				}
+				dm.armed = 0;
+			}
+			else if (ev[i].data.u32 == ID_SIGNAL)
+			{
+				while (read(dm.signalFd, &si, sizeof(si)) == sizeof(si))
+				{
+					printStats(&dm);
+					running = running && si.ssi_signo == SIGUSR1;
+				}
+			}
+			else if (dm.cl[ev[i].data.u32].fd >= 0)
+			{
+				readClient(&dm, (int)ev[i].data.u32);
+			}
+		}
+		schedule(&dm);
+	}
+
+	for (i = 0; i < 2; i++)
+	{
+		runQueue(&dm, &dm.q[i]);
+	}
+	for (i = 0; i < RD_MAX_CLIENTS; i++)
+	{
+		if (dm.cl[i].fd >= 0)
+		{
+			closeClient(&dm, i);
+		}
+	}
+	close(dm.listenFd);
+	unlink(path);
+	refractPoolDestroy(dm.pool);
+	queueFree(&dm.q[0]);
+	queueFree(&dm.q[1]);
+
+	return 0;
+}
@@ -0,0 +1,96 @@
+#ifndef REFRACTD_H
+#define REFRACTD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+Protocol of the refraction daemon (refractd.c) and its client (refractd-client.c)
+
+Messages travel over a SOCK_SEQPACKET Unix domain socket, one request or reply
+per packet, in native byte order. Every packet starts with struct rdHeader.
+
+	RD_OP_REFRACT      request: header, count points of 6 doubles (x,y,z,a,b,c)
+	                   reply:   header, count points of 3 doubles (d,e,f)
+	RD_OP_ATTACH       request: header (offset = segment size in bytes) with a sealed
+	                   memfd passed as SCM_RIGHTS; reply: header
+	RD_OP_SHM_REFRACT  request: header (offset = byte offset of a block in the segment);
+	                   the block holds columns x,y,z,a,b,c,d,e,f of count doubles, stride
+	                   doubles apart; d,e,f are written in place; reply: header
+	RD_OP_STATS        request: header; reply: header, struct rdStats
+
+Replies echo op and tag and carry status 0 or a negative RD_E* code. Small
+RD_OP_REFRACT requests are coalesced with those of other clients and may be
+answered after a later RD_OP_SHM_REFRACT of the same client; a client that
+pipelines requests matches replies on the tag.
+*/
+#define RD_MAGIC 0x44524652u            // "RFRD" read as little-endian bytes
+#define RD_SOCKET "/tmp/refractd.sock"  // Default socket path
+#define RD_MAX_POINTS 2048              // Points in one RD_OP_REFRACT packet
+#define RD_WINDOW_NS 50000              // Default coalescing window, in ns
+#define RD_BATCH 512                    // Default points at which a coalesced batch is run at once
+
+#define RD_OP_REFRACT 1
+#define RD_OP_ATTACH 2
+#define RD_OP_SHM_REFRACT 3
+#define RD_OP_STATS 4
+
+#define RD_WGS84 1                      // Flag: EARTH_WGS84 instead of the sphere
+
+#define RD_EPROTO -1                    // Malformed request
+#define RD_ENOSHM -2                    // No segment attached, or block outside it
+#define RD_EATTACH -3                   // Segment could not be mapped, or is not sealed against shrinking
+#define RD_EIO -4                       // Client side: the socket failed or the daemon hung up
+
+struct rdHeader
+{
+	uint32_t magic;
+	uint16_t op;
+	uint16_t flags;
+	uint32_t count;                 // Points
+	int32_t status;                 // Replies only
+	uint32_t stride;                // RD_OP_SHM_REFRACT: doubles from one column to the next (0 = count)
+	uint32_t reserved;
+	uint64_t tag;                   // Caller's, echoed in the reply
+	uint64_t offset;                // RD_OP_ATTACH: segment size; RD_OP_SHM_REFRACT: block offset, in bytes
+};
+
+struct rdStats
+{
+	uint64_t uptime;                // Since the daemon started, in ns
+	uint64_t clients;               // Connected now
+	uint64_t requests;              // RD_OP_REFRACT requests answered
+	uint64_t points;                // Points in them
+	uint64_t batches;               // Coalesced batches run
+	uint64_t shmRequests;           // RD_OP_SHM_REFRACT requests answered
+	uint64_t shmPoints;             // Points in them
+	uint64_t errors;                // Requests refused with a negative status
+	uint64_t dropped;               // Clients disconnected because their socket was full
+	uint64_t p50, p90, p99, p999, max;      // Latency from receipt to reply, all ops, in ns (upper bucket edges)
+};
+
+/* A shared segment attached to the daemon, see refractClientShmCreate */
+struct rdShm
+{
+	size_t capacity;                // Points
+	size_t size;                    // Bytes mapped
+	double *x, *y, *z, *a, *b, *c, *d, *e, *f;
+};
+
+/*
+Function prototypes
+*/
+int refractClientConnect(const char *path);
+
+int refractClientBatch(int sock, int flags, size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f);
+
+int refractClientShmCreate(int sock, size_t capacity, struct rdShm *shm);
+
+int refractClientShmBatch(int sock, int flags, struct rdShm *shm, size_t n);
+
+void refractClientShmClose(struct rdShm *shm);
+
+int refractClientStats(int sock, struct rdStats *stats);
+
+#endif
@@ -1,9 +1,19 @@
 ﻿#include <math.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include "..\refraction.h"
-
-#define EARTHRAD 6371000
+#include <string.h>
+#include "refraction.h"
+#include "trace.h"
+#include "approx.h"
+#include "raytrace.h"
+#include "ephemeris.h"
+#include "geodesy.h"
+#include "pool.h"
+#include "writer.h"
+#include "realtime.h"
+#include "profile.h"
+#include "montecarlo.h"
 
 /*
 ------------------------------------------------------
@@ -15,8 +25,8 @@ this program computes the apparent point near the Earth surface observed
 from the spacecraft, accounting for atmospheric refraction only.
 
 ASSUMPTIONS:
-1. The Earth is modeled as a sphere.
-2. Local terrain is not taken into account.
+1. The Earth is modeled as a sphere, or as the WGS84 ellipsoid with EARTH_WGS84.
+2. Local terrain is not taken into account, except by refractTerrainBatch (dem.h).
 3. Input coordinates are assumed to be defined with respect to
    an inertial reference frame with origin at the Earth Centre, such as the GCI.
 4. Input coordinates are assumed to be in metres.
@@ -47,7 +57,8 @@ NOTES:
 void satProjection(double x, double y, double z, 
 		double *satProj_x, double *satProj_y, double *satProj_z)
 {
-	static double alt_sat, t;
+	double alt_sat, t;
+	PROFILE_START(ticks);
 
 	/* Compute distance from spacecraft to Earth centre/origin */
 	alt_sat = sqrt(pow(x, 2) + pow(y, 2) + pow(z, 2));
@@ -60,6 +71,7 @@ void satProjection(double x, double y, double z,
 	*satProj_x = t * x;
 	*satProj_y = t * y;
 	*satProj_z = t * z;
+	PROFILE_LAP(PROFILE_SAT_PROJECTION, ticks, t);
 
 	return;
 }
@@ -83,11 +95,12 @@ NOTES:
 double zenithAngle(double x, double y, double z, double a, double b, double c, 
 				   double *distGS2satProj)
 {
-	static double alt_sat, height_sat, satProj_x, satProj_y, satProj_z;
+	double alt_sat, height_sat, satProj_x, satProj_y, satProj_z;
 	double zenAng;
+	PROFILE_START(ticks);
 
 	satProjection(x, y, z, &satProj_x, &satProj_y, &satProj_z);
-	printf("satProj_x in zenithAngle = %.16lf\nsatProj_y in zenithAngle is %.16lf\nsatProj_z in zenithAngle is %.16lf\n",
+	TRACE_FULL_PRINT("satProj_x in zenithAngle = %.16lf\nsatProj_y in zenithAngle is %.16lf\nsatProj_z in zenithAngle is %.16lf\n",
 		satProj_x, satProj_y, satProj_z);
 
 	/* Compute distance between spacecraft projection onto Earth surface and unrefracted ground station */
@@ -102,6 +115,8 @@ double zenithAngle(double x, double y, double z, double a, double b, double c,
 	/* Solve the triangle between the spacecraft, its projection onto the Earth surface, 
 	   and the unrefracted ground station for the zenith angle of the spacecraft */
 	zenAng = atan(*distGS2satProj / height_sat);
+	PROFILE_DOMAIN(PROFILE_ZENITH_ANGLE, !(height_sat > 0.0));
+	PROFILE_LAP(PROFILE_ZENITH_ANGLE, ticks, zenAng);
 
 	return zenAng;
 }
@@ -120,37 +135,26 @@ VER./DATE:		1.0 30 Jan 2019
 PROGRAMMER:		JFG
 NOTES:			Only the refractive index at the ground station is used in subsequent 
 			computations. Therefore, the only model included is for locations in the troposphere.
+			The model constants are in refraction.h; Gamma is folded at compile time.
 ------------------------------------------------------
 */
 
 double refractiveIndex(double q, double r, double s)
 {
-	double Molec_mean, g_0, R_gas, alt_tropop, r_Ltrop, T_tropop, T_sealevel, alt_observer,
-		tempFac, Gamma, densFac, mu;
-
-
-	Molec_mean = 28.825;        // Mean tropospheric molecular weight
-	g_0 = 9.805;                // Mean sea-level acceleration of gravity, in m/s^2
-	R_gas = 8314.3;             // Ideal gas constant, in (J (k mol^-1) K^-1)
-	alt_tropop = 10500;         // Approximate altitude of the tropopause, in metres
-	r_Ltrop = 0.0065;           // Tropospheric temperature rate with altitude (lapse rate), in K/m
-	T_tropop = 68.25;			// Mean temperature at the lowest point of tropopause, in K
-	
-	
-	//T_sealevel = 288.115;		//Noerdlinger value for global mean sealevel temp (K)
-	T_sealevel = 273.15;        // Mean 2018 temperature of Toronto is 282.066 (K)
+	double alt_observer, tempFac, densFac, mu;
+	PROFILE_START(ticks);
 
 	/* Compute distance of location in atmosphere from Earth centre */
-	alt_observer = sqrt(pow(q, 2) + pow(r, 2) + pow(s, 2));
+	alt_observer = sqrt(q * q + r * r + s * s);
 
 	/* Compute lapse rate of troposphere, i.e. change of temp with distance of satellite from geoid */
-	tempFac = 1.0 - r_Ltrop * (alt_observer - EARTHRAD) / T_sealevel;
+	tempFac = 1.0 - R_LTROP * (alt_observer - EARTHRAD) / T_SEALEVEL;
 
-	Gamma = (Molec_mean * g_0) / (R_gas * r_Ltrop) - 1;
+	densFac = pow(tempFac, GAMMA_TROP);
 
-	densFac = pow(tempFac, Gamma);
-
-	mu = 1.0 + (0.0002905 * densFac);
+	mu = 1.0 + (MU_EXCESS * densFac);
+	PROFILE_DOMAIN(PROFILE_REFRACTIVE_INDEX, !(tempFac > 0.0));
+	PROFILE_LAP(PROFILE_REFRACTIVE_INDEX, ticks, mu);
 
 	return mu;
 }
@@ -174,46 +178,449 @@ NOTES:
 double deltaAngle(double x, double y, double z, double a, double b, double c)
 {
 	double mu_0, xi_ang, dAng, z_prime, zenAng, z_0, distGS2satProj, theta, zed;
-
+	PROFILE_START(ticks);
 
 	zenAng = zenithAngle(x, y, z, a, b, c, &distGS2satProj);
-	printf("zenAng in deltaAngle = %.12lf\n", zenAng);
-	printf("distGS2satProj in deltaAngle = %.16lf\n", distGS2satProj);
+	TRACE_FULL_PRINT("zenAng in deltaAngle = %.12lf\n", zenAng);
+	TRACE_FULL_PRINT("distGS2satProj in deltaAngle = %.16lf\n", distGS2satProj);
 
 	theta = distGS2satProj / EARTHRAD;
-	printf("theta in deltaAngle = %.16lf\n", theta);
+	TRACE_FULL_PRINT("theta in deltaAngle = %.16lf\n", theta);
 
 	z_0 = PI - (PI - (zenAng + theta));
-	printf("z_0 in deltaAngle = %.16lf\n", z_0);
+	TRACE_FULL_PRINT("z_0 in deltaAngle = %.16lf\n", z_0);
 
-	zed = asin((sin(z_0) * EARTHRAD) / (EARTHRAD + 15));
-	printf("zed = %.16lf\n", zed);
+	zed = asin((sin(z_0) * EARTHRAD) / (EARTHRAD + GS_HEIGHT));
+	TRACE_FULL_PRINT("zed = %.16lf\n", zed);
 
 	dAng = z_0 - zed;
-	printf("dAng in deltaAngle = %.16lf\n", dAng);
+	TRACE_FULL_PRINT("dAng in deltaAngle = %.16lf\n", dAng);
+	TRACE_RECORD(zenAng, theta, z_0, zed, dAng);
+
+	/* asin of more than 1 gives NaN from a finite z_0 */
+	PROFILE_DOMAIN(PROFILE_DELTA_ANGLE, isnan(zed) && !isnan(z_0));
+	PROFILE_LAP(PROFILE_DELTA_ANGLE, ticks, dAng);
 
 	return dAng;
 }
 
 /*
 ------------------------------------------------------
-void main()
+refractPointModel
+
+PURPOSE:		Compute the refracted ground station coordinates in a single pass
+INPUT ARGUMENTS:	Atmosphere model (NULL for the refracting shell of deltaAngle),
+			spacecraft coordinates (x,y,z) and unrefracted ground station coordinates (a,b,c)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (*d,*e,*f);
+			every intermediate in *res if res is not NULL
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	asin, atan, raytraceDAng, refractApproxDAng, sin, sqrt, wgs84Foot, wgs84Radius
+VER./DATE:		1.4 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Same model as satProjection, zenithAngle and deltaAngle, but the spacecraft
+			radius and the projection-to-station distance are computed once each
+			(2 sqrt instead of 5, no pow) and the projection is not repeated.
+			The displacement is applied along the signed projection-to-station vector.
+			The original main took the int abs() of each component of that vector,
+			truncating it to whole metres; without the truncation the built-in cases
+			move by up to 1.78 m: cases 73-88 by more than 1e-4 m, cases 76-88 by
+			0.2 to 1.78 m (tests/cases.hex has the untruncated values).
+			For ATMOS_RAYTRACE, zed is the zenith angle at the station on the
+			refracted ray, z_0 - dAng. A table serves z_0 up to its z0Max; beyond,
+			the profile is ray traced if there is one.
+			With EARTH_WGS84, the spacecraft is projected along the ellipsoid normal
+			(wgs84Foot), its height is geodetic, and the Gaussian radius under the
+			station (wgs84Radius) takes the place of EARTHRAD; alt_sat in *res is then
+			that radius plus the spacecraft height.
+			With REFRACTION_PROFILE, its steps are timed as the stages of profile.h.
+------------------------------------------------------
+*/
+
+void refractPointModel(const struct refractModel *model, double x, double y, double z, double a, double b, double c,
+		double *d, double *e, double *f, struct refractResult *res)
+{
+	double alt_sat, height_sat, radius, t, satProj_x, satProj_y, satProj_z, dx, dy, dz, distGS2satProj,
+		zenAng, theta, z_0, zed, dAng, linearDisplacement;
+	PROFILE_START(ticks);
+
+	/* Project the spacecraft onto the Earth surface */
+	if (model != NULL && model->earth == EARTH_WGS84)
+	{
+		height_sat = wgs84Foot(x, y, z, &satProj_x, &satProj_y, &satProj_z);
+		radius = wgs84Radius(a, b, c);
+		alt_sat = height_sat + radius;
+		PROFILE_LAP(PROFILE_SAT_PROJECTION, ticks, height_sat);
+	}
+	else
+	{
+		alt_sat = sqrt(x * x + y * y + z * z);
+		t = EARTHRAD / alt_sat;
+		satProj_x = t * x;
+		satProj_y = t * y;
+		satProj_z = t * z;
+		radius = EARTHRAD;
+		height_sat = alt_sat - EARTHRAD;
+		PROFILE_LAP(PROFILE_SAT_PROJECTION, ticks, t);
+	}
+
+	/* Distance between the projection and the unrefracted ground station */
+	dx = satProj_x - a;
+	dy = satProj_y - b;
+	dz = satProj_z - c;
+	distGS2satProj = sqrt(dx * dx + dy * dy + dz * dz);
+
+	/* Zenith angle, central angle and angular displacement as in zenithAngle and deltaAngle */
+	zenAng = atan(distGS2satProj / height_sat);
+	PROFILE_DOMAIN(PROFILE_ZENITH_ANGLE, !(height_sat > 0.0));
+	PROFILE_LAP(PROFILE_ZENITH_ANGLE, ticks, zenAng);
+	theta = distGS2satProj / radius;
+	z_0 = zenAng + theta;
+	if (model == NULL)
+	{
+		zed = asin((sin(z_0) * EARTHRAD) / (EARTHRAD + GS_HEIGHT));
+		dAng = z_0 - zed;
+	}
+	else if (model->atmos == ATMOS_RAYTRACE)
+	{
+		dAng = model->table != NULL && (z_0 <= model->table->z0Max || model->profile == NULL)
+			? refractApproxDAng(model->table, z_0) : raytraceDAng(model->profile, model->stationHeight, z_0, NULL);
+		zed = z_0 - dAng;
+	}
+	else
+	{
+		zed = asin((sin(z_0) * radius) / (radius + model->stationHeight));
+		dAng = z_0 - zed;
+	}
+	TRACE_RECORD(zenAng, theta, z_0, zed, dAng);
+	PROFILE_DOMAIN(PROFILE_DELTA_ANGLE, isnan(dAng) && !isnan(z_0));
+	PROFILE_LAP(PROFILE_DELTA_ANGLE, ticks, dAng);
+
+	/* Translate the ground station towards the projection by the arc length of dAng */
+	linearDisplacement = radius * dAng;
+	if (linearDisplacement == 0.0)
+	{
+		*d = a;
+		*e = b;
+		*f = c;
+	}
+	else
+	{
+		*d = a + (linearDisplacement / distGS2satProj) * dx;
+		*e = b + (linearDisplacement / distGS2satProj) * dy;
+		*f = c + (linearDisplacement / distGS2satProj) * dz;
+	}
+	PROFILE_LAP(PROFILE_DISPLACEMENT, ticks, *d);
+
+	if (res != NULL)
+	{
+		res->satProj_x = satProj_x;
+		res->satProj_y = satProj_y;
+		res->satProj_z = satProj_z;
+		res->alt_sat = alt_sat;
+		res->distGS2satProj = distGS2satProj;
+		res->zenAng = zenAng;
+		res->theta = theta;
+		res->z_0 = z_0;
+		res->zed = zed;
+		res->dAng = dAng;
+		res->linearDisplacement = linearDisplacement;
+	}
+
+	return;
+}
+
+/*
+------------------------------------------------------
+refractPoint
+
+PURPOSE:		Compute the refracted ground station coordinates in a single pass
+INPUT ARGUMENTS:	Spacecraft coordinates (x,y,z) and unrefracted ground station coordinates (a,b,c)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (*d,*e,*f);
+			every intermediate in *res if res is not NULL
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	refractPointModel
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The refracting shell model of deltaAngle
+------------------------------------------------------
+*/
+
+void refractPoint(double x, double y, double z, double a, double b, double c,
+		double *d, double *e, double *f, struct refractResult *res)
+{
+	refractPointModel(NULL, x, y, z, a, b, c, d, e, f, res);
+}
+
+/*
+------------------------------------------------------
+int main()
 PURPOSE:			Compute refracted ground station coordinates
-FUNCTIONS CALLED:	deltaAngle, pow, satProjection, sqrt
-VER./DATE:			1.0 30 Jan 2019
+USAGE:				refraction			run the built-in test cases
+					refraction in.eph out.eph	refract every point of an ephemeris file (ephemeris.h)
+					refraction -w cases.eph		write the built-in test cases as an ephemeris file
+					refraction -o fmt [in.eph] out	write the results as bin, hex or csv (writer.h)
+										through the writer thread; "-" is standard output,
+										for hex and csv only
+					refraction -r in.eph [hz [cpu,cpu]]	replay an ephemeris file through the real-time
+										pipeline (realtime.h) at hz states per second
+										(0 = as fast as accepted), producer and consumer
+										pinned to the given CPUs, and print the latencies
+					refraction -f [zmax_deg]	compare refractBatchFloat with refractBatch over
+										zenith angles up to zmax_deg (default 85) at several
+										spacecraft heights and print the position errors
+					refraction -m mc.cfg [out.json]	Monte Carlo sensitivity study (montecarlo.h) on all
+										cores; the moments are written as JSON
+FUNCTIONS CALLED:	ephemStream, ephemStreamWriter, ephemWriterAppend, floatCheck, mcConfigLoad, mcReport,
+					realtimeReplay, refractMonteCarlo, refractPoint, refractPoolCreate,
+					refractWriterPut, sqrt
+VER./DATE:			1.7 16 Oct 2026
 PROGRAMMER:			JFG
-NOTES:				Testing version
+NOTES:				Testing version. Define REFRACTION_NO_MAIN to link the functions
+					above into another program. With REFRACTION_PROFILE the stage
+					timings (profile.h) are written to refraction-profile.json on exit.
+					Exits once the cases are done, without waiting on standard input.
 
 ------------------------------------------------------
 */
 
 
-void main(void)
+#ifndef REFRACTION_NO_MAIN
+/* Push every point of an ephemeris file through the real-time pipeline, paced at hz, and report the latencies */
+static int realtimeReplay(const char *path, double hz, int producerCpu, int consumerCpu)
 {
-	double linearDisplacement, dAng, d[88], e[88], f[88],
-		height_sat, projSatGSDiff_x, projSatGSDiff_y, projSatGSDiff_z,
-		distProjSat2GS;
-	static double alt_sat, mu_0, satProj_x, satProj_y, satProj_z;
+	struct ephemFile in;
+	struct refractRealtime *rt;
+	struct rtState s;
+	struct rtPointing p;
+	struct rtStats stats;
+	uint64_t start, sent = 0, pushed = 0, received = 0;
+	size_t block, i, n;
+	double *cols[EPHEM_IN_COLS];
+	int col;
+
+	if (ephemOpen(&in, path) != 0 || in.nCols != EPHEM_IN_COLS)
+	{
+		return -1;
+	}
+	rt = refractRealtimeStart(NULL, 1024, RT_DEADLINE_NS, consumerCpu);
+	if (rt == NULL || rtPinThread(producerCpu) != 0)
+	{
+		if (rt != NULL)
+		{
+			refractRealtimeStop(rt, NULL);
+		}
+		ephemClose(&in);
+		return -1;
+	}
+
+	start = rtNow();
+	for (block = 0; block < in.nBlocks; block++)
+	{
+		n = ephemBlockLength(&in, block);
+		for (col = 0; col < EPHEM_IN_COLS; col++)
+		{
+			cols[col] = ephemColumn(&in, block, col);
+		}
+		for (i = 0; i < n; i++)
+		{
+			s.seq = sent++;
+			s.x = cols[0][i];
+			s.y = cols[1][i];
+			s.z = cols[2][i];
+			s.a = cols[3][i];
+			s.b = cols[4][i];
+			s.c = cols[5][i];
+			if (hz > 0.0)
+			{
+				/* Release each state on its own schedule; a full ring drops it. Yield while
+				waiting in case the consumer shares this CPU. */
+				s.stamp = start + (uint64_t)((double)s.seq * 1e9 / hz);
+				while (rtNow() < s.stamp)
+				{
+					received += refractRealtimePoll(rt, &p);
+					sched_yield();
+				}
+				pushed += refractRealtimePush(rt, &s) == 0;
+			}
+			else
+			{
+				s.stamp = 0;
+				while (refractRealtimePush(rt, &s) != 0)
+				{
+					received += refractRealtimePoll(rt, &p);
+					sched_yield();
+				}
+				pushed++;
+			}
+			received += refractRealtimePoll(rt, &p);
+		}
+	}
+	ephemClose(&in);
+
+	/* Wait for the states in flight */
+	start = rtNow();
+	while (received < pushed && rtNow() - start < 100 * (uint64_t)RT_DEADLINE_NS)
+	{
+		received += refractRealtimePoll(rt, &p);
+	}
+	refractRealtimeStop(rt, &stats);
+
+	printf("%llu states, %llu pointings, %llu late (> %.3f ms), %llu pushes refused, %llu pointings dropped\n",
+		(unsigned long long)sent, (unsigned long long)received, (unsigned long long)stats.missed,
+		RT_DEADLINE_NS / 1e6, (unsigned long long)stats.droppedIn, (unsigned long long)stats.droppedOut);
+	printf("latency ns: p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+		(unsigned long long)stats.p50, (unsigned long long)stats.p90, (unsigned long long)stats.p99,
+		(unsigned long long)stats.p999, (unsigned long long)stats.max);
+	return 0;
+}
+
+/* Print the accuracy of refractBatchFloat at a range of spacecraft heights, zenith angles up to zMaxDeg */
+static int floatCheck(double zMaxDeg)
+{
+	static const double heights[] = { 400e3, 1000e3, 5000e3, 20200e3, 35786e3 };
+	struct refractFloatCheck chk;
+	size_t i;
+
+	printf("kernel %s, zenith angles 0 to %g deg\n", refractBatchKernel(), zMaxDeg);
+	printf("%12s %14s %14s %10s %12s %12s\n", "height_km", "max_err_m", "mean_err_m", "at_deg",
+		"double_ns", "float_ns");
+	for (i = 0; i < sizeof(heights) / sizeof(heights[0]); i++)
+	{
+		if (refractBatchFloatCheck(heights[i], zMaxDeg * PI / 180.0, 1 << 18, &chk) != 0)
+		{
+			return -1;
+		}
+		printf("%12.0f %14.3e %14.3e %10.4f %12.2f %12.2f\n", heights[i] / 1000.0, chk.maxError, chk.meanError,
+			chk.zAtMax * 180.0 / PI, chk.nsDouble, chk.nsFloat);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	double d[88], e[88], f[88];
+	struct refractResult res;
+	struct refractPool *pool;
+	struct ephemWriter w;
+	struct refractWriter *out;
+	uint64_t count;
+	int status, format = -1;
+
+#ifdef REFRACTION_PROFILE
+	profileReportAtExit("refraction-profile.json");
+#endif
+	if (argc >= 4 && strcmp(argv[1], "-o") == 0)
+	{
+		format = refractWriterFormat(argv[2]);
+		if (format < 0)
+		{
+			fprintf(stderr, "unknown output format %s\n", argv[2]);
+			return 1;
+		}
+		if (format == WRITER_BINARY && strcmp(argv[argc - 1], "-") == 0)
+		{
+			fprintf(stderr, "bin output needs a file, \"-\" is for hex and csv only\n");
+			return 1;
+		}
+	}
+
+	/* Real-time replay */
+	if (argc >= 3 && argc <= 5 && strcmp(argv[1], "-r") == 0)
+	{
+		int producerCpu = -1, consumerCpu = -1;
+
+		if (argc == 5 && sscanf(argv[4], "%d,%d", &producerCpu, &consumerCpu) != 2)
+		{
+			fprintf(stderr, "expected producer,consumer CPUs, got %s\n", argv[4]);
+			return 1;
+		}
+		if (realtimeReplay(argv[2], argc >= 4 ? atof(argv[3]) : 0.0, producerCpu, consumerCpu) != 0)
+		{
+			fprintf(stderr, "cannot replay %s\n", argv[2]);
+			return 1;
+		}
+		return 0;
+	}
+
+	/* Monte Carlo sensitivity study */
+	if ((argc == 3 || argc == 4) && strcmp(argv[1], "-m") == 0)
+	{
+		struct mcConfig cfg;
+		struct mcResult mc;
+		FILE *fp = stdout;
+
+		if (mcConfigLoad(&cfg, argv[2]) != 0)
+		{
+			fprintf(stderr, "cannot read %s\n", argv[2]);
+			return 1;
+		}
+		pool = refractPoolCreate(0);
+		status = pool == NULL ? -1 : refractMonteCarlo(pool, &cfg, &mc);
+		refractPoolDestroy(pool);
+		if (status != 0 || (argc == 4 && (fp = fopen(argv[3], "w")) == NULL))
+		{
+			fprintf(stderr, "cannot run %s\n", argv[2]);
+			return 1;
+		}
+		mcReport(fp, &mc);
+		if (fp != stdout)
+		{
+			fclose(fp);
+		}
+		return 0;
+	}
+
+	/* Mixed precision accuracy */
+	if (argc <= 3 && argc >= 2 && strcmp(argv[1], "-f") == 0)
+	{
+		return floatCheck(argc == 3 ? atof(argv[2]) : 85.0) == 0 ? 0 : 1;
+	}
+
+	/* Stream an ephemeris file through all cores into the writer thread */
+	if (argc == 5 && format >= 0)
+	{
+		out = refractWriterOpen(argv[4], format);
+		if (out == NULL)
+		{
+			fprintf(stderr, "cannot create %s\n", argv[4]);
+			return 1;
+		}
+		pool = refractPoolCreate(0);
+		status = ephemStreamWriter(pool, argv[3], out, &count);
+		refractPoolDestroy(pool);
+		if (refractWriterClose(out) != 0 || status != 0)
+		{
+			fprintf(stderr, "cannot refract %s into %s\n", argv[3], argv[4]);
+			return 1;
+		}
+		return 0;
+	}
+
+	/* Built-in test cases into the writer thread; opened first so that a bad path fails before any output */
+	if (format >= 0)
+	{
+		out = refractWriterOpen(argv[3], format);
+		if (out == NULL)
+		{
+			fprintf(stderr, "cannot create %s\n", argv[3]);
+			return 1;
+		}
+	}
+
+	/* Stream an ephemeris file through all cores */
+	if (argc == 3 && strcmp(argv[1], "-w") != 0)
+	{
+		pool = refractPoolCreate(0);
+		status = ephemStream(pool, argv[1], argv[2], &count);
+		refractPoolDestroy(pool);
+		if (status != 0)
+		{
+			fprintf(stderr, "cannot refract %s into %s\n", argv[1], argv[2]);
+			return 1;
+		}
+		TRACE_SUMMARY_PRINT("%llu points written to %s\n", (unsigned long long)count, argv[2]);
+		return 0;
+	}
 
 	/*
 	Define input coordinates (a,b,c) for the unrefracted position of the ground station
@@ -309,73 +716,49 @@ void main(void)
 		-6190423.092136, -6027490.996022, -5799703.479819, -5467452.133217, -4955534.571032,
 		-4106534.421306, -2543597.475182, 833123.509645 };
 
-	for (int j = 0; j < 88; j++)
+	if (argc == 3)
 	{
-		/* Compute the coordinates of the point on the Earth's surface representing
-		the projection of the satellite along the line connecting it to the origin/Earth centre */
-
-		printf("a[%d] = %lf\nb[%d] = %lf\nc[%d] = %lf\nx[%d] = %lf\ny[%d] = %lf\nz[%d] = %lf\n",
-			j, a[j], j, b[j], j, c[j], j, x[j], j, y[j], j, z[j]);
+		const double *cols[EPHEM_IN_COLS] = { x, y, z, a, b, c };
 
-		satProjection(x[j], y[j], z[j], &satProj_x, &satProj_y, &satProj_z);
-
-		/* Compute the vector difference of the the point on the Earth's surface representing
-		the projection of the satellite along the line connecting it to the origin/Earth centre
-		and the vector <a, b, c> corresponding to the point representing the ground station location */
+		if (ephemWriterOpen(&w, argv[2], EPHEM_IN_COLS) != 0 || ephemWriterAppend(&w, 88, cols) != 0
+			|| ephemWriterClose(&w) != 0)
+		{
+			fprintf(stderr, "cannot write %s\n", argv[2]);
+			return 1;
+		}
+		return 0;
+	}
 
-		projSatGSDiff_x = abs(a[j] - satProj_x);
-		projSatGSDiff_y = abs(b[j] - satProj_y);
-		projSatGSDiff_z = abs(c[j] - satProj_z);
+	for (int j = 0; j < 88; j++)
+	{
+		TRACE_SUMMARY_PRINT("a[%d] = %lf\nb[%d] = %lf\nc[%d] = %lf\nx[%d] = %lf\ny[%d] = %lf\nz[%d] = %lf\n",
+			j, a[j], j, b[j], j, c[j], j, x[j], j, y[j], j, z[j]);
 
 		/* Compute the refracted ground station coordinates by translating the unrefracted ground station coordinates
-		along the line through the unrefracted ground station parallel to the above difference vector */
-
-		distProjSat2GS = sqrt(pow((satProj_x - a[j]), 2) + pow((satProj_y - b[j]), 2) + pow((satProj_z - c[j]), 2));
-		
-		/* Compute the displacement from the unrefracted ground station coordinates to its refracted coordinates
-		by calculating the arc length subtended by the angular difference between the points.
-		At reasonable zenith angles we can assume this displacement is linear. */
-
-		dAng = deltaAngle(x[j], y[j], z[j], a[j], b[j], c[j]);
-		linearDisplacement = 6371000 * dAng;
-		printf("linearDisplacement in main for test case %d = %.16lf\n", j, linearDisplacement);
-
-		if (linearDisplacement == 0.0)
-		{
-			d[j] = a[j];
-			e[j] = b[j];
-			f[j] = c[j];
-		}
-		else
+		towards the projection of the satellite onto the Earth surface, by the arc length subtended by the
+		angular displacement. At reasonable zenith angles we can assume this displacement is linear. */
+		refractPoint(x[j], y[j], z[j], a[j], b[j], c[j], &d[j], &e[j], &f[j], &res);
+
+		TRACE_FULL_PRINT("satProj_x = %.16lf\nsatProj_y = %.16lf\nsatProj_z = %.16lf\n",
+			res.satProj_x, res.satProj_y, res.satProj_z);
+		TRACE_FULL_PRINT("zenAng = %.12lf\ndistGS2satProj = %.16lf\ntheta = %.16lf\nz_0 = %.16lf\nzed = %.16lf\ndAng = %.16lf\n",
+			res.zenAng, res.distGS2satProj, res.theta, res.z_0, res.zed, res.dAng);
+		TRACE_FULL_PRINT("linearDisplacement in main for test case %d = %.16lf\n", j, res.linearDisplacement);
+		TRACE_SUMMARY_PRINT("Output coords for test case %d are\n%.16lf\n%.16lf\n%.16lf\n", j, d[j], e[j], f[j]);
+		TRACE_SUMMARY_PRINT("Distance from refracted to unrefracted GS = %.16lf\n\n\n", sqrt(pow((d[j] - a[j]), 2) + pow((e[j] - b[j]), 2) + pow((f[j] - c[j]), 2)));
+	}
+#ifdef REFRACTION_TRACE_RING
+	traceRingDump("refraction-trace.bin");
+#endif
+	if (format >= 0)
+	{
+		if (refractWriterPut(out, 88, d, e, f) != 0 || refractWriterClose(out) != 0)
 		{
-			if (satProj_x > a[j])
-			{
-				d[j] = a[j] + ((linearDisplacement / distProjSat2GS) * projSatGSDiff_x);
-			}
-			else
-			{
-				d[j] = a[j] - ((linearDisplacement / distProjSat2GS) * projSatGSDiff_x);
-			}
-			if (satProj_y > b[j])
-			{
-				e[j] = b[j] + ((linearDisplacement / distProjSat2GS) * projSatGSDiff_y);
-			}
-			else
-			{
-				e[j] = b[j] - ((linearDisplacement / distProjSat2GS) * projSatGSDiff_y);
-			}
-			if (satProj_z > c[j])
-			{
-				f[j] = c[j] + ((linearDisplacement / distProjSat2GS) * projSatGSDiff_z);
-			}
-			else
-			{
-				f[j] = c[j] - ((linearDisplacement / distProjSat2GS) * projSatGSDiff_z);
-			}
+			fprintf(stderr, "cannot write %s\n", argv[3]);
+			return 1;
 		}
-		printf("Output coords for test case %d are\n%.16lf\n%.16lf\n%.16lf\n", j, d[j], e[j], f[j]);
-		printf("Distance from refracted to unrefracted GS = %.16\lf\n\n\n", sqrt(pow((d[j] - a[j]), 2) + pow((e[j] - b[j]), 2) + pow((f[j] - c[j]), 2)));
+		return 0;
 	}
-	getchar();
-	return; 
+	return 0;
 }
+#endif
@@ -1,3 +1,12 @@
+#ifndef REFRACTION_H
+#define REFRACTION_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /*
 Constants
 */
@@ -5,6 +14,74 @@ Constants
 #define PI 3.14159265359
 #endif 
 
+#ifndef EARTHRAD
+#define EARTHRAD 6371000
+#endif
+
+#ifndef GS_HEIGHT
+#define GS_HEIGHT 15            // Height of the ground station above the Earth surface, in metres
+#endif
+
+/* Tropospheric model of refractiveIndex, Noerdlinger (1999) p. 371 */
+#define MOLEC_MEAN 28.825       // Mean tropospheric molecular weight
+#define G_0 9.805               // Mean sea-level acceleration of gravity, in m/s^2
+#define R_GAS 8314.3            // Ideal gas constant, in (J (k mol^-1) K^-1)
+#define ALT_TROPOP 10500        // Approximate altitude of the tropopause, in metres
+#define R_LTROP 0.0065          // Tropospheric temperature rate with altitude (lapse rate), in K/m
+#define T_TROPOP 68.25          // Mean temperature at the lowest point of tropopause, in K
+#define T_SEALEVEL 273.15       // Mean 2018 temperature of Toronto is 282.066 (K); Noerdlinger uses 288.115
+#define MU_EXCESS 0.0002905     // Refractivity (mu - 1) at sea-level density
+#define GAMMA_TROP ((MOLEC_MEAN * G_0) / (R_GAS * R_LTROP) - 1)
+
+/* Atmosphere models for the angular displacement */
+#define ATMOS_SHELL 0           // Refracting shell at the station height, as in deltaAngle
+#define ATMOS_RAYTRACE 1        // Ray tracing through a layered atmosphere profile (raytrace.c)
+
+/* Earth models for the projection and the local radius */
+#define EARTH_SPHERE 0          // Sphere of radius EARTHRAD
+#define EARTH_WGS84 1           // WGS84 ellipsoid (geodesy.c)
+
+/*
+Types
+*/
+
+/* Intermediates of one refractPoint evaluation */
+struct refractResult
+{
+	double satProj_x, satProj_y, satProj_z;     // Projection of the spacecraft onto the Earth surface
+	double alt_sat;                             // Distance of the spacecraft from Earth centre
+	double distGS2satProj;                      // Distance from the projection to the unrefracted ground station
+	double zenAng;                              // Zenith angle of the spacecraft
+	double theta;                               // Central angle between projection and ground station
+	double z_0, zed;                            // Zenith angles at the ground station and at the refracting shell
+	double dAng;                                // Angular displacement
+	double linearDisplacement;                  // Displacement of the ground station, in metres
+};
+
+struct atmosProfile;
+struct refractApprox;
+
+/* Model selection for refractPointModel; a NULL model means ATMOS_SHELL at GS_HEIGHT on EARTH_SPHERE */
+struct refractModel
+{
+	int atmos;                                  // ATMOS_SHELL or ATMOS_RAYTRACE
+	double stationHeight;                       // Height of the ground station above the Earth surface, in metres
+	const struct atmosProfile *profile;         // Layered atmosphere for ATMOS_RAYTRACE
+	const struct refractApprox *table;          // Optional tabulated ray tracing (raytraceBuildTable) for ATMOS_RAYTRACE,
+	                                            // used up to its z0Max if profile is set
+	int earth;                                  // EARTH_SPHERE or EARTH_WGS84
+};
+
+/* Accuracy and speed of refractBatchFloat against refractBatch, see refractBatchFloatCheck */
+struct refractFloatCheck
+{
+	size_t samples;
+	double maxError;                            // Largest distance between the two refracted stations, in metres
+	double meanError;                           // Mean distance, in metres
+	double zAtMax;                              // Zenith angle of the spacecraft at the worst sample, in radians
+	double nsDouble, nsFloat;                   // Time per point of refractBatch and refractBatchFloat
+};
+
 /*
 Globals
 */
@@ -22,6 +99,30 @@ double zenithAngle(double x, double y, double z, double a, double b, double c, d
 
 double refractiveIndex(double q, double r, double s);
 
-void main();
+void refractPoint(double x, double y, double z, double a, double b, double c,
+	double *d, double *e, double *f, struct refractResult *res);
+
+void refractPointModel(const struct refractModel *model, double x, double y, double z, double a, double b, double c,
+	double *d, double *e, double *f, struct refractResult *res);
+
+void refractBatch(size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f);
+
+void refractBatchStations(double x, double y, double z, size_t n,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f);
+
+void refractBatchWgs84(size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f);
+
+void refractBatchFloat(size_t n, const double *x, const double *y, const double *z,
+	const double *a, const double *b, const double *c, double *d, double *e, double *f);
+
+int refractBatchFloatCheck(double height, double zMax, size_t samples, struct refractFloatCheck *chk);
+
+const char *refractBatchKernel(void);
 
+#ifdef __cplusplus
+}
+#endif
 
+#endif
@@ -0,0 +1,419 @@
+#ifndef REFRACTION_HPP
+#define REFRACTION_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#if __has_include(<experimental/simd>) && __cplusplus >= 201703L
+#include <experimental/simd>
+#define REFRACTION_HPP_SIMD 1
+#endif
+#include "refraction.h"
+#include "geodesy.h"
+
+/*
+------------------------------------------------------
+refraction.hpp
+
+Header-only C++17 templates of the refraction model, for callers that want the
+compiler to specialize and inline the whole chain for one configuration.
+
+The Earth model, the atmosphere model and the scalar type are template
+parameters:
+
+	Earth	Sphere<R> (radius R metres, default EARTHRAD) or Wgs84 (the ellipsoid
+		of geodesy.h). An Earth policy gives project(x, y, z, px, py, pz), the
+		surface projection and the height above the surface, height(x, y, z)
+		alone, and localRadius(a, b, c), the radius of the surface under a
+		station for arc lengths.
+	Atmos	Shell<H> (refracting shell at the station height H metres, default
+		GS_HEIGHT, with the tropospheric constants of refraction.h) or Vacuum.
+		An atmosphere policy gives zed(z_0, radius) and the constexpr constants
+		of refractiveIndex.
+	T	float, double, or std::experimental::simd of either. Math is called
+		unqualified, so the simd overloads are found by argument lookup, and
+		branches go through select.
+
+Every constant is constexpr and folded at compile time. With Sphere<>, Shell<>
+and double, refractPoint, zenithAngle and refractiveIndex give the same bits as
+the C functions when neither side contracts to FMA (-ffp-contract=off). The C
+functions of refraction.c remain the implementation behind the C API (with the
+profile.h and trace.h hooks), and C++ code can call them too.
+
+BUILD:			header only; the C sources are not needed for the templates.
+			g++ -std=c++17 -O2 -march=native (for simd)
+------------------------------------------------------
+*/
+
+namespace refraction
+{
+
+namespace detail
+{
+/* Element type of T, so that constants are converted to float before a simd<float> is made */
+template <class T>
+struct element
+{
+	using type = T;
+};
+
+template <class T>
+inline T constant(double v)
+{
+	return T(static_cast<typename element<T>::type>(v));
+}
+
+template <class T>
+inline T select(bool m, T a, T b)
+{
+	return m ? a : b;
+}
+
+#ifdef REFRACTION_HPP_SIMD
+template <class U, class A>
+struct element<std::experimental::simd<U, A>>
+{
+	using type = U;
+};
+
+template <class U, class A>
+inline std::experimental::simd<U, A> select(const std::experimental::simd_mask<U, A> &m,
+	std::experimental::simd<U, A> a, std::experimental::simd<U, A> b)
+{
+	where(m, b) = a;
+	return b;
+}
+#endif
+}
+
+/* Earth models */
+template <long RadiusMetres = EARTHRAD>
+struct Sphere
+{
+	static constexpr double radius = RadiusMetres;
+
+	template <class T>
+	static T project(T x, T y, T z, T &px, T &py, T &pz)
+	{
+		using std::sqrt;
+		T alt = sqrt(x * x + y * y + z * z);
+		T t = detail::constant<T>(radius) / alt;
+
+		px = t * x;
+		py = t * y;
+		pz = t * z;
+		return alt - detail::constant<T>(radius);
+	}
+
+	template <class T>
+	static T height(T x, T y, T z)
+	{
+		using std::sqrt;
+		return sqrt(x * x + y * y + z * z) - detail::constant<T>(radius);
+	}
+
+	template <class T>
+	static T localRadius(T, T, T)
+	{
+		return detail::constant<T>(radius);
+	}
+};
+
+/* WGS84 ellipsoid, as wgs84Foot and wgs84Radius of geodesy.c */
+struct Wgs84
+{
+	static constexpr double semiMajor = WGS84_A, semiMinor = WGS84_A * (1.0 - WGS84_F), e2 = WGS84_E2;
+
+	/* Vermeille's k for a point at distance sqrt(rho2) from the polar axis, with 1 / k and 1 / (k + e^2) */
+	template <class T>
+	static T vermeilleK(T rho2, T z, T &ik, T &ike)
+	{
+		using std::sqrt;
+		using detail::constant;
+		T p, q, r, s, ss, u, v2, v, h, w, uv, root, g;
+
+		p = rho2 * constant<T>(1.0 / (semiMajor * semiMajor));
+		q = z * z * constant<T>((1.0 - e2) / (semiMajor * semiMajor));
+		r = (p + q - constant<T>(e2 * e2)) * constant<T>(1.0 / 6.0);
+		s = constant<T>(e2 * e2) * p * q / ((constant<T>(4.0) * r) * (r * r));
+		ss = s * s;
+		u = r * ((constant<T>(3.0) + s * constant<T>(2.0 / 9)) + ss * ((constant<T>(-8.0 / 243)
+			+ s * constant<T>(56.0 / 6561)) + ss * (constant<T>(-160.0 / 59049) + s * constant<T>(4576.0 / 4782969))));
+		v2 = u * u + constant<T>(e2 * e2) * q;
+		h = constant<T>(e2) * (u - q) * (constant<T>(0.5) / v2);
+		v = sqrt(v2);
+		w = h * v + constant<T>(0.5 * e2);
+		uv = u + v;
+		g = constant<T>(1.0) / (uv * (uv + (constant<T>(2.0 * e2) * w - constant<T>(e2 * e2))));
+		root = sqrt(uv + w * w);
+		ik = (root + w) * (uv + (constant<T>(2.0 * e2) * w - constant<T>(e2 * e2))) * g;
+		ike = (root + (w - constant<T>(e2))) * uv * g;
+		return root - w;
+	}
+
+	template <class T>
+	static T project(T x, T y, T z, T &px, T &py, T &pz)
+	{
+		using std::sqrt;
+		using detail::constant;
+		T rho2 = x * x + y * y, ik, ike, k = vermeilleK(rho2, z, ik, ike), ke2 = k + constant<T>(e2);
+
+		px = x * ike;
+		py = y * ike;
+		pz = z * constant<T>(1.0 - e2) * ik;
+		return (k + constant<T>(e2 - 1.0)) * ik * ike * sqrt(k * k * rho2 + ke2 * ke2 * z * z);
+	}
+
+	template <class T>
+	static T height(T x, T y, T z)
+	{
+		T px, py, pz;
+		return project(x, y, z, px, py, pz);
+	}
+
+	template <class T>
+	static T localRadius(T a, T b, T c)
+	{
+		using detail::constant;
+		T nxy2 = (a * a + b * b) * constant<T>((1.0 - e2) * (1.0 - e2));
+
+		return constant<T>(semiMinor) * (nxy2 + c * c) / (nxy2 + constant<T>(1.0 - e2) * c * c);
+	}
+};
+
+/* Atmosphere models */
+template <long HeightMetres = GS_HEIGHT>
+struct Shell
+{
+	static constexpr double stationHeight = HeightMetres;
+	static constexpr double molecMean = MOLEC_MEAN, g0 = G_0, rGas = R_GAS;
+	static constexpr double lapseRate = R_LTROP, tSealevel = T_SEALEVEL, muExcess = MU_EXCESS;
+	static constexpr double gamma = (molecMean * g0) / (rGas * lapseRate) - 1;
+
+	/* Zenith angle on the refracting shell for zenith angle z_0 at the station, on a surface of the given radius */
+	template <class T>
+	static T zed(T z_0, T radius)
+	{
+		using std::asin;
+		using std::sin;
+		return asin((sin(z_0) * radius) / (radius + detail::constant<T>(stationHeight)));
+	}
+};
+
+/* No atmosphere: no displacement, refractive index 1 */
+struct Vacuum
+{
+	static constexpr double stationHeight = 0.0;
+	static constexpr double lapseRate = 0.0, tSealevel = 1.0, muExcess = 0.0, gamma = 0.0;
+
+	template <class T>
+	static T zed(T z_0, T)
+	{
+		return z_0;
+	}
+};
+
+/*
+------------------------------------------------------
+satProjection
+
+PURPOSE:		Project a point in space onto the Earth surface along the line to Earth centre
+INPUT ARGUMENTS:	Coordinates of the spacecraft
+OUTPUT ARGUMENTS:	Coordinates of its projection
+RETURNED VALUE:		Height of the spacecraft above the surface
+FUNCTIONS CALLED:	Earth::project
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			As satProjection of refraction.c, or wgs84Foot with Wgs84
+------------------------------------------------------
+*/
+
+template <class Earth = Sphere<>, class T>
+inline T satProjection(T x, T y, T z, T &satProj_x, T &satProj_y, T &satProj_z)
+{
+	return Earth::project(x, y, z, satProj_x, satProj_y, satProj_z);
+}
+
+/*
+------------------------------------------------------
+zenithAngle
+
+PURPOSE:		Compute the zenith angle of the spacecraft and the distance
+			from its projection to the unrefracted ground station
+INPUT ARGUMENTS:	Coordinates of the spacecraft and unrefracted ground station
+OUTPUT ARGUMENTS:	distGS2satProj
+RETURNED VALUE:		zenAng
+FUNCTIONS CALLED:	atan, satProjection, sqrt
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			As zenithAngle of refraction.c
+------------------------------------------------------
+*/
+
+template <class Earth = Sphere<>, class T>
+inline T zenithAngle(T x, T y, T z, T a, T b, T c, T &distGS2satProj)
+{
+	using std::atan;
+	using std::sqrt;
+	T satProj_x, satProj_y, satProj_z, height_sat, dx, dy, dz;
+
+	height_sat = satProjection<Earth>(x, y, z, satProj_x, satProj_y, satProj_z);
+	dx = satProj_x - a;
+	dy = satProj_y - b;
+	dz = satProj_z - c;
+	distGS2satProj = sqrt(dx * dx + dy * dy + dz * dz);
+
+	return atan(distGS2satProj / height_sat);
+}
+
+/*
+------------------------------------------------------
+refractiveIndex
+
+PURPOSE:		Compute the refractive index of the atmosphere with altitude
+REFERENCES:		(1) Noerdlinger (1999) p. 371
+INPUT ARGUMENTS:	Coordinates of the location
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		mu (refractive index)
+FUNCTIONS CALLED:	pow, Earth::height
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			As refractiveIndex of refraction.c, with the constants of Atmos
+------------------------------------------------------
+*/
+
+template <class Earth = Sphere<>, class Atmos = Shell<>, class T>
+inline T refractiveIndex(T q, T r, T s)
+{
+	using std::pow;
+	using detail::constant;
+	T tempFac = constant<T>(1.0) - constant<T>(Atmos::lapseRate) * Earth::height(q, r, s) / constant<T>(Atmos::tSealevel);
+
+	return constant<T>(1.0) + constant<T>(Atmos::muExcess) * pow(tempFac, constant<T>(Atmos::gamma));
+}
+
+/*
+------------------------------------------------------
+deltaAngle
+
+PURPOSE:		Compute the angular displacement between refracted and unrefracted ground station coordinates
+INPUT ARGUMENTS:	Spacecraft and ground station coordinates (x,y,z) and (a,b,c)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		dAng
+FUNCTIONS CALLED:	Atmos::zed, Earth::localRadius, zenithAngle
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			z_0 is zenAng + theta, as in refractPointModel
+------------------------------------------------------
+*/
+
+template <class Earth = Sphere<>, class Atmos = Shell<>, class T>
+inline T deltaAngle(T x, T y, T z, T a, T b, T c)
+{
+	T distGS2satProj, zenAng, radius, z_0;
+
+	zenAng = zenithAngle<Earth>(x, y, z, a, b, c, distGS2satProj);
+	radius = Earth::localRadius(a, b, c);
+	z_0 = zenAng + distGS2satProj / radius;
+
+	return z_0 - Atmos::zed(z_0, radius);
+}
+
+/*
+------------------------------------------------------
+refractPoint
+
+PURPOSE:		Compute the refracted ground station coordinates in a single pass
+INPUT ARGUMENTS:	Spacecraft coordinates (x,y,z) and unrefracted ground station coordinates (a,b,c)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f)
+RETURNED VALUE:		dAng
+FUNCTIONS CALLED:	Atmos::zed, Earth::localRadius, Earth::project, select
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			As refractPoint of refraction.c, or refractPointModel with EARTH_WGS84 with Wgs84
+------------------------------------------------------
+*/
+
+template <class Earth = Sphere<>, class Atmos = Shell<>, class T>
+inline T refractPoint(T x, T y, T z, T a, T b, T c, T &d, T &e, T &f)
+{
+	using detail::constant;
+	using std::atan;
+	using std::sqrt;
+	T satProj_x, satProj_y, satProj_z, height_sat, radius, dx, dy, dz, distGS2satProj, zenAng, z_0, dAng, scale;
+
+	height_sat = Earth::project(x, y, z, satProj_x, satProj_y, satProj_z);
+	radius = Earth::localRadius(a, b, c);
+	dx = satProj_x - a;
+	dy = satProj_y - b;
+	dz = satProj_z - c;
+	distGS2satProj = sqrt(dx * dx + dy * dy + dz * dz);
+	zenAng = atan(distGS2satProj / height_sat);
+	z_0 = zenAng + distGS2satProj / radius;
+	dAng = z_0 - Atmos::zed(z_0, radius);
+
+	/* Translate the ground station towards the projection by the arc length of dAng */
+	scale = radius * dAng;
+	scale = detail::select(scale == constant<T>(0.0), constant<T>(0.0), scale / distGS2satProj);
+	d = a + scale * dx;
+	e = b + scale * dy;
+	f = c + scale * dz;
+
+	return dAng;
+}
+
+/*
+------------------------------------------------------
+refractArrays
+
+PURPOSE:		Refract n points held as arrays
+INPUT ARGUMENTS:	n, spacecraft coordinates (x,y,z) and ground station coordinates (a,b,c) as arrays
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f) as arrays
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	refractPoint
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			With a simd T, whole vectors are loaded from the arrays of its element
+			type and the tail is done one element at a time.
+------------------------------------------------------
+*/
+
+template <class Earth = Sphere<>, class Atmos = Shell<>, class T = double>
+inline void refractArrays(std::size_t n, const typename detail::element<T>::type *x,
+	const typename detail::element<T>::type *y, const typename detail::element<T>::type *z,
+	const typename detail::element<T>::type *a, const typename detail::element<T>::type *b,
+	const typename detail::element<T>::type *c, typename detail::element<T>::type *d,
+	typename detail::element<T>::type *e, typename detail::element<T>::type *f)
+{
+	std::size_t i = 0;
+
+	if constexpr (!std::is_arithmetic<T>::value)
+	{
+#ifdef REFRACTION_HPP_SIMD
+		namespace stdx = std::experimental;
+		T vx, vy, vz, va, vb, vc, vd, ve, vf;
+
+		for (; i + T::size() <= n; i += T::size())
+		{
+			vx.copy_from(x + i, stdx::element_aligned);
+			vy.copy_from(y + i, stdx::element_aligned);
+			vz.copy_from(z + i, stdx::element_aligned);
+			va.copy_from(a + i, stdx::element_aligned);
+			vb.copy_from(b + i, stdx::element_aligned);
+			vc.copy_from(c + i, stdx::element_aligned);
+			refractPoint<Earth, Atmos>(vx, vy, vz, va, vb, vc, vd, ve, vf);
+			vd.copy_to(d + i, stdx::element_aligned);
+			ve.copy_to(e + i, stdx::element_aligned);
+			vf.copy_to(f + i, stdx::element_aligned);
+		}
+#endif
+	}
+	for (; i < n; i++)
+	{
+		refractPoint<Earth, Atmos>(x[i], y[i], z[i], a[i], b[i], c[i], d[i], e[i], f[i]);
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,486 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "refraction.h"
+#include "raytrace.h"
+#include "approx.h"
+#include "station.h"
+
+/*
+------------------------------------------------------
+station.c
+
+Each station's entry holds what the per-sample path needs, derived once from
+its position, height and weather when it is added or its weather changes:
+
+	e_w        = humidity 611.21 exp(17.502 (T - 273.15) / (T - 32.18)), vapour pressure in Pa (Buck)
+	M          = MOLEC_MEAN (1 - e_w / P) + MOLEC_WATER e_w / P
+	gamma      = M G_0 / (R_GAS R_LTROP) - 1, as GAMMA_TROP for moist air
+	mu0        = 1 + MU_EXCESS ((P - e_w) / STATION_P_STD) (T_SEALEVEL / T) + 3.73e-3 e_w / T^2
+	lapseScale = R_LTROP / T
+
+mu0 is the dry term of refractiveIndex scaled to the station's density plus the
+wet term of Smith and Weintraub (1953); refractStationIndex follows
+refractiveIndex with the station's surface as reference.
+
+The correction is ray traced (raytrace.c) through a profile of the station's
+own: its temperature and pressure are carried down to sea level along the
+tropospheric lapse rate,
+
+	T0 = T + R_LTROP height,  P0 = P (T0 / T)^(GAMMA_TROP + 1)
+
+and atmosProfileInit builds the layers from there. The ray traced dAng is
+tabulated against z_0 (raytraceBuildTable, STATION_CELLS cells up to
+STATION_Z0MAX, within about 2 mm on the ground), so a sample costs a table
+lookup; only samples beyond STATION_Z0MAX, within 2 degrees of the horizon,
+are ray traced. A table takes some 30 ms to build, outside the writer lock.
+The ray traced refractivity is dry: humidity enters mu0 and
+refractStationIndex only.
+
+The entries live in one cache-aligned array of STATION_MAX entries that never
+moves. Writers (stationAdd, stationUpdateWeather) take the registry mutex and
+bump a per-station sequence number to odd before rewriting the entry and back
+to even after. Readers (stationGet) never lock: they copy the entry and retry
+if the sequence number was odd or changed meanwhile, so a batch runs on a
+consistent snapshot of the weather taken when it starts, and a weather update
+never waits for a batch.
+
+The table coefficients and profile an entry points to are kept in two buffers
+per station, written alternately: an update writes the buffer the current
+entry does not use, so a snapshot stays intact until the second update after
+it. refractStationBatch checks the sequence number after its points and runs
+them again in the rare case that two updates came in meanwhile.
+------------------------------------------------------
+*/
+
+/* Table and profile of one weather state of a station */
+struct stationTable
+{
+	struct atmosProfile profile;
+	struct raytraceFixed fixed;
+	double coef[STATION_CELLS * APPROX_COEFS];
+	double maxError;                // Of the table against the ray tracing, in radians
+};
+
+struct stationRegistry
+{
+	struct refractStation st[STATION_MAX];
+	_Atomic unsigned seq[STATION_MAX];
+	_Atomic int count;
+	char name[STATION_MAX][STATION_NAME];
+	struct stationTable *tables[STATION_MAX];       // Two per station, written alternately
+	int active[STATION_MAX];                        // Which of the two the entry points to
+	pthread_mutex_t lock;           // Serializes writers only
+};
+
+/* Coefficients of st from its weather */
+static void deriveCoefficients(struct refractStation *st, const struct stationWeather *w)
+{
+	double T = w->temperature, P = w->pressure, ew, M;
+
+	ew = w->humidity * 611.21 * exp(17.502 * (T - 273.15) / (T - 32.18));
+	M = MOLEC_MEAN * (1.0 - ew / P) + MOLEC_WATER * ew / P;
+	st->gamma = M * G_0 / (R_GAS * R_LTROP) - 1.0;
+	st->mu0 = 1.0 + MU_EXCESS * ((P - ew) / STATION_P_STD) * (T_SEALEVEL / T) + 3.73e-3 * ew / (T * T);
+	st->lapseScale = R_LTROP / T;
+}
+
+/* Profile through the weather at height and its dAng table into *t; -1 if they give no valid profile */
+static int buildTable(struct stationTable *t, double height, const struct stationWeather *w)
+{
+	struct refractApprox tbl;
+	double T = w->temperature, T0 = T + R_LTROP * height;
+
+	if (atmosProfileInit(&t->profile, T0, w->pressure * pow(T0 / T, GAMMA_TROP + 1.0), R_LTROP, 11000.0) != 0)
+	{
+		return -1;
+	}
+	t->fixed.profile = &t->profile;
+	t->fixed.stationHeight = height;
+	if (raytraceBuildTable(&tbl, &t->fixed, STATION_Z0MAX, STATION_CELLS) != 0)
+	{
+		return -1;
+	}
+	memcpy(t->coef, tbl.coef, sizeof(t->coef));
+	t->maxError = tbl.maxError;
+	refractApproxFree(&tbl);
+	return 0;
+}
+
+static int validWeather(const struct stationWeather *w)
+{
+	return w->temperature > 0.0 && w->pressure > 0.0 && w->humidity >= 0.0 && w->humidity <= 1.0;
+}
+
+/*
+Under the writer lock, copy a built table into the buffer of station id that its entry
+does not use, point st at it and publish st. The buffer is written inside the odd
+sequence number, so a reader still on it from two updates ago sees the change.
+*/
+static void publish(struct stationRegistry *reg, int id, struct refractStation *st, const struct stationTable *built)
+{
+	int b = reg->active[id] ^ 1;
+	struct stationTable *t = &reg->tables[id][b];
+	unsigned s = atomic_load_explicit(&reg->seq[id], memory_order_relaxed);
+
+	atomic_store_explicit(&reg->seq[id], s + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	*t = *built;
+	t->fixed.profile = &t->profile;
+	st->table.nCells = STATION_CELLS;
+	st->table.z0Max = STATION_Z0MAX;
+	st->table.scale = STATION_CELLS / STATION_Z0MAX;
+	st->table.maxError = t->maxError;
+	st->table.coef = t->coef;
+	st->table.fn = NULL;
+	st->table.arg = NULL;
+	st->profile = &t->profile;
+	reg->st[id] = *st;
+	atomic_store_explicit(&reg->seq[id], s + 2, memory_order_release);
+	reg->active[id] = b;
+}
+
+/* Consistent copy of entry id; returns the even sequence number it was taken at */
+static unsigned snapshot(const struct stationRegistry *reg, int id, struct refractStation *st)
+{
+	unsigned before, after;
+
+	do
+	{
+		before = atomic_load_explicit(&reg->seq[id], memory_order_acquire);
+		*st = reg->st[id];
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(&reg->seq[id], memory_order_relaxed);
+	} while ((before & 1) || before != after);
+
+	return before;
+}
+
+/*
+------------------------------------------------------
+stationRegistryCreate
+
+PURPOSE:		Allocate an empty registry
+INPUT ARGUMENTS:	None
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		New registry, or NULL if memory could not be obtained
+FUNCTIONS CALLED:	aligned_alloc, pthread_mutex_init
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			None
+------------------------------------------------------
+*/
+
+struct stationRegistry *stationRegistryCreate(void)
+{
+	struct stationRegistry *reg = aligned_alloc(64, sizeof(*reg));
+
+	if (reg == NULL)
+	{
+		return NULL;
+	}
+	memset(reg, 0, sizeof(*reg));
+	pthread_mutex_init(&reg->lock, NULL);
+	return reg;
+}
+
+/*
+------------------------------------------------------
+stationRegistryLoad
+
+PURPOSE:		Read a station file (station.h) into a new registry
+INPUT ARGUMENTS:	path
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		New registry, or NULL if the file cannot be read, a line is malformed
+			or there are more than STATION_MAX stations
+FUNCTIONS CALLED:	fgets, sscanf, stationAdd, stationRegistryCreate
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The line number of a malformed line is reported on stderr
+------------------------------------------------------
+*/
+
+struct stationRegistry *stationRegistryLoad(const char *path)
+{
+	struct stationRegistry *reg;
+	struct stationWeather w;
+	char line[256], name[STATION_NAME], *hash;
+	double lat, lon, height, pressure, humidity;
+	int fields, lineNo = 0;
+	FILE *fp = fopen(path, "r");
+
+	if (fp == NULL)
+	{
+		return NULL;
+	}
+	reg = stationRegistryCreate();
+	while (reg != NULL && fgets(line, sizeof(line), fp) != NULL)
+	{
+		lineNo++;
+		hash = strchr(line, '#');
+		if (hash != NULL)
+		{
+			*hash = '\0';
+		}
+		w.temperature = T_SEALEVEL;
+		pressure = STATION_P_STD / 100.0;
+		humidity = 0.0;
+		fields = sscanf(line, "%31s %lf %lf %lf %lf %lf %lf", name, &lat, &lon, &height,
+			&w.temperature, &pressure, &humidity);
+		if (fields <= 0)
+		{
+			continue;
+		}
+		w.pressure = pressure * 100.0;
+		w.humidity = humidity / 100.0;
+		if ((fields != 4 && fields != 7)
+			|| stationAdd(reg, name, lat * PI / 180, lon * PI / 180, height, &w) < 0)
+		{
+			fprintf(stderr, "%s:%d: bad station\n", path, lineNo);
+			stationRegistryFree(reg);
+			reg = NULL;
+		}
+	}
+	fclose(fp);
+
+	return reg;
+}
+
+void stationRegistryFree(struct stationRegistry *reg)
+{
+	int id;
+
+	if (reg != NULL)
+	{
+		for (id = 0; id < atomic_load(&reg->count); id++)
+		{
+			free(reg->tables[id]);
+		}
+		pthread_mutex_destroy(&reg->lock);
+		free(reg);
+	}
+}
+
+/*
+------------------------------------------------------
+stationAdd
+
+PURPOSE:		Add a station to the registry
+INPUT ARGUMENTS:	reg, name, geocentric latitude and longitude in radians, height above the
+			surface in metres, surface weather *w
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		Index of the station, or -1 if the registry is full, the name is
+			already registered, the weather is out of range or memory could not be obtained
+FUNCTIONS CALLED:	buildTable, cos, deriveCoefficients, malloc, publish, sin, stationFind
+VER./DATE:		1.1 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Stations are never removed, so an index stays valid for the registry's life.
+			Builds the station's dAng table, some 30 ms.
+------------------------------------------------------
+*/
+
+int stationAdd(struct stationRegistry *reg, const char *name, double lat, double lon, double height,
+	const struct stationWeather *w)
+{
+	struct refractStation st;
+	struct stationTable built, *tables;
+	int id;
+
+	if (!validWeather(w) || !(EARTHRAD + height > 0.0) || buildTable(&built, height, w) != 0)
+	{
+		return -1;
+	}
+	tables = malloc(2 * sizeof(*tables));
+	if (tables == NULL)
+	{
+		return -1;
+	}
+	st.height = height;
+	st.a = (EARTHRAD + height) * cos(lat) * cos(lon);
+	st.b = (EARTHRAD + height) * cos(lat) * sin(lon);
+	st.c = (EARTHRAD + height) * sin(lat);
+	deriveCoefficients(&st, w);
+
+	pthread_mutex_lock(&reg->lock);
+	id = atomic_load(&reg->count);
+	if (id == STATION_MAX || stationFind(reg, name) >= 0)
+	{
+		pthread_mutex_unlock(&reg->lock);
+		free(tables);
+		return -1;
+	}
+	snprintf(reg->name[id], STATION_NAME, "%s", name);
+	reg->tables[id] = tables;
+	reg->active[id] = 1;
+	publish(reg, id, &st, &built);
+	atomic_store(&reg->count, id + 1);
+	pthread_mutex_unlock(&reg->lock);
+
+	return id;
+}
+
+/* Index of the station called name, or -1 */
+int stationFind(const struct stationRegistry *reg, const char *name)
+{
+	int id, n = atomic_load(&reg->count);
+
+	for (id = 0; id < n; id++)
+	{
+		if (strncmp(reg->name[id], name, STATION_NAME - 1) == 0)
+		{
+			return id;
+		}
+	}
+	return -1;
+}
+
+int stationCount(const struct stationRegistry *reg)
+{
+	return atomic_load(&reg->count);
+}
+
+/*
+------------------------------------------------------
+stationUpdateWeather
+
+PURPOSE:		Replace the weather of a station and its derived coefficients
+INPUT ARGUMENTS:	reg, id, *w
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		0, or -1 if id is not a station or the weather is out of range
+FUNCTIONS CALLED:	buildTable, deriveCoefficients, publish, snapshot
+VER./DATE:		1.2 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Readers see either the old or the new entry, never a mix; the next
+			refractStationBatch refracts through the new table. The table is
+			built before the writer lock is taken, some 30 ms.
+------------------------------------------------------
+*/
+
+int stationUpdateWeather(struct stationRegistry *reg, int id, const struct stationWeather *w)
+{
+	struct refractStation st;
+	struct stationTable built;
+
+	if (id < 0 || id >= stationCount(reg) || !validWeather(w))
+	{
+		return -1;
+	}
+	snapshot(reg, id, &st);
+	if (buildTable(&built, st.height, w) != 0)
+	{
+		return -1;
+	}
+	pthread_mutex_lock(&reg->lock);
+	st = reg->st[id];
+	deriveCoefficients(&st, w);
+	publish(reg, id, &st, &built);
+	pthread_mutex_unlock(&reg->lock);
+
+	return 0;
+}
+
+/*
+------------------------------------------------------
+stationGet
+
+PURPOSE:		Take a consistent copy of a station's entry
+INPUT ARGUMENTS:	reg, id (a valid index)
+OUTPUT ARGUMENTS:	*st
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	snapshot
+VER./DATE:		1.1 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Lock-free; retries only while a writer is rewriting this entry.
+			The table and profile the copy points to stay as they were until
+			the second weather update after it.
+------------------------------------------------------
+*/
+
+void stationGet(const struct stationRegistry *reg, int id, struct refractStation *st)
+{
+	snapshot(reg, id, st);
+}
+
+/*
+------------------------------------------------------
+refractStationIndex
+
+PURPOSE:		Refractive index of a station's atmosphere at a height
+INPUT ARGUMENTS:	*st, height above the Earth surface in metres
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		Refractive index
+FUNCTIONS CALLED:	pow
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			refractiveIndex with the station's surface instead of sea level at T_SEALEVEL;
+			valid in the troposphere
+------------------------------------------------------
+*/
+
+double refractStationIndex(const struct refractStation *st, double height)
+{
+	return 1.0 + (st->mu0 - 1.0) * pow(1.0 - st->lapseScale * (height - st->height), st->gamma);
+}
+
+/*
+------------------------------------------------------
+refractStationPoint
+
+PURPOSE:		Refracted position of a registered station for one spacecraft position
+INPUT ARGUMENTS:	*st, spacecraft coordinates (x,y,z)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (*d,*e,*f)
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	refractPointModel
+VER./DATE:		1.2 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			ATMOS_RAYTRACE through the station's table, and its profile beyond
+			STATION_Z0MAX; identical to refractPointModel with that model
+------------------------------------------------------
+*/
+
+void refractStationPoint(const struct refractStation *st, double x, double y, double z,
+	double *d, double *e, double *f)
+{
+	struct refractModel model = { .atmos = ATMOS_RAYTRACE, .stationHeight = st->height, .profile = st->profile,
+		.table = &st->table, .earth = EARTH_SPHERE };
+
+	refractPointModel(&model, x, y, z, st->a, st->b, st->c, d, e, f, NULL);
+}
+
+/*
+------------------------------------------------------
+refractStationBatch
+
+PURPOSE:		refractStationPoint for n spacecraft positions seen from one station
+INPUT ARGUMENTS:	reg, id, n, spacecraft coordinates (x,y,z) as arrays
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (d,e,f) as arrays
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	refractStationPoint, snapshot
+VER./DATE:		1.1 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The whole batch uses the entry as it was when the batch started. If two
+			weather updates come in before it ends, its table may have been
+			overwritten, and the batch is run again on a new snapshot.
+------------------------------------------------------
+*/
+
+void refractStationBatch(const struct stationRegistry *reg, int id, size_t n, const double *x, const double *y,
+	const double *z, double *d, double *e, double *f)
+{
+	struct refractStation st;
+	unsigned seq;
+	size_t i;
+
+	do
+	{
+		seq = snapshot(reg, id, &st);
+		for (i = 0; i < n; i++)
+		{
+			refractStationPoint(&st, x[i], y[i], z[i], &d[i], &e[i], &f[i]);
+		}
+		atomic_thread_fence(memory_order_acquire);
+	} while (atomic_load_explicit(&reg->seq[id], memory_order_relaxed) - seq > 2);
+}
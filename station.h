@@ -0,0 +1,74 @@
+#ifndef STATION_H
+#define STATION_H
+
+#include <stddef.h>
+#include "approx.h"
+
+/*
+Registry of ground stations, each with its own height and surface weather
+
+Station files are text, one station per line, '#' starting a comment:
+
+	name  lat_deg  lon_deg  height_m  [temperature_K  pressure_hPa  humidity_%]
+
+Missing weather defaults to T_SEALEVEL, STATION_P_STD and dry air.
+*/
+#define STATION_MAX 256         // Capacity of a registry
+#define STATION_NAME 32         // Longest name kept, including the terminating NUL
+#define STATION_P_STD 101325.0  // Pressure of the sea-level density of MU_EXCESS, in Pa
+#define MOLEC_WATER 18.01528    // Molecular weight of water vapour
+#define STATION_CELLS 128       // Cells of each station's dAng table
+#define STATION_Z0MAX 1.5358897417550099        // 88 degrees, the largest z_0 of the table; ray traced beyond
+
+struct stationWeather
+{
+	double temperature;             // Surface air temperature, in K
+	double pressure;                // Surface pressure, in Pa
+	double humidity;                // Relative humidity, 0 to 1
+};
+
+struct atmosProfile;
+
+/* Derived coefficients of one station; the first cache line holds the position and the surface index */
+struct refractStation
+{
+	_Alignas(64) double a, b, c;    // Position, at EARTHRAD + height from Earth centre
+	double height;                  // Height above the Earth surface, in metres
+	double mu0;                     // Surface refractive index
+	double gamma;                   // Density exponent g M / (R_gas lapse) - 1 of the moist air
+	double lapseScale;              // R_LTROP / surface temperature, in 1/m
+	struct refractApprox table;     // Ray traced dAng against z_0 through the station's weather
+	const struct atmosProfile *profile;     // That atmosphere, ray traced beyond table.z0Max
+};
+
+struct stationRegistry;
+
+/*
+Function prototypes
+*/
+struct stationRegistry *stationRegistryCreate(void);
+
+struct stationRegistry *stationRegistryLoad(const char *path);
+
+void stationRegistryFree(struct stationRegistry *reg);
+
+int stationAdd(struct stationRegistry *reg, const char *name, double lat, double lon, double height,
+	const struct stationWeather *w);
+
+int stationFind(const struct stationRegistry *reg, const char *name);
+
+int stationCount(const struct stationRegistry *reg);
+
+int stationUpdateWeather(struct stationRegistry *reg, int id, const struct stationWeather *w);
+
+void stationGet(const struct stationRegistry *reg, int id, struct refractStation *st);
+
+double refractStationIndex(const struct refractStation *st, double height);
+
+void refractStationPoint(const struct refractStation *st, double x, double y, double z,
+	double *d, double *e, double *f);
+
+void refractStationBatch(const struct stationRegistry *reg, int id, size_t n, const double *x, const double *y,
+	const double *z, double *d, double *e, double *f);
+
+#endif
@@ -0,0 +1,145 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "refraction.h"
+#include "geodesy.h"
+
+/*
+------------------------------------------------------
+batch-check.c
+
+Check refractBatch against refractPoint, and refractBatchWgs84 against
+refractPointModel with EARTH_WGS84, over random passes: stations spread over
+the Earth, spacecraft from 300 km to GPS altitude at zenith angles up to the
+horizon. Run it once per kernel with REFRACTION_KERNEL=scalar, avx2 or avx512;
+a kernel the CPU lacks would fall back to the next one, so the check exits
+with SKIPPED instead of testing a kernel twice.
+
+The vector kernels use their own polynomials for the trigonometric functions
+(batch-kernel.h), so they are held to a tolerance rather than to equality.
+
+USAGE:			batch-check [points [tolerance]]
+			tolerance is absolute, in metres (default 1e-5)
+------------------------------------------------------
+*/
+
+#define POINTS 100000
+#define SKIPPED 77              // Exit status when REFRACTION_KERNEL names a kernel this CPU does not run
+
+/* Uniform on [0,1), from a fixed sequence so that a failure can be reproduced */
+static double uniform(unsigned long long *state)
+{
+	*state = *state * 6364136223846793005ull + 1442695040888963407ull;
+	return (double)(*state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Largest distance between the points of (d,e,f) and (p,q,r); -1 if only one of a pair is NaN */
+static double maxDistance(size_t n, const double *d, const double *e, const double *f,
+	const double *p, const double *q, const double *r, size_t *nans)
+{
+	double dist, m = 0.0;
+	size_t i;
+
+	*nans = 0;
+	for (i = 0; i < n; i++)
+	{
+		if (isnan(d[i]) || isnan(p[i]))
+		{
+			if (isnan(d[i]) != isnan(p[i]))
+			{
+				return -1.0;
+			}
+			(*nans)++;
+			continue;
+		}
+		dist = sqrt((d[i] - p[i]) * (d[i] - p[i]) + (e[i] - q[i]) * (e[i] - q[i]) + (f[i] - r[i]) * (f[i] - r[i]));
+		m = dist > m ? dist : m;
+	}
+	return m;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct refractModel wgs84 = { .atmos = ATMOS_SHELL, .stationHeight = GS_HEIGHT,
+		.profile = NULL, .table = NULL, .earth = EARTH_WGS84 };
+	size_t n = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : POINTS, i, nans;
+	double tol = argc > 2 ? strtod(argv[2], NULL) : 1e-5, *buf, *x, *y, *z, *a, *b, *c, *d, *e, *f, *p, *q, *r;
+	double lat, lon, zen, az, range, sphere, ellipsoid;
+	const char *kernel = getenv("REFRACTION_KERNEL");
+	unsigned long long state = 20261016;
+	int failed;
+
+	if (kernel != NULL && strcmp(kernel, refractBatchKernel()) != 0)
+	{
+		printf("REFRACTION_KERNEL=%s, but this CPU runs the %s kernel: skipped\n", kernel, refractBatchKernel());
+		return SKIPPED;
+	}
+
+	buf = n > 0 ? malloc(n * 12 * sizeof(double)) : NULL;
+	if (buf == NULL)
+	{
+		fprintf(stderr, "no points\n");
+		return 2;
+	}
+	x = buf;
+	y = x + n;
+	z = y + n;
+	a = z + n;
+	b = a + n;
+	c = b + n;
+	d = c + n;
+	e = d + n;
+	f = e + n;
+	p = f + n;
+	q = p + n;
+	r = q + n;
+
+	/* Station on the sphere, spacecraft along a random direction above its local horizon */
+	for (i = 0; i < n; i++)
+	{
+		lat = asin(2.0 * uniform(&state) - 1.0);
+		lon = 2.0 * PI * uniform(&state);
+		zen = acos(uniform(&state));
+		az = 2.0 * PI * uniform(&state);
+		range = 300e3 + 20e6 * uniform(&state);
+		a[i] = EARTHRAD * cos(lat) * cos(lon);
+		b[i] = EARTHRAD * cos(lat) * sin(lon);
+		c[i] = EARTHRAD * sin(lat);
+		x[i] = a[i] + range * (cos(zen) * cos(lat) * cos(lon) - sin(zen) * (cos(az) * sin(lat) * cos(lon) + sin(az) * sin(lon)));
+		y[i] = b[i] + range * (cos(zen) * cos(lat) * sin(lon) - sin(zen) * (cos(az) * sin(lat) * sin(lon) - sin(az) * cos(lon)));
+		z[i] = c[i] + range * (cos(zen) * sin(lat) + sin(zen) * cos(az) * cos(lat));
+	}
+
+	refractBatch(n, x, y, z, a, b, c, d, e, f);
+	for (i = 0; i < n; i++)
+	{
+		refractPoint(x[i], y[i], z[i], a[i], b[i], c[i], &p[i], &q[i], &r[i], NULL);
+	}
+	sphere = maxDistance(n, d, e, f, p, q, r, &nans);
+	printf("refractBatch (%s) against refractPoint: %zu points, %zu NaN, max difference %.3e m\n",
+		refractBatchKernel(), n, nans, sphere);
+
+	/* The same passes seen from stations on the ellipsoid */
+	for (i = 0; i < n; i++)
+	{
+		geodeticFromCartesian(a[i], b[i], c[i], &lat, &lon, &range);
+		cartesianFromGeodetic(lat, lon, 0.0, &a[i], &b[i], &c[i]);
+	}
+	refractBatchWgs84(n, x, y, z, a, b, c, d, e, f);
+	for (i = 0; i < n; i++)
+	{
+		refractPointModel(&wgs84, x[i], y[i], z[i], a[i], b[i], c[i], &p[i], &q[i], &r[i], NULL);
+	}
+	ellipsoid = maxDistance(n, d, e, f, p, q, r, &nans);
+	printf("refractBatchWgs84 against refractPointModel: %zu points, %zu NaN, max difference %.3e m\n",
+		n, nans, ellipsoid);
+
+	failed = sphere < 0.0 || sphere > tol || ellipsoid < 0.0 || ellipsoid > tol;
+	if (failed)
+	{
+		fprintf(stderr, "difference above %g m, or NaN in only one of a pair\n", tol);
+	}
+	free(buf);
+	return failed;
+}
@@ -0,0 +1,74 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+------------------------------------------------------
+compare-hex.c
+
+Compare two files of whitespace-separated numbers, such as the hex float output
+of refraction -o hex, value by value. The files must hold the same number of
+values; each pair must agree to within the tolerance, or both be NaN.
+
+USAGE:			compare-hex result expected [tolerance]
+			tolerance is absolute, in metres (default 1e-6)
+------------------------------------------------------
+*/
+
+int main(int argc, char **argv)
+{
+	FILE *got, *want;
+	double u, v, diff, maxDiff = 0.0, tol = 1e-6;
+	long n = 0, bad = 0;
+	int ru, rv;
+
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: %s result expected [tolerance]\n", argv[0]);
+		return 2;
+	}
+	if (argc > 3)
+	{
+		tol = strtod(argv[3], NULL);
+	}
+	got = fopen(argv[1], "r");
+	want = fopen(argv[2], "r");
+	if (got == NULL || want == NULL)
+	{
+		perror(got == NULL ? argv[1] : argv[2]);
+		return 1;
+	}
+
+	for (;;)
+	{
+		ru = fscanf(got, "%lf", &u);
+		rv = fscanf(want, "%lf", &v);
+		if (ru != 1 || rv != 1)
+		{
+			break;
+		}
+		diff = fabs(u - v);
+		if (isnan(u) != isnan(v) || diff > tol)
+		{
+			if (bad++ < 10)
+			{
+				fprintf(stderr, "value %ld (line %ld): %a, expected %a\n", n, n / 3 + 1, u, v);
+			}
+		}
+		else if (diff > maxDiff)
+		{
+			maxDiff = diff;
+		}
+		n++;
+	}
+	fclose(got);
+	fclose(want);
+
+	if (ru != rv)
+	{
+		fprintf(stderr, "%s and %s hold different numbers of values\n", argv[1], argv[2]);
+		return 1;
+	}
+	printf("%ld values, %ld outside %g, largest difference inside %g\n", n, bad, tol, maxDiff);
+	return bad > 0 || n == 0;
+}
@@ -0,0 +1,132 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "refraction.h"
+#include "dem.h"
+#include "geodesy.h"
+
+/*
+------------------------------------------------------
+dem-check.c
+
+Write a synthetic 3 arc-second tile N45E007.hgt whose height is a plane in the
+sample grid, 3 m per row southwards and 1 m per column eastwards, and check:
+- demHeight returns the plane at geodetic latitudes and longitudes, and sea
+  level where there is no tile;
+- refractTerrainBatch refracts stations on the ellipsoid at the terrain height
+  under their geodetic latitude, as refractPointModel does given that height.
+The geocentric latitude of those stations is 0.19 degrees, 230 rows, further
+south: about 690 m of height off on this plane.
+------------------------------------------------------
+*/
+
+#define SIDE 1201
+#define STATIONS 5
+#define MAST 10.0
+
+/* Height of the plane at geodetic (latDeg, lonDeg) in the tile */
+static double plane(double latDeg, double lonDeg)
+{
+	return 3.0 * (46.0 - latDeg) * (SIDE - 1) + (lonDeg - 7.0) * (SIDE - 1);
+}
+
+/* Write the tile into dir; -1 on failure */
+static int writeTile(const char *dir)
+{
+	static unsigned char tile[SIDE * SIDE * 2];
+	char path[4096];
+	FILE *fp;
+	int row, col, v, ok;
+
+	for (row = 0; row < SIDE; row++)
+	{
+		for (col = 0; col < SIDE; col++)
+		{
+			v = 3 * row + col;
+			tile[2 * (row * SIDE + col)] = (unsigned char)(v >> 8);
+			tile[2 * (row * SIDE + col) + 1] = (unsigned char)v;
+		}
+	}
+	snprintf(path, sizeof(path), "%s/N45E007.hgt", dir);
+	fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		return -1;
+	}
+	ok = fwrite(tile, 1, sizeof(tile), fp) == sizeof(tile);
+	return fclose(fp) == 0 && ok ? 0 : -1;
+}
+
+static void removeTile(const char *dir)
+{
+	char path[4096];
+
+	snprintf(path, sizeof(path), "%s/N45E007.hgt", dir);
+	remove(path);
+	rmdir(dir);
+}
+
+int main(void)
+{
+	static const double latDeg[STATIONS] = { 45.5, 45.05, 45.95, 45.2, 45.75 };
+	static const double lonDeg[STATIONS] = { 7.25, 7.5, 7.05, 7.9, 7.4 };
+	double x[STATIONS], y[STATIONS], z[STATIONS], a[STATIONS], b[STATIONS], c[STATIONS],
+		d[STATIONS], e[STATIONS], f[STATIONS], p, q, r, h, dist, heightErr = 0.0, refractErr = 0.0,
+		geocentric = 0.0;
+	struct refractModel model = { .atmos = ATMOS_SHELL, .stationHeight = 0.0, .profile = NULL, .table = NULL,
+		.earth = EARTH_SPHERE };
+	char dir[] = "/tmp/dem-check.XXXXXX";
+	struct demCache *dem;
+	double sea;
+	int i, status, failed;
+
+	if (mkdtemp(dir) == NULL || writeTile(dir) != 0)
+	{
+		fprintf(stderr, "cannot write the test tile\n");
+		return 2;
+	}
+	dem = demOpen(dir, 2);
+	if (dem == NULL)
+	{
+		removeTile(dir);
+		return 2;
+	}
+
+	/* Stations on the ellipsoid, each seeing a spacecraft 800 km up 6 degrees to the north-east */
+	for (i = 0; i < STATIONS; i++)
+	{
+		h = demHeight(dem, latDeg[i] * PI / 180.0, lonDeg[i] * PI / 180.0);
+		heightErr = fmax(heightErr, fabs(h - plane(latDeg[i], lonDeg[i])));
+		cartesianFromGeodetic(latDeg[i] * PI / 180.0, lonDeg[i] * PI / 180.0, 0.0, &a[i], &b[i], &c[i]);
+		cartesianFromGeodetic((latDeg[i] + 6.0) * PI / 180.0, (lonDeg[i] + 6.0) * PI / 180.0, 800e3,
+			&x[i], &y[i], &z[i]);
+		geocentric = fmax(geocentric, fabs(h - plane(asin(c[i] / sqrt(a[i] * a[i] + b[i] * b[i] + c[i] * c[i]))
+			* 180.0 / PI, lonDeg[i])));
+	}
+	sea = demHeight(dem, 10.5 * PI / 180.0, 10.5 * PI / 180.0);
+
+	status = refractTerrainBatch(dem, MAST, STATIONS, x, y, z, a, b, c, d, e, f);
+	for (i = 0; i < STATIONS; i++)
+	{
+		model.stationHeight = plane(latDeg[i], lonDeg[i]) + MAST;
+		refractPointModel(&model, x[i], y[i], z[i], a[i], b[i], c[i], &p, &q, &r, NULL);
+		dist = sqrt((d[i] - p) * (d[i] - p) + (e[i] - q) * (e[i] - q) + (f[i] - r) * (f[i] - r));
+		refractErr = dist > refractErr || isnan(dist) ? dist : refractErr;
+	}
+	demClose(dem);
+	removeTile(dir);
+
+	printf("demHeight: max %.3e m off the plane, %g m without a tile; the geocentric latitude is %.0f m off\n",
+		heightErr, sea, geocentric);
+	printf("refractTerrainBatch against refractPointModel at the terrain height: max %.3e m\n", refractErr);
+
+	failed = status != 0 || !(heightErr <= 1e-6) || sea != 0.0 || !(refractErr <= 1e-6) || !(geocentric > 500.0);
+	if (failed)
+	{
+		fprintf(stderr, "dem check failed\n");
+	}
+	return failed;
+}
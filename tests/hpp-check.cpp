@@ -0,0 +1,91 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "refraction.hpp"
+
+/*
+------------------------------------------------------
+hpp-check.cpp
+
+Check the templates of refraction.hpp against the C functions over random
+passes. In double, with both sides built with -ffp-contract=off, the sphere
+and WGS84 instantiations must give the same bits as refractPoint and
+refractPointModel; zenithAngle and refractiveIndex are compared on the way.
+The simd instantiation of refractArrays, where the header has one, is held to
+a tolerance, since the vector math functions are not those of the C library.
+
+USAGE:			hpp-check [points [tolerance]]
+			tolerance is absolute, in metres (default 1e-6)
+------------------------------------------------------
+*/
+
+namespace rf = refraction;
+
+/* Uniform on [0,1), from a fixed sequence so that a failure can be reproduced */
+static double uniform(unsigned long long &state)
+{
+	state = state * 6364136223846793005ull + 1442695040888963407ull;
+	return (double)(state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static bool same(double u, double v)
+{
+	return u == v || (std::isnan(u) && std::isnan(v));
+}
+
+int main(int argc, char **argv)
+{
+	const struct refractModel wgs84 = { ATMOS_SHELL, GS_HEIGHT, NULL, NULL, EARTH_WGS84 };
+	size_t n = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 100000, i, sphereDiff = 0, wgs84Diff = 0;
+	double tol = argc > 2 ? strtod(argv[2], NULL) : 1e-6, simdMax = 0.0;
+	std::vector<double> x(n), y(n), z(n), a(n), b(n), c(n), d(n), e(n), f(n);
+	unsigned long long state = 20261016;
+
+	/* Station on the ellipsoid, spacecraft near its zenith out to about 40 degrees of arc */
+	for (i = 0; i < n; i++)
+	{
+		double lat = std::asin(2.0 * uniform(state) - 1.0), lon = 2.0 * PI * uniform(state);
+		double dLat = (uniform(state) - 0.5) * 0.6, dLon = (uniform(state) - 0.5) * 0.6;
+
+		cartesianFromGeodetic(lat, lon, 0.0, &a[i], &b[i], &c[i]);
+		cartesianFromGeodetic(lat + dLat, lon + dLon, 300e3 + 20e6 * uniform(state), &x[i], &y[i], &z[i]);
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		double d1, e1, f1, d2, e2, f2, dist1, dist2;
+
+		refractPoint(x[i], y[i], z[i], a[i], b[i], c[i], &d1, &e1, &f1, NULL);
+		rf::refractPoint(x[i], y[i], z[i], a[i], b[i], c[i], d2, e2, f2);
+		sphereDiff += !same(d1, d2) || !same(e1, e2) || !same(f1, f2)
+			|| !same(zenithAngle(x[i], y[i], z[i], a[i], b[i], c[i], &dist1), rf::zenithAngle(x[i], y[i], z[i], a[i], b[i], c[i], dist2))
+			|| !same(dist1, dist2)
+			|| !same(refractiveIndex(a[i], b[i], c[i]), rf::refractiveIndex(a[i], b[i], c[i]));
+
+		refractPointModel(&wgs84, x[i], y[i], z[i], a[i], b[i], c[i], &d1, &e1, &f1, NULL);
+		rf::refractPoint<rf::Wgs84>(x[i], y[i], z[i], a[i], b[i], c[i], d2, e2, f2);
+		wgs84Diff += !same(d1, d2) || !same(e1, e2) || !same(f1, f2);
+	}
+	printf("%zu points: %zu differ from the C functions on the sphere, %zu on WGS84\n", n, sphereDiff, wgs84Diff);
+
+#ifdef REFRACTION_HPP_SIMD
+	rf::refractArrays<rf::Sphere<>, rf::Shell<>, std::experimental::native_simd<double>>(n, x.data(), y.data(),
+		z.data(), a.data(), b.data(), c.data(), d.data(), e.data(), f.data());
+	for (i = 0; i < n; i++)
+	{
+		double d1, e1, f1;
+
+		refractPoint(x[i], y[i], z[i], a[i], b[i], c[i], &d1, &e1, &f1, NULL);
+		simdMax = std::fmax(simdMax, std::fabs(d1 - d[i]) + std::fabs(e1 - e[i]) + std::fabs(f1 - f[i]));
+	}
+	printf("simd<double, %zu>: max difference %.3e m\n", std::experimental::native_simd<double>::size(), simdMax);
+#endif
+
+	if (sphereDiff > 0 || wgs84Diff > 0 || !(simdMax <= tol))
+	{
+		fprintf(stderr, "the templates do not match the C functions\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,141 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "refraction.h"
+#include "inverse.h"
+
+/*
+------------------------------------------------------
+inverse-check.c
+
+Check that refractInverse undoes refractPointModel for the refracting shell on
+the sphere, at the default station height and at 3000 m: stations spread over
+the Earth, spacecraft from 300 km to GPS altitude, kept where z_0 of
+refractPoint is below 85 degrees (short of the fold at the horizon, see
+inverse.c). The true station
+found from the apparent one must be the station that was refracted, and
+refract back onto the apparent one. refractInverseBatch, warm-started across
+the points, must agree with refractInverse, and models refractInverse does not
+solve must be rejected.
+------------------------------------------------------
+*/
+
+#define POINTS 20000
+#define TOLERANCE 1e-6          // Allowed distance, in metres
+#define Z0_MAX 85.0             // Largest z_0 of the points, in degrees
+
+/* Uniform on [0,1), from a fixed sequence so that a failure can be reproduced */
+static double uniform(unsigned long long *state)
+{
+	*state = *state * 6364136223846793005ull + 1442695040888963407ull;
+	return (double)(*state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double distance(double a, double b, double c, double p, double q, double r)
+{
+	return sqrt((a - p) * (a - p) + (b - q) * (b - q) + (c - r) * (c - r));
+}
+
+int main(void)
+{
+	static const double stationHeights[] = { GS_HEIGHT, 3000.0 };
+	struct refractModel model = { .atmos = ATMOS_SHELL, .stationHeight = GS_HEIGHT, .profile = NULL, .table = NULL,
+		.earth = EARTH_SPHERE };
+	struct refractResult res;
+	struct refractModel raytrace = { .atmos = ATMOS_RAYTRACE, .stationHeight = GS_HEIGHT, .profile = NULL,
+		.table = NULL, .earth = EARTH_SPHERE };
+	double *buf, *x, *y, *z, *a, *b, *c, *d, *e, *f, *p, *q, *r, *g, *h, *k, lat, lon, zen, az, range, u, v, w,
+		trueErr, backErr, batchErr;
+	unsigned long long state = 20261016;
+	size_t i, m, n = 0, failures;
+	long iterations;
+	int iter, worst, failed = 0;
+
+	buf = malloc(POINTS * 15 * sizeof(double));
+	if (buf == NULL)
+	{
+		fprintf(stderr, "no memory\n");
+		return 2;
+	}
+	x = buf;
+	y = x + POINTS;
+	z = y + POINTS;
+	a = z + POINTS;
+	b = a + POINTS;
+	c = b + POINTS;
+	d = c + POINTS;
+	e = d + POINTS;
+	f = e + POINTS;
+	p = f + POINTS;
+	q = p + POINTS;
+	r = q + POINTS;
+	g = r + POINTS;
+	h = g + POINTS;
+	k = h + POINTS;
+
+	/* Station on the sphere, spacecraft along a random direction above its local horizon, kept below Z0_MAX */
+	while (n < POINTS)
+	{
+		lat = asin(2.0 * uniform(&state) - 1.0);
+		lon = 2.0 * PI * uniform(&state);
+		zen = acos(uniform(&state));
+		az = 2.0 * PI * uniform(&state);
+		range = 300e3 + 20e6 * uniform(&state);
+		a[n] = EARTHRAD * cos(lat) * cos(lon);
+		b[n] = EARTHRAD * cos(lat) * sin(lon);
+		c[n] = EARTHRAD * sin(lat);
+		x[n] = a[n] + range * (cos(zen) * cos(lat) * cos(lon) - sin(zen) * (cos(az) * sin(lat) * cos(lon) + sin(az) * sin(lon)));
+		y[n] = b[n] + range * (cos(zen) * cos(lat) * sin(lon) - sin(zen) * (cos(az) * sin(lat) * sin(lon) - sin(az) * cos(lon)));
+		z[n] = c[n] + range * (cos(zen) * sin(lat) + sin(zen) * cos(az) * cos(lat));
+		refractPoint(x[n], y[n], z[n], a[n], b[n], c[n], &u, &v, &w, &res);
+		n += res.z_0 < Z0_MAX * PI / 180.0;
+	}
+
+	for (m = 0; m < sizeof(stationHeights) / sizeof(stationHeights[0]); m++)
+	{
+		model.stationHeight = stationHeights[m];
+		trueErr = backErr = batchErr = 0.0;
+		failures = 0;
+		iterations = 0;
+		for (i = 0; i < POINTS; i++)
+		{
+			refractPointModel(&model, x[i], y[i], z[i], a[i], b[i], c[i], &d[i], &e[i], &f[i], NULL);
+			iter = refractInverse(&model, x[i], y[i], z[i], d[i], e[i], f[i], &p[i], &q[i], &r[i], NULL);
+			if (iter < 0)
+			{
+				failures++;
+				continue;
+			}
+			iterations += iter;
+			trueErr = fmax(trueErr, distance(p[i], q[i], r[i], a[i], b[i], c[i]));
+			refractPointModel(&model, x[i], y[i], z[i], p[i], q[i], r[i], &u, &v, &w, NULL);
+			backErr = fmax(backErr, distance(u, v, w, d[i], e[i], f[i]));
+		}
+
+		worst = refractInverseBatch(&model, POINTS, x, y, z, d, e, f, g, h, k);
+		for (i = 0; i < POINTS; i++)
+		{
+			batchErr = fmax(batchErr, isnan(g[i]) ? INFINITY : distance(g[i], h[i], k[i], p[i], q[i], r[i]));
+		}
+
+		printf("station height %g m: %zu failed, %.2f iterations on average, true station %.3e m off, "
+			"refracted back %.3e m off\n", model.stationHeight, failures,
+			(double)iterations / (POINTS - failures), trueErr, backErr);
+		printf("refractInverseBatch: at most %d iterations, %.3e m from refractInverse\n", worst, batchErr);
+		if (failures > 0 || !(trueErr <= TOLERANCE) || !(backErr <= TOLERANCE) || worst < 0
+			|| !(batchErr <= TOLERANCE))
+		{
+			fprintf(stderr, "station height %g m: inverse check failed\n", model.stationHeight);
+			failed = 1;
+		}
+	}
+
+	if (refractInverse(&raytrace, x[0], y[0], z[0], d[0], e[0], f[0], &p[0], &q[0], &r[0], NULL) != -1)
+	{
+		fprintf(stderr, "a ray traced model was not rejected\n");
+		failed = 1;
+	}
+
+	free(buf);
+	return failed;
+}
@@ -0,0 +1,151 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "refraction.h"
+#include "raytrace.h"
+#include "geodesy.h"
+#include "jacobian.h"
+
+/*
+------------------------------------------------------
+jacobian-check.c
+
+Check refractPointJacobian against central differences of refractPointModel,
+on the sphere and on the WGS84 ellipsoid, with the refracting shell and with a
+ray traced atmosphere. Stations lie on the equator, at mid-latitude and near
+the pole; spacecraft at 500 km and 20000 km, from 10 to 85 degrees of elevation
+(at the zenith the displacement has no direction). Also check that the outputs are those of refractPointModel and that a
+WGS84 Jacobian costs a few evaluations, not the thirteen of a finite
+difference Jacobian.
+------------------------------------------------------
+*/
+
+#define STEP_SAT 1e-6           // Central difference step, relative to |spacecraft|
+#define STEP_STA 1e-6           // Central difference step, relative to |station|
+#define TOLERANCE 1e-7          // Allowed difference, for partials of order 1
+#define TIMED 20000
+
+static double seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Largest difference between the partials and central differences of refractPointModel at p */
+static double differenceError(const struct refractModel *model, const double p[6], const double *jSat,
+	const double *jSta)
+{
+	double q[6], plus[3], minus[3], h, fd, err = 0.0;
+	int i, j;
+
+	for (j = 0; j < 6; j++)
+	{
+		for (i = 0; i < 6; i++)
+		{
+			q[i] = p[i];
+		}
+		h = (j < 3 ? STEP_SAT : STEP_STA) * sqrt(j < 3 ? p[0] * p[0] + p[1] * p[1] + p[2] * p[2]
+			: p[3] * p[3] + p[4] * p[4] + p[5] * p[5]);
+		q[j] = p[j] + h;
+		refractPointModel(model, q[0], q[1], q[2], q[3], q[4], q[5], &plus[0], &plus[1], &plus[2], NULL);
+		q[j] = p[j] - h;
+		refractPointModel(model, q[0], q[1], q[2], q[3], q[4], q[5], &minus[0], &minus[1], &minus[2], NULL);
+		for (i = 0; i < 3; i++)
+		{
+			fd = (plus[i] - minus[i]) / (2.0 * h);
+			err = fmax(err, fabs((j < 3 ? jSat : jSta)[3 * i + j % 3] - fd));
+		}
+	}
+	return err;
+}
+
+int main(void)
+{
+	static const double latitudes[] = { 0.0, 0.8, 1.5 };
+	static const double heights[] = { 500e3, 20000e3 };
+	static const double elevations[] = { 10.0, 30.0, 60.0, 85.0 };
+	static const char *names[] = { "sphere, shell", "sphere, ray traced", "WGS84, shell", "WGS84, ray traced" };
+	struct atmosProfile profile;
+	struct refractModel models[4];
+	double p[6], jSat[9], jSta[9], d, e, f, d0, e0, f0, lat, el, east[3], north[3], up[3], range, err, t0,
+		tModel, tJacobian;
+	size_t m, i, j, k, differ;
+	int failed = 0;
+
+	atmosProfileUSSA76(&profile);
+	for (m = 0; m < 4; m++)
+	{
+		models[m] = (struct refractModel){ .atmos = m % 2 ? ATMOS_RAYTRACE : ATMOS_SHELL, .stationHeight = GS_HEIGHT,
+			.profile = m % 2 ? &profile : NULL, .table = NULL, .earth = m < 2 ? EARTH_SPHERE : EARTH_WGS84 };
+	}
+
+	for (m = 0; m < 4; m++)
+	{
+		err = 0.0;
+		differ = 0;
+		for (i = 0; i < sizeof(latitudes) / sizeof(latitudes[0]); i++)
+		{
+			for (j = 0; j < sizeof(heights) / sizeof(heights[0]); j++)
+			{
+				for (k = 0; k < sizeof(elevations) / sizeof(elevations[0]); k++)
+				{
+					/* Station on the surface, spacecraft seen to the north-east at the given elevation */
+					lat = latitudes[i];
+					cartesianFromGeodetic(lat, 0.3, 0.0, &p[3], &p[4], &p[5]);
+					up[0] = cos(lat) * cos(0.3);
+					up[1] = cos(lat) * sin(0.3);
+					up[2] = sin(lat);
+					east[0] = -sin(0.3);
+					east[1] = cos(0.3);
+					east[2] = 0.0;
+					north[0] = -sin(lat) * cos(0.3);
+					north[1] = -sin(lat) * sin(0.3);
+					north[2] = cos(lat);
+					el = elevations[k] * PI / 180.0;
+					range = heights[j] / sin(el);
+					p[0] = p[3] + range * (cos(el) * (east[0] + north[0]) / sqrt(2.0) + sin(el) * up[0]);
+					p[1] = p[4] + range * (cos(el) * (east[1] + north[1]) / sqrt(2.0) + sin(el) * up[1]);
+					p[2] = p[5] + range * (cos(el) * (east[2] + north[2]) / sqrt(2.0) + sin(el) * up[2]);
+
+					refractPointJacobian(&models[m], p[0], p[1], p[2], p[3], p[4], p[5], &d, &e, &f, jSat, jSta);
+					refractPointModel(&models[m], p[0], p[1], p[2], p[3], p[4], p[5], &d0, &e0, &f0, NULL);
+					differ += d != d0 || e != e0 || f != f0;
+					err = fmax(err, differenceError(&models[m], p, jSat, jSta));
+				}
+			}
+		}
+
+		printf("%s: max difference from central differences %.3e, %zu values differ from refractPointModel\n",
+			names[m], err, differ);
+		if (!(err <= TOLERANCE) || differ > 0)
+		{
+			fprintf(stderr, "%s: Jacobian check failed\n", names[m]);
+			failed = 1;
+		}
+	}
+
+	/* Cost of a WGS84 Jacobian against one evaluation */
+	t0 = seconds();
+	for (i = 0; i < TIMED; i++)
+	{
+		refractPointModel(&models[2], p[0] + i, p[1], p[2], p[3], p[4], p[5], &d, &e, &f, NULL);
+	}
+	tModel = seconds() - t0;
+	t0 = seconds();
+	for (i = 0; i < TIMED; i++)
+	{
+		refractPointJacobian(&models[2], p[0] + i, p[1], p[2], p[3], p[4], p[5], &d, &e, &f, jSat, jSta);
+	}
+	tJacobian = seconds() - t0;
+	printf("WGS84 Jacobian: %.1f evaluations of refractPointModel\n", tJacobian / tModel);
+	if (!(tJacobian < 4.0 * tModel))
+	{
+		fprintf(stderr, "WGS84 Jacobian too slow\n");
+		failed = 1;
+	}
+
+	return failed;
+}
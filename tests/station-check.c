@@ -0,0 +1,120 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "refraction.h"
+#include "raytrace.h"
+#include "station.h"
+
+/*
+------------------------------------------------------
+station-check.c
+
+Refract a pass from horizon to horizon through a registered station and check:
+- refractStationBatch agrees with refractPointModel ray tracing the station's
+  profile on every sample, within 1 cm;
+- a weather update moves the refracted positions, by more than 1 cm for a
+  change of 20 K and 50 hPa, and refractStationBatch follows it;
+- the batch, a table lookup per sample, is faster than ray tracing.
+------------------------------------------------------
+*/
+
+#define SAMPLES 2000
+
+static double seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Largest distance between the points of two sets of columns */
+static double maxDistance(size_t n, const double *d, const double *e, const double *f,
+	const double *p, const double *q, const double *r)
+{
+	double dist, m = 0.0;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		dist = sqrt((d[i] - p[i]) * (d[i] - p[i]) + (e[i] - q[i]) * (e[i] - q[i]) + (f[i] - r[i]) * (f[i] - r[i]));
+		m = dist > m || isnan(dist) ? dist : m;
+	}
+	return m;
+}
+
+int main(void)
+{
+	static double x[SAMPLES], y[SAMPLES], z[SAMPLES], d[SAMPLES], e[SAMPLES], f[SAMPLES],
+		p[SAMPLES], q[SAMPLES], r[SAMPLES];
+	struct stationWeather cold = { 263.15, 103000.0, 0.2 }, warm = { 283.15, 98000.0, 0.8 };
+	struct stationRegistry *reg = stationRegistryCreate();
+	struct refractStation st;
+	struct refractModel exact;
+	double orbit = EARTHRAD + 600e3, u, t0, tTable, tRay, table, moved, follows;
+	int id, i, failed;
+
+	if (reg == NULL)
+	{
+		return 2;
+	}
+	id = stationAdd(reg, "test", 0.0, 0.0, 250.0, &cold);
+	if (id < 0)
+	{
+		fprintf(stderr, "stationAdd failed\n");
+		return 1;
+	}
+
+	/* A pass 0.05 rad of arc from the zenith, down to below 1 degree of elevation at both ends */
+	for (i = 0; i < SAMPLES; i++)
+	{
+		u = (2.0 * i / (SAMPLES - 1) - 1.0) * 0.29;
+		x[i] = orbit * cos(u) * cos(0.05);
+		y[i] = orbit * sin(u);
+		z[i] = orbit * cos(u) * sin(0.05);
+	}
+
+	t0 = seconds();
+	refractStationBatch(reg, id, SAMPLES, x, y, z, d, e, f);
+	tTable = seconds() - t0;
+
+	stationGet(reg, id, &st);
+	exact = (struct refractModel){ .atmos = ATMOS_RAYTRACE, .stationHeight = st.height, .profile = st.profile,
+		.table = NULL, .earth = EARTH_SPHERE };
+	t0 = seconds();
+	for (i = 0; i < SAMPLES; i++)
+	{
+		refractPointModel(&exact, x[i], y[i], z[i], st.a, st.b, st.c, &p[i], &q[i], &r[i], NULL);
+	}
+	tRay = seconds() - t0;
+	table = maxDistance(SAMPLES, d, e, f, p, q, r);
+
+	/* The same pass after a change of weather */
+	if (stationUpdateWeather(reg, id, &warm) != 0)
+	{
+		fprintf(stderr, "stationUpdateWeather failed\n");
+		return 1;
+	}
+	refractStationBatch(reg, id, SAMPLES, x, y, z, p, q, r);
+	moved = maxDistance(SAMPLES, d, e, f, p, q, r);
+	stationGet(reg, id, &st);
+	exact.profile = st.profile;
+	for (i = 0; i < SAMPLES; i++)
+	{
+		refractPointModel(&exact, x[i], y[i], z[i], st.a, st.b, st.c, &d[i], &e[i], &f[i], NULL);
+	}
+	follows = maxDistance(SAMPLES, d, e, f, p, q, r);
+
+	printf("table against ray tracing: max %.3e m (%.3e m after the update), %.0f ns against %.0f ns per sample\n",
+		table, follows, tTable * 1e9 / SAMPLES, tRay * 1e9 / SAMPLES);
+	printf("weather update moves the positions by up to %.3e m\n", moved);
+
+	failed = !(table <= 0.01) || !(follows <= 0.01) || !(moved > 0.01) || !(tTable < tRay);
+	if (failed)
+	{
+		fprintf(stderr, "station check failed\n");
+	}
+	stationRegistryFree(reg);
+	return failed;
+}
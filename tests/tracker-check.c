@@ -0,0 +1,74 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "refraction.h"
+#include "tracker.h"
+
+/*
+------------------------------------------------------
+tracker-check.c
+
+Replay circular passes over a station through refractTrackerPoint and check
+every sample against refractPoint: the position error must stay within the
+maxDrift given to refractTrackerInit. The passes run from horizon to horizon
+at several altitudes and offsets from the station, including overhead passes,
+for maxDrift from 0.1 m down to 1 mm.
+
+USAGE:			tracker-check [sample rate in Hz (default 10)]
+------------------------------------------------------
+*/
+
+#define GM 3.986004418e14       // Gravitational parameter of the Earth, in m^3/s^2
+
+int main(int argc, char **argv)
+{
+	static const double drifts[] = { 0.1, 0.01, 0.001 };
+	static const double altitudes[] = { 400e3, 1200e3, 20200e3 };
+	static const double offsets[] = { 0.0, 0.02, 0.1, 0.3 };
+	double hz = argc > 1 ? strtod(argv[1], NULL) : 10.0;
+	double r, step, u, beta, x, y, z, d, e, f, p, q, s, err, maxErr;
+	unsigned long samples, predicted;
+	struct refractTracker t;
+	size_t i, j, k;
+	int failed = 0;
+
+	for (i = 0; i < sizeof(drifts) / sizeof(drifts[0]); i++)
+	{
+		maxErr = 0.0;
+		samples = 0;
+		predicted = 0;
+		for (j = 0; j < sizeof(altitudes) / sizeof(altitudes[0]); j++)
+		{
+			r = EARTHRAD + altitudes[j];
+			step = sqrt(GM / (r * r * r)) / hz;
+			for (k = 0; k < sizeof(offsets) / sizeof(offsets[0]); k++)
+			{
+				/* Station on the x axis; the orbit passes beta radians from its zenith */
+				beta = offsets[k];
+				refractTrackerInit(&t, NULL, drifts[i], 0);
+				for (u = -PI / 2; u < PI / 2; u += step)
+				{
+					x = r * cos(u) * cos(beta);
+					y = r * sin(u);
+					z = r * cos(u) * sin(beta);
+					if (x <= EARTHRAD)
+					{
+						continue;
+					}
+					predicted += refractTrackerPoint(&t, x, y, z, EARTHRAD, 0.0, 0.0, &d, &e, &f, NULL) == 0;
+					refractPoint(x, y, z, EARTHRAD, 0.0, 0.0, &p, &q, &s, NULL);
+					err = sqrt((d - p) * (d - p) + (e - q) * (e - q) + (f - s) * (f - s));
+					maxErr = err > maxErr ? err : maxErr;
+					samples++;
+				}
+			}
+		}
+		printf("maxDrift %g m: %lu samples, %lu predicted, max error %.3e m\n", drifts[i], samples, predicted, maxErr);
+		if (!(maxErr <= drifts[i]) || predicted == 0)
+		{
+			fprintf(stderr, "maxDrift %g m not met\n", drifts[i]);
+			failed = 1;
+		}
+	}
+	return failed;
+}
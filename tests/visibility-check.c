@@ -0,0 +1,121 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "refraction.h"
+#include "visibility.h"
+
+/*
+------------------------------------------------------
+visibility-check.c
+
+Check visQuery and visQueryBatch against a brute force scan of every station
+with zenithAngle, as refractPoint computes z_0: stations spread over the Earth
+from sea level to 5000 m, spacecraft from 300 km to geostationary altitude,
+zenith angle limits from 30 degrees to the horizon. Stations whose z_0 is
+within rounding of the limit may go either way and are not counted.
+------------------------------------------------------
+*/
+
+#define STATIONS 5000
+#define SATS 200
+#define MARGIN 1e-12            // z_0 this close to zMax, in radians, is not held against either side
+
+/* Uniform on [0,1), from a fixed sequence so that a failure can be reproduced */
+static double uniform(unsigned long long *state)
+{
+	*state = *state * 6364136223846793005ull + 1442695040888963407ull;
+	return (double)(*state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Random point at radius r, uniform over the sphere */
+static void randomPoint(unsigned long long *state, double r, double *x, double *y, double *z)
+{
+	double lat = asin(2.0 * uniform(state) - 1.0), lon = 2.0 * PI * uniform(state);
+
+	*x = r * cos(lat) * cos(lon);
+	*y = r * cos(lat) * sin(lon);
+	*z = r * sin(lat);
+}
+
+int main(void)
+{
+	static const double limits[] = { 30.0, 70.0, 85.0, 90.0 };
+	static double a[STATIONS], b[STATIONS], c[STATIONS], x[SATS], y[SATS], z[SATS];
+	static int found[STATIONS], seen[STATIONS];
+	struct visIndex *ix;
+	struct visPair *pairs;
+	double zMax, z_0, dist;
+	unsigned long long state = 20261016;
+	size_t i, j, l, n, total, nPairs, visible, missed, extra, wrong;
+	int failed = 0;
+
+	for (j = 0; j < STATIONS; j++)
+	{
+		randomPoint(&state, EARTHRAD + 5000.0 * uniform(&state), &a[j], &b[j], &c[j]);
+	}
+	for (i = 0; i < SATS; i++)
+	{
+		randomPoint(&state, EARTHRAD + 300e3 + 35.5e6 * uniform(&state), &x[i], &y[i], &z[i]);
+	}
+	ix = visIndexBuild(STATIONS, a, b, c);
+	pairs = malloc(STATIONS * SATS * sizeof(*pairs));
+	if (ix == NULL || pairs == NULL)
+	{
+		fprintf(stderr, "no memory\n");
+		return 2;
+	}
+
+	for (l = 0; l < sizeof(limits) / sizeof(limits[0]); l++)
+	{
+		zMax = limits[l] * PI / 180.0;
+		visible = missed = extra = wrong = total = 0;
+		nPairs = visQueryBatch(ix, SATS, x, y, z, zMax, pairs, STATIONS * SATS);
+		for (i = 0; i < SATS; i++)
+		{
+			n = visQuery(ix, x[i], y[i], z[i], zMax, found, STATIONS);
+			for (j = 0; j < STATIONS; j++)
+			{
+				seen[j] = 0;
+			}
+			for (j = 0; j < n; j++)
+			{
+				seen[found[j]]++;
+			}
+
+			/* Every station the brute force sees, and only those, once */
+			for (j = 0; j < STATIONS; j++)
+			{
+				z_0 = zenithAngle(x[i], y[i], z[i], a[j], b[j], c[j], &dist) + dist / EARTHRAD;
+				if (fabs(z_0 - zMax) <= MARGIN)
+				{
+					continue;
+				}
+				visible += z_0 < zMax;
+				missed += z_0 < zMax && seen[j] == 0;
+				extra += seen[j] > (z_0 < zMax);
+			}
+
+			/* The pairs of this spacecraft are the stations of visQuery, with their z_0 */
+			for (j = 0; j < n && total + j < nPairs; j++)
+			{
+				z_0 = zenithAngle(x[i], y[i], z[i], a[pairs[total + j].station], b[pairs[total + j].station],
+					c[pairs[total + j].station], &dist) + dist / EARTHRAD;
+				wrong += pairs[total + j].sat != i || seen[pairs[total + j].station] != 1
+					|| !(fabs(pairs[total + j].z_0 - z_0) <= MARGIN);
+			}
+			total += n;
+		}
+
+		printf("zMax %g degrees: %zu visible pairs, %zu missed, %zu extra; visQueryBatch %zu pairs, %zu wrong\n",
+			limits[l], visible, missed, extra, nPairs, wrong);
+		if (missed > 0 || extra > 0 || nPairs != total || wrong > 0 || visible == 0)
+		{
+			fprintf(stderr, "zMax %g degrees: visibility check failed\n", limits[l]);
+			failed = 1;
+		}
+	}
+
+	free(pairs);
+	visIndexFree(ix);
+	return failed;
+}
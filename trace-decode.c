@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+/*
+------------------------------------------------------
+trace-decode.c
+
+Print the records of a trace ring dump (see traceRingDump) one per line.
+
+USAGE:			trace-decode [-x] dump-file
+			-x prints hex floats (%a) instead of %.16lf
+------------------------------------------------------
+*/
+
+int main(int argc, char **argv)
+{
+	struct traceRingHeader hdr;
+	struct traceRecord rec;
+	const char *path = NULL, *fmt;
+	FILE *fp;
+	uint64_t i;
+	int hex = 0;
+
+	for (int k = 1; k < argc; k++)
+	{
+		if (strcmp(argv[k], "-x") == 0)
+		{
+			hex = 1;
+		}
+		else
+		{
+			path = argv[k];
+		}
+	}
+	if (path == NULL)
+	{
+		fprintf(stderr, "usage: %s [-x] dump-file\n", argv[0]);
+		return 2;
+	}
+
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+	{
+		perror(path);
+		return 1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != TRACE_RING_MAGIC)
+	{
+		fprintf(stderr, "%s: not a trace ring dump\n", path);
+		fclose(fp);
+		return 1;
+	}
+	if (hdr.version != TRACE_RING_VERSION || hdr.recordSize != sizeof(rec))
+	{
+		fprintf(stderr, "%s: unsupported version %u or record size %u\n", path, hdr.version, hdr.recordSize);
+		fclose(fp);
+		return 1;
+	}
+
+	printf("# %llu records, %llu dropped\n# seq zenAng theta z_0 zed dAng\n",
+		(unsigned long long)hdr.count, (unsigned long long)hdr.dropped);
+	fmt = hex ? "%llu %a %a %a %a %a\n" : "%llu %.16lf %.16lf %.16lf %.16lf %.16lf\n";
+	for (i = 0; i < hdr.count && fread(&rec, sizeof(rec), 1, fp) == 1; i++)
+	{
+		printf(fmt, (unsigned long long)rec.seq, rec.zenAng, rec.theta, rec.z_0, rec.zed, rec.dAng);
+	}
+
+	fclose(fp);
+	return 0;
+}
@@ -0,0 +1,124 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "trace.h"
+
+/*
+------------------------------------------------------
+trace.c
+
+Binary ring buffer of deltaAngle intermediates. Writers claim a sequence number
+with a single atomic increment and fill the slot it maps to; the sequence number
+is published last, so a dump can tell a complete slot from one being overwritten.
+Recording costs a handful of stores and no formatting.
+------------------------------------------------------
+*/
+
+struct ringSlot
+{
+	_Atomic uint64_t seq;           // Sequence number + 1 once the slot is complete, 0 while empty or being written
+	double zenAng, theta, z_0, zed, dAng;
+};
+
+static struct ringSlot ring[TRACE_RING_RECORDS];
+static _Atomic uint64_t ringNext;
+
+/*
+------------------------------------------------------
+traceRingRecord
+
+PURPOSE:		Append the intermediates of one deltaAngle call to the trace ring
+INPUT ARGUMENTS:	zenAng, theta, z_0, zed, dAng
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	None
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Safe to call from several threads; the oldest records are overwritten
+------------------------------------------------------
+*/
+
+void traceRingRecord(double zenAng, double theta, double z_0, double zed, double dAng)
+{
+	uint64_t seq;
+	struct ringSlot *slot;
+
+	seq = atomic_fetch_add_explicit(&ringNext, 1, memory_order_relaxed);
+	slot = &ring[seq & (TRACE_RING_RECORDS - 1)];
+
+	atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	slot->zenAng = zenAng;
+	slot->theta = theta;
+	slot->z_0 = z_0;
+	slot->zed = zed;
+	slot->dAng = dAng;
+	atomic_store_explicit(&slot->seq, seq + 1, memory_order_release);
+
+	return;
+}
+
+/*
+------------------------------------------------------
+traceRingDump
+
+PURPOSE:		Write the records currently held in the trace ring to a file
+INPUT ARGUMENTS:	path of the output file
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		0 on success, -1 if the file could not be written
+FUNCTIONS CALLED:	fopen, fwrite
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Slots being written during the dump are skipped.
+			Format: struct traceRingHeader, then header.count struct traceRecord.
+------------------------------------------------------
+*/
+
+int traceRingDump(const char *path)
+{
+	struct traceRingHeader hdr = { 0 };
+	struct traceRecord rec;
+	struct ringSlot *slot;
+	uint64_t end, first, seq, stamp;
+	FILE *fp;
+
+	fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		return -1;
+	}
+
+	end = atomic_load(&ringNext);
+	first = end > TRACE_RING_RECORDS ? end - TRACE_RING_RECORDS : 0;
+
+	hdr.magic = TRACE_RING_MAGIC;
+	hdr.version = TRACE_RING_VERSION;
+	hdr.recordSize = sizeof(struct traceRecord);
+	hdr.dropped = first;
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+
+	for (seq = first; seq < end; seq++)
+	{
+		slot = &ring[seq & (TRACE_RING_RECORDS - 1)];
+		stamp = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		rec.seq = seq;
+		rec.zenAng = slot->zenAng;
+		rec.theta = slot->theta;
+		rec.z_0 = slot->z_0;
+		rec.zed = slot->zed;
+		rec.dAng = slot->dAng;
+		atomic_thread_fence(memory_order_acquire);
+		if (stamp != seq + 1 || atomic_load_explicit(&slot->seq, memory_order_relaxed) != stamp)
+		{
+			continue;
+		}
+		fwrite(&rec, sizeof(rec), 1, fp);
+		hdr.count++;
+	}
+
+	/* Rewrite the header with the number of records actually written */
+	fseek(fp, 0, SEEK_SET);
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+
+	return fclose(fp) == 0 ? 0 : -1;
+}
@@ -0,0 +1,83 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+Trace levels, selected at compile time with -DREFRACTION_TRACE=<level>
+
+TRACE_LEVEL_OFF		no output; no formatting code is compiled in
+TRACE_LEVEL_SUMMARY	inputs and outputs of each test case in main
+TRACE_LEVEL_FULL	additionally every intermediate of zenithAngle and deltaAngle (default,
+			matching the original testing version)
+
+Trace lines go to stderr, so that results written to stdout (refraction -o csv -)
+are not mixed with them.
+
+Independently, -DREFRACTION_TRACE_RING records the intermediates of deltaAngle
+as binary records in a ring buffer, which traceRingDump writes to a file for
+offline decoding with trace-decode.
+*/
+#define TRACE_LEVEL_OFF 0
+#define TRACE_LEVEL_SUMMARY 1
+#define TRACE_LEVEL_FULL 2
+
+#ifndef REFRACTION_TRACE
+#define REFRACTION_TRACE TRACE_LEVEL_FULL
+#endif
+
+#if REFRACTION_TRACE >= TRACE_LEVEL_SUMMARY
+#define TRACE_SUMMARY_PRINT(...) fprintf(stderr, __VA_ARGS__)
+#else
+#define TRACE_SUMMARY_PRINT(...) ((void)0)
+#endif
+
+#if REFRACTION_TRACE >= TRACE_LEVEL_FULL
+#define TRACE_FULL_PRINT(...) fprintf(stderr, __VA_ARGS__)
+#else
+#define TRACE_FULL_PRINT(...) ((void)0)
+#endif
+
+/*
+Binary ring buffer trace
+*/
+#define TRACE_RING_MAGIC 0x43525452u    // "RTRC" read as little-endian bytes
+#define TRACE_RING_VERSION 1u
+
+#ifndef TRACE_RING_RECORDS
+#define TRACE_RING_RECORDS 65536        // Must be a power of two
+#endif
+
+/* File header, followed by count records in sequence order */
+struct traceRingHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t recordSize;
+	uint32_t reserved;
+	uint64_t count;
+	uint64_t dropped;               // Records overwritten before the dump
+};
+
+/* One call of deltaAngle */
+struct traceRecord
+{
+	uint64_t seq;
+	double zenAng, theta, z_0, zed, dAng;
+};
+
+#ifdef REFRACTION_TRACE_RING
+#define TRACE_RECORD(zenAng, theta, z_0, zed, dAng) traceRingRecord(zenAng, theta, z_0, zed, dAng)
+#else
+#define TRACE_RECORD(zenAng, theta, z_0, zed, dAng) ((void)0)
+#endif
+
+/*
+Function prototypes
+*/
+void traceRingRecord(double zenAng, double theta, double z_0, double zed, double dAng);
+
+int traceRingDump(const char *path);
+
+#endif
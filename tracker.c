@@ -0,0 +1,279 @@
+#include <math.h>
+#include "refraction.h"
+#include "tracker.h"
+
+/*
+------------------------------------------------------
+tracker.c
+
+Along a pass sampled at high rate, the geometry of consecutive samples differs
+very little. refractTrackerPoint still computes the spacecraft projection and the
+projection-to-station distance of every sample exactly (2 sqrt), but replaces
+the atan of the zenith angle and the sin and asin of the angular displacement by
+second order Taylor expansions about the last exactly evaluated sample:
+
+	zenAng = atan(q),  q = distGS2satProj / (alt_sat - EARTHRAD)
+	dAng   = z_0 - asin(k sin z_0),  k = EARTHRAD / (EARTHRAD + station height)
+
+The expansion of f is used while |x - x0| <= span, with span chosen so that
+M span^3 / 6 stays below its share of tol / TRACKER_SAFETY, M being the largest
+|f'''| found at x0 and at TRACKER_PROBES points on each side across the span
+(span^3 is kept, so no cube root is taken on the per-sample path). The span is
+at most TRACKER_SPAN_MAX, also where f''' vanishes (q = 1/sqrt(3), z_0 = 90 deg).
+Outside the span, every resyncEvery samples, and on the first sample, the sample
+is evaluated exactly (as refractPoint) and the expansions are rebuilt there.
+
+The errors of the two expansions add: an error e of zenAng moves z_0 by e, and
+dAng by at most 2e (|g'| <= 1 + k |cos z| / sqrt(w) <= 2). dAng gets half of tol
+and zenAng a quarter, so the displacement stays within EARTHRAD tol = maxDrift.
+At each exact evaluation that follows predicted samples, the old expansions
+are extrapolated to the new sample and the error of the displacement they give
+is kept in maxDrift. The remainder grows with the distance from x0, so this
+errs high for the predicted samples themselves.
+
+A resync costs the exact evaluation plus a cos, a sqrt, two cube roots and the
+third derivatives at the probe points (a sin and cos each for dAng), so
+the tracker gains only when the tolerance lets several samples fall within the
+spans; for tolerances finer than the change between samples it is slower than
+refractPoint.
+
+With the derivatives of g(z) = asin(k sin z), w = 1 - k^2 sin^2 z:
+	g'   = k cos z / sqrt(w)
+	g''  = (k^2 - 1) k sin z / w^(3/2)
+	g''' = (k^2 - 1) k cos z (1 + 2 k^2 sin^2 z) / w^(5/2)
+and of atan(q):
+	1 / (1 + q^2),  -2q / (1 + q^2)^2,  (6q^2 - 2) / (1 + q^2)^3
+------------------------------------------------------
+*/
+
+#define TRACKER_SAFETY 2.0      // Margin on the remainder for |f'''| between the probe points
+#define TRACKER_PROBES 2        // Points on each side of x0 at which |f'''| is sampled across the span
+#define TRACKER_SPAN_MAX 0.05   // Longest span, in units of q and radians of z_0
+
+/* Third derivative of atan(q) */
+static double zenThird(double q, double k)
+{
+	double q2 = 1.0 + q * q;
+
+	(void)k;
+	return (6.0 * q * q - 2.0) / (q2 * q2 * q2);
+}
+
+/* Third derivative of z - asin(k sin z) */
+static double angThird(double z, double k)
+{
+	double sz = sin(z), cz = cos(z), w = 1.0 - k * k * sz * sz;
+
+	return (k * k - 1.0) * k * cz * (1.0 + 2.0 * k * k * sz * sz) / (w * w * sqrt(w));
+}
+
+/*
+Cube of the span about x0 within which the second order remainder of f stays within tol.
+The largest |f'''| at the probe points of a span sizes the next one, until the span
+no longer shrinks.
+*/
+static double expansionSpan3(double (*third)(double, double), double x0, double k, double tol)
+{
+	double m = fabs(third(x0, k)), span, span3 = HUGE_VAL, prev;
+	int i, j;
+
+	for (i = 0; i < 8; i++)
+	{
+		prev = span3;
+		span3 = TRACKER_SPAN_MAX * TRACKER_SPAN_MAX * TRACKER_SPAN_MAX;
+		if (6.0 * tol < TRACKER_SAFETY * m * span3)
+		{
+			span3 = 6.0 * tol / (TRACKER_SAFETY * m);
+		}
+		if (span3 >= prev)
+		{
+			return prev;
+		}
+		span = cbrt(span3);
+		for (j = 1; j <= TRACKER_PROBES; j++)
+		{
+			m = fmax(m, fabs(third(x0 - span * j / TRACKER_PROBES, k)));
+			m = fmax(m, fabs(third(x0 + span * j / TRACKER_PROBES, k)));
+		}
+	}
+	return fmin(span3, 6.0 * tol / (TRACKER_SAFETY * m));
+}
+
+static int inSpan(const struct trackerExpansion *ex, double x)
+{
+	double h = fabs(x - ex->x0);
+
+	return h * h * h <= ex->span3;
+}
+
+static double expansionValue(const struct trackerExpansion *ex, double x)
+{
+	double h = x - ex->x0;
+
+	return ex->f0 + h * (ex->f1 + 0.5 * h * ex->f2);
+}
+
+/*
+------------------------------------------------------
+refractTrackerInit
+
+PURPOSE:		Prepare a tracker for one (spacecraft, ground station) pair
+INPUT ARGUMENTS:	model (NULL for the refracting shell of deltaAngle), maxDrift
+			(allowed error of the displacement, in metres), resyncEvery
+			(0 for TRACKER_RESYNC)
+OUTPUT ARGUMENTS:	*t
+RETURNED VALUE:		None
+FUNCTIONS CALLED:	refractTrackerReset
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			maxDrift bounds the error of dAng to maxDrift / EARTHRAD radians, shared
+			between the expansions of zenAng and dAng.
+			Models other than the refracting shell on the sphere are evaluated exactly on every sample.
+------------------------------------------------------
+*/
+
+void refractTrackerInit(struct refractTracker *t, const struct refractModel *model, double maxDrift, int resyncEvery)
+{
+	t->model = model;
+	t->tol = maxDrift / EARTHRAD;
+	t->resyncEvery = resyncEvery > 0 ? resyncEvery : TRACKER_RESYNC;
+	t->samples = 0;
+	t->resyncs = 0;
+	t->maxDrift = 0.0;
+	refractTrackerReset(t);
+}
+
+/* Forget the expansions, e.g. at a gap in the samples; the next sample is evaluated exactly */
+void refractTrackerReset(struct refractTracker *t)
+{
+	t->valid = 0;
+	t->sinceSync = 0;
+}
+
+/*
+------------------------------------------------------
+refractTrackerPoint
+
+PURPOSE:		Refract the next sample of the pass
+INPUT ARGUMENTS:	t, spacecraft coordinates (x,y,z) and unrefracted ground station coordinates (a,b,c)
+OUTPUT ARGUMENTS:	Refracted ground station coordinates (*d,*e,*f);
+			every intermediate in *res if res is not NULL
+RETURNED VALUE:		1 if the sample was evaluated exactly, 0 if it was predicted
+FUNCTIONS CALLED:	asin, atan, cos, expansionSpan3, refractPointModel, sin, sqrt
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Exactly evaluated samples are bit-identical to refractPoint
+------------------------------------------------------
+*/
+
+int refractTrackerPoint(struct refractTracker *t, double x, double y, double z, double a, double b, double c,
+	double *d, double *e, double *f, struct refractResult *res)
+{
+	double alt_sat, s, satProj_x, satProj_y, satProj_z, dx, dy, dz, distGS2satProj, q, zenAng, theta,
+		z_0, zed, dAng, linearDisplacement, height, k, sz, cz, w, q2, drift;
+	int exact;
+
+	t->samples++;
+	if (t->model != NULL && (t->model->atmos != ATMOS_SHELL || t->model->earth != EARTH_SPHERE))
+	{
+		refractPointModel(t->model, x, y, z, a, b, c, d, e, f, res);
+		return 1;
+	}
+	height = t->model != NULL ? t->model->stationHeight : GS_HEIGHT;
+
+	/* Projection and distance as in refractPointModel */
+	alt_sat = sqrt(x * x + y * y + z * z);
+	s = EARTHRAD / alt_sat;
+	satProj_x = s * x;
+	satProj_y = s * y;
+	satProj_z = s * z;
+	dx = satProj_x - a;
+	dy = satProj_y - b;
+	dz = satProj_z - c;
+	distGS2satProj = sqrt(dx * dx + dy * dy + dz * dz);
+	q = distGS2satProj / (alt_sat - EARTHRAD);
+	theta = distGS2satProj / EARTHRAD;
+
+	exact = !t->valid || t->sinceSync >= t->resyncEvery || !inSpan(&t->zen, q);
+	if (!exact)
+	{
+		zenAng = expansionValue(&t->zen, q);
+		z_0 = zenAng + theta;
+		exact = !inSpan(&t->ang, z_0);
+	}
+
+	if (exact)
+	{
+		zenAng = atan(q);
+		z_0 = zenAng + theta;
+		zed = asin((sin(z_0) * EARTHRAD) / (EARTHRAD + height));
+		dAng = z_0 - zed;
+
+		/* Measure the error of the displacement predicted one sample past the last prediction */
+		k = EARTHRAD / (EARTHRAD + height);
+		if (t->valid && t->sinceSync > 0)
+		{
+			drift = EARTHRAD * fabs(expansionValue(&t->ang, expansionValue(&t->zen, q) + theta) - dAng);
+			t->maxDrift = drift > t->maxDrift ? drift : t->maxDrift;
+		}
+
+		/* Rebuild both expansions at this sample: a quarter of tol for zenAng, half for dAng */
+		q2 = 1.0 + q * q;
+		t->zen.x0 = q;
+		t->zen.f0 = zenAng;
+		t->zen.f1 = 1.0 / q2;
+		t->zen.f2 = -2.0 * q / (q2 * q2);
+		t->zen.span3 = expansionSpan3(zenThird, q, k, 0.25 * t->tol);
+
+		sz = sin(z_0);
+		cz = cos(z_0);
+		w = 1.0 - k * k * sz * sz;
+		t->ang.x0 = z_0;
+		t->ang.f0 = dAng;
+		t->ang.f1 = 1.0 - k * cz / sqrt(w);
+		t->ang.f2 = -(k * k - 1.0) * k * sz / (w * sqrt(w));
+		t->ang.span3 = expansionSpan3(angThird, z_0, k, 0.5 * t->tol);
+
+		t->valid = 1;
+		t->sinceSync = 0;
+		t->resyncs++;
+	}
+	else
+	{
+		dAng = expansionValue(&t->ang, z_0);
+		zed = z_0 - dAng;
+		t->sinceSync++;
+	}
+
+	/* Translate the ground station towards the projection by the arc length of dAng */
+	linearDisplacement = EARTHRAD * dAng;
+	if (linearDisplacement == 0.0)
+	{
+		*d = a;
+		*e = b;
+		*f = c;
+	}
+	else
+	{
+		*d = a + (linearDisplacement / distGS2satProj) * dx;
+		*e = b + (linearDisplacement / distGS2satProj) * dy;
+		*f = c + (linearDisplacement / distGS2satProj) * dz;
+	}
+
+	if (res != NULL)
+	{
+		res->satProj_x = satProj_x;
+		res->satProj_y = satProj_y;
+		res->satProj_z = satProj_z;
+		res->alt_sat = alt_sat;
+		res->distGS2satProj = distGS2satProj;
+		res->zenAng = zenAng;
+		res->theta = theta;
+		res->z_0 = z_0;
+		res->zed = zed;
+		res->dAng = dAng;
+		res->linearDisplacement = linearDisplacement;
+	}
+
+	return exact;
+}
@@ -0,0 +1,46 @@
+#ifndef TRACKER_H
+#define TRACKER_H
+
+/*
+Incremental refraction for one (spacecraft, ground station) pair sampled along a pass
+*/
+#define TRACKER_RESYNC 100      // Default longest run of predicted samples between exact evaluations
+
+struct refractModel;
+struct refractResult;
+
+/* Second order expansion of f about x0, valid for |x - x0|^3 <= span3 */
+struct trackerExpansion
+{
+	double x0, f0, f1, f2;          // Expansion point, value, first and second derivative
+	double span3;
+};
+
+struct refractTracker
+{
+	const struct refractModel *model;       // NULL for the refracting shell of deltaAngle
+	double tol;                             // Allowed error of dAng, in radians (maxDrift / EARTHRAD)
+	int resyncEvery;
+
+	int valid;                              // The expansions below are set
+	int sinceSync;                          // Samples predicted since the last exact evaluation
+	struct trackerExpansion zen;            // zenAng = atan(q), q = distGS2satProj / spacecraft height
+	struct trackerExpansion ang;            // dAng as a function of z_0
+
+	unsigned long samples;
+	unsigned long resyncs;
+	double maxDrift;                        // Largest error of the displacement of the expansions extrapolated
+	                                        // to the exact sample after a predicted run, in metres
+};
+
+/*
+Function prototypes
+*/
+void refractTrackerInit(struct refractTracker *t, const struct refractModel *model, double maxDrift, int resyncEvery);
+
+void refractTrackerReset(struct refractTracker *t);
+
+int refractTrackerPoint(struct refractTracker *t, double x, double y, double z, double a, double b, double c,
+	double *d, double *e, double *f, struct refractResult *res);
+
+#endif
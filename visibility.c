@@ -0,0 +1,425 @@
+#include <math.h>
+#include <stdlib.h>
+#include "refraction.h"
+#include "visibility.h"
+
+/*
+------------------------------------------------------
+visibility.c
+
+The zenith angle of the spacecraft at a station, as in refractPoint, is
+
+	z_0 = atan(dist / H) + dist / EARTHRAD
+
+with dist the distance from the spacecraft projection P (on the sphere of
+radius EARTHRAD) to the station S, and H = alt_sat - EARTHRAD. z_0 grows with
+dist, so z_0 < zMax exactly when dist < D, with D the root of
+atan(D / H) + D / EARTHRAD = zMax (visMaxDistance).
+
+For a station at radius r >= rMin and an angle psi between the directions u of
+P and v of S,
+
+	dist^2 = (EARTHRAD - r)^2 + 4 EARTHRAD r sin^2(psi / 2) >= EARTHRAD rMin |u - v|^2
+
+so every visible station has |u - v| < D / sqrt(EARTHRAD rMin): a ball query on
+the unit vectors. The k-d tree answers it by pruning nodes whose bounding box
+is farther than that, and the stations it returns are then tested exactly on z_0.
+------------------------------------------------------
+*/
+
+#define VIS_DEPTH 64            // Bound on the depth of the tree (it is balanced)
+
+struct visNode
+{
+	double lo[3], hi[3];            // Bounding box of the unit vectors below the node
+	int begin, end;                 // Stations [begin, end) of the reordered arrays
+	int left, right;                // Children, or -1 for a leaf
+};
+
+struct visIndex
+{
+	int n, nNodes;
+	double rMin;                    // Smallest station radius
+	double *u[3];                   // Unit vectors, in tree order
+	double *pos[3];                 // Station coordinates, in tree order
+	int *id;                        // Index given to visIndexBuild, in tree order
+	struct visNode *nodes;
+};
+
+static void swapStations(struct visIndex *ix, int i, int j)
+{
+	double t;
+	int k, s;
+
+	for (k = 0; k < 3; k++)
+	{
+		t = ix->u[k][i];
+		ix->u[k][i] = ix->u[k][j];
+		ix->u[k][j] = t;
+		t = ix->pos[k][i];
+		ix->pos[k][i] = ix->pos[k][j];
+		ix->pos[k][j] = t;
+	}
+	s = ix->id[i];
+	ix->id[i] = ix->id[j];
+	ix->id[j] = s;
+}
+
+/* Partially order [lo, hi) along axis so that element mid is in sorted position (quickselect) */
+static void selectMedian(struct visIndex *ix, int lo, int hi, int mid, int axis)
+{
+	const double *v = ix->u[axis];
+	double pivot;
+	int i, j;
+
+	while (hi - lo > 1)
+	{
+		pivot = v[lo + (hi - lo) / 2];
+		i = lo;
+		j = hi - 1;
+		while (i <= j)
+		{
+			while (v[i] < pivot)
+			{
+				i++;
+			}
+			while (v[j] > pivot)
+			{
+				j--;
+			}
+			if (i <= j)
+			{
+				swapStations(ix, i++, j--);
+			}
+		}
+		if (mid <= j)
+		{
+			hi = j + 1;
+		}
+		else if (mid >= i)
+		{
+			lo = i;
+		}
+		else
+		{
+			return;
+		}
+	}
+}
+
+/* Build the subtree over stations [begin, end); returns its node index */
+static int buildNode(struct visIndex *ix, int begin, int end)
+{
+	struct visNode *node;
+	int self = ix->nNodes++, i, k, axis = 0, mid;
+
+	node = &ix->nodes[self];
+	node->begin = begin;
+	node->end = end;
+	for (k = 0; k < 3; k++)
+	{
+		node->lo[k] = HUGE_VAL;
+		node->hi[k] = -HUGE_VAL;
+		for (i = begin; i < end; i++)
+		{
+			node->lo[k] = ix->u[k][i] < node->lo[k] ? ix->u[k][i] : node->lo[k];
+			node->hi[k] = ix->u[k][i] > node->hi[k] ? ix->u[k][i] : node->hi[k];
+		}
+		if (node->hi[k] - node->lo[k] > node->hi[axis] - node->lo[axis])
+		{
+			axis = k;
+		}
+	}
+
+	if (end - begin <= VIS_LEAF)
+	{
+		node->left = node->right = -1;
+		return self;
+	}
+	mid = begin + (end - begin) / 2;
+	selectMedian(ix, begin, end, mid, axis);
+	i = buildNode(ix, begin, mid);
+	ix->nodes[self].left = i;
+	i = buildNode(ix, mid, end);
+	ix->nodes[self].right = i;
+
+	return self;
+}
+
+/*
+------------------------------------------------------
+visIndexBuild
+
+PURPOSE:		Build the visibility index of a set of ground stations
+INPUT ARGUMENTS:	n, station coordinates (a,b,c) as arrays
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		New index, or NULL if n < 1, a station is at Earth centre or memory
+			could not be obtained
+FUNCTIONS CALLED:	buildNode, malloc, sqrt
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Queries return the index of a station in (a,b,c). The index is
+			read-only once built and may be queried from any number of threads.
+------------------------------------------------------
+*/
+
+struct visIndex *visIndexBuild(int n, const double *a, const double *b, const double *c)
+{
+	struct visIndex *ix;
+	double r;
+	int i, k;
+
+	if (n < 1)
+	{
+		return NULL;
+	}
+	ix = calloc(1, sizeof(*ix));
+	if (ix == NULL)
+	{
+		return NULL;
+	}
+	for (k = 0; k < 3; k++)
+	{
+		ix->u[k] = malloc((size_t)n * sizeof(double));
+		ix->pos[k] = malloc((size_t)n * sizeof(double));
+	}
+	ix->id = malloc((size_t)n * sizeof(int));
+	ix->nodes = malloc(2 * (size_t)n * sizeof(struct visNode));
+	if (ix->u[0] == NULL || ix->u[1] == NULL || ix->u[2] == NULL || ix->pos[0] == NULL || ix->pos[1] == NULL
+		|| ix->pos[2] == NULL || ix->id == NULL || ix->nodes == NULL)
+	{
+		visIndexFree(ix);
+		return NULL;
+	}
+
+	ix->n = n;
+	ix->rMin = HUGE_VAL;
+	for (i = 0; i < n; i++)
+	{
+		r = sqrt(a[i] * a[i] + b[i] * b[i] + c[i] * c[i]);
+		if (!(r > 0.0))
+		{
+			visIndexFree(ix);
+			return NULL;
+		}
+		ix->rMin = r < ix->rMin ? r : ix->rMin;
+		ix->pos[0][i] = a[i];
+		ix->pos[1][i] = b[i];
+		ix->pos[2][i] = c[i];
+		ix->u[0][i] = a[i] / r;
+		ix->u[1][i] = b[i] / r;
+		ix->u[2][i] = c[i] / r;
+		ix->id[i] = i;
+	}
+	buildNode(ix, 0, n);
+
+	return ix;
+}
+
+void visIndexFree(struct visIndex *ix)
+{
+	int k;
+
+	if (ix == NULL)
+	{
+		return;
+	}
+	for (k = 0; k < 3; k++)
+	{
+		free(ix->u[k]);
+		free(ix->pos[k]);
+	}
+	free(ix->id);
+	free(ix->nodes);
+	free(ix);
+}
+
+/*
+------------------------------------------------------
+visMaxDistance
+
+PURPOSE:		Largest projection-to-station distance at which z_0 stays below zMax
+INPUT ARGUMENTS:	height_sat (alt_sat - EARTHRAD), zMax in radians
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		Distance in metres; 0 if height_sat <= 0 or zMax <= 0
+FUNCTIONS CALLED:	atan
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Newton's method from D = EARTHRAD zMax, an upper bound. The function
+			is concave, so every later iterate is a lower bound and the iterates
+			increase to the root; the result is rounded up by a relative 1e-12.
+------------------------------------------------------
+*/
+
+double visMaxDistance(double height_sat, double zMax)
+{
+	double D, g, D_prev = -1.0;
+	int iter;
+
+	if (!(height_sat > 0.0) || !(zMax > 0.0))
+	{
+		return 0.0;
+	}
+	D = EARTHRAD * zMax;
+	for (iter = 0; iter < 50 && D != D_prev; iter++)
+	{
+		D_prev = D;
+		g = atan(D / height_sat) + D / EARTHRAD - zMax;
+		D -= g / (height_sat / (height_sat * height_sat + D * D) + 1.0 / EARTHRAD);
+	}
+
+	return D * (1.0 + 1e-12) + 1e-6;
+}
+
+/* Squared distance from q to the node's bounding box */
+static double boxDistance2(const struct visNode *node, const double *q)
+{
+	double s = 0.0, t;
+	int k;
+
+	for (k = 0; k < 3; k++)
+	{
+		t = q[k] < node->lo[k] ? node->lo[k] - q[k] : q[k] > node->hi[k] ? q[k] - node->hi[k] : 0.0;
+		s += t * t;
+	}
+	return s;
+}
+
+/*
+------------------------------------------------------
+queryOne
+
+PURPOSE:		Append the stations that see one spacecraft
+INPUT ARGUMENTS:	ix, sat (index reported in pairs), spacecraft coordinates (x,y,z), zMax,
+			found (entries already written), max (capacity)
+OUTPUT ARGUMENTS:	stations[found..] if stations is not NULL, pairs[found..] if pairs is not NULL,
+			as long as there is room
+RETURNED VALUE:		found plus the number of visible stations
+FUNCTIONS CALLED:	atan, boxDistance2, sqrt, visMaxDistance
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			None
+------------------------------------------------------
+*/
+
+static size_t queryOne(const struct visIndex *ix, size_t sat, double x, double y, double z, double zMax,
+	int *stations, struct visPair *pairs, size_t found, size_t max)
+{
+	const struct visNode *node;
+	double alt_sat, t, q[3], radius2, D, dx, dy, dz, dist, z_0, e0, e1, e2;
+	int stack[VIS_DEPTH], top = 0, i;
+
+	alt_sat = sqrt(x * x + y * y + z * z);
+	D = visMaxDistance(alt_sat - EARTHRAD, zMax);
+	if (D == 0.0)
+	{
+		return found;
+	}
+	q[0] = x / alt_sat;
+	q[1] = y / alt_sat;
+	q[2] = z / alt_sat;
+	radius2 = D * D / (EARTHRAD * ix->rMin);
+	t = EARTHRAD / alt_sat;
+
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		node = &ix->nodes[stack[--top]];
+		if (boxDistance2(node, q) > radius2)
+		{
+			continue;
+		}
+		if (node->left >= 0)
+		{
+			stack[top++] = node->left;
+			stack[top++] = node->right;
+			continue;
+		}
+		for (i = node->begin; i < node->end; i++)
+		{
+			e0 = ix->u[0][i] - q[0];
+			e1 = ix->u[1][i] - q[1];
+			e2 = ix->u[2][i] - q[2];
+			if (e0 * e0 + e1 * e1 + e2 * e2 > radius2)
+			{
+				continue;
+			}
+
+			/* Exact test, as in refractPoint */
+			dx = t * x - ix->pos[0][i];
+			dy = t * y - ix->pos[1][i];
+			dz = t * z - ix->pos[2][i];
+			dist = sqrt(dx * dx + dy * dy + dz * dz);
+			z_0 = atan(dist / (alt_sat - EARTHRAD)) + dist / EARTHRAD;
+			if (!(z_0 < zMax))
+			{
+				continue;
+			}
+			if (found < max)
+			{
+				if (stations != NULL)
+				{
+					stations[found] = ix->id[i];
+				}
+				if (pairs != NULL)
+				{
+					pairs[found].sat = sat;
+					pairs[found].station = ix->id[i];
+					pairs[found].z_0 = z_0;
+				}
+			}
+			found++;
+		}
+	}
+
+	return found;
+}
+
+/*
+------------------------------------------------------
+visQuery
+
+PURPOSE:		Find the stations at which a spacecraft is seen within a zenith angle
+INPUT ARGUMENTS:	ix, spacecraft coordinates (x,y,z), zMax (largest z_0, in radians; PI / 2
+			for the horizon), max (capacity of stations)
+OUTPUT ARGUMENTS:	Indices of the visible stations in stations[0..max-1], in no particular order
+RETURNED VALUE:		Number of visible stations, which may exceed max
+FUNCTIONS CALLED:	queryOne
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			A station is visible if z_0 < zMax, with z_0 computed as refractPoint does
+------------------------------------------------------
+*/
+
+size_t visQuery(const struct visIndex *ix, double x, double y, double z, double zMax, int *stations, size_t max)
+{
+	return queryOne(ix, 0, x, y, z, zMax, stations, NULL, 0, max);
+}
+
+/*
+------------------------------------------------------
+visQueryBatch
+
+PURPOSE:		Find every visible (spacecraft, station) pair of a constellation
+INPUT ARGUMENTS:	ix, n, spacecraft coordinates (x,y,z) as arrays, zMax, max (capacity of pairs)
+OUTPUT ARGUMENTS:	pairs[0..max-1], grouped by spacecraft in the order of the arrays
+RETURNED VALUE:		Number of visible pairs, which may exceed max
+FUNCTIONS CALLED:	queryOne
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			Call with max = 0 to size pairs. The pairs can be gathered into the
+			arrays of refractBatch, one point per pair.
+------------------------------------------------------
+*/
+
+size_t visQueryBatch(const struct visIndex *ix, size_t n, const double *x, const double *y, const double *z,
+	double zMax, struct visPair *pairs, size_t max)
+{
+	size_t i, found = 0;
+
+	for (i = 0; i < n; i++)
+	{
+		found = queryOne(ix, i, x[i], y[i], z[i], zMax, NULL, pairs, found, max);
+	}
+	return found;
+}
@@ -0,0 +1,37 @@
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+#include <stddef.h>
+
+/*
+Which ground stations see a spacecraft: a k-d tree over the station directions
+(unit vectors), queried with the cap of directions that can be within a zenith
+angle limit at the station
+*/
+#define VIS_LEAF 8              // Stations per leaf of the tree
+
+struct visIndex;
+
+/* One visible (spacecraft, station) pair of visQueryBatch */
+struct visPair
+{
+	size_t sat;                     // Index of the spacecraft in the query arrays
+	int station;                    // Index of the station in the arrays given to visIndexBuild
+	double z_0;                     // Zenith angle of the spacecraft at the station, as in refractPoint
+};
+
+/*
+Function prototypes
+*/
+struct visIndex *visIndexBuild(int n, const double *a, const double *b, const double *c);
+
+void visIndexFree(struct visIndex *ix);
+
+double visMaxDistance(double height_sat, double zMax);
+
+size_t visQuery(const struct visIndex *ix, double x, double y, double z, double zMax, int *stations, size_t max);
+
+size_t visQueryBatch(const struct visIndex *ix, size_t n, const double *x, const double *y, const double *z,
+	double zMax, struct visPair *pairs, size_t max);
+
+#endif
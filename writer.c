@@ -0,0 +1,482 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "writer.h"
+#include "ephemeris.h"
+
+/*
+------------------------------------------------------
+writer.c
+
+The producer copies its points into one of WRITER_BUFFERS buffers and hands
+full buffers to the writer thread, which formats and writes them. The producer
+waits only when every buffer is queued, i.e. when the output device is slower
+than the computation.
+
+Formats (writer.h):
+WRITER_BINARY	through ephemWriter, in the output format of ephemeris.h
+WRITER_HEX	%a-style hex floats, produced by shifting the bits of each double
+WRITER_CSV	fixed point with WRITER_CSV_DECIMALS decimals. Values below 1e9 in
+		magnitude are converted as integer and fraction in 64-bit integers;
+		larger values and non-finite values fall back to snprintf. The CSV is
+		rounded to the decimals kept; use WRITER_BINARY or WRITER_HEX for
+		exact output.
+------------------------------------------------------
+*/
+
+#define WRITER_BUFFERS 4
+#define WRITER_CHUNK 16384      // Points per buffer
+#define TEXT_SIZE (1 << 20)     // Text bytes gathered per fwrite
+#define TEXT_LINE 1024          // Upper bound on one formatted line
+
+struct writerBuf
+{
+	size_t n;
+	double *d, *e, *f;
+};
+
+struct refractWriter
+{
+	int format;
+	FILE *fp;                       // WRITER_HEX and WRITER_CSV
+	struct ephemWriter bin;         // WRITER_BINARY
+	char *text;
+
+	struct writerBuf buf[WRITER_BUFFERS];
+	int fill;                       // Buffer the producer is filling
+	int next;                       // Next buffer for the writer thread
+	int queued;                     // Buffers handed over and not yet written
+	int closing;
+	int error;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t ready;           // A buffer was queued, or closing was set
+	pthread_cond_t done;            // A buffer was written
+};
+
+static const double decimalScale[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+/* Append v in the form of printf("%a") */
+static char *putHex(char *p, double v)
+{
+	static const char digits[] = "0123456789abcdef";
+	uint64_t bits, mant;
+	int expo, i;
+
+	memcpy(&bits, &v, sizeof(bits));
+	mant = bits & 0xfffffffffffffull;
+	expo = (int)((bits >> 52) & 0x7ff);
+	if (bits >> 63)
+	{
+		*p++ = '-';
+	}
+	if (expo == 0x7ff)
+	{
+		memcpy(p, mant ? "nan" : "inf", 3);
+		return p + 3;
+	}
+	if (expo == 0 && mant == 0)
+	{
+		memcpy(p, "0x0p+0", 6);
+		return p + 6;
+	}
+
+	*p++ = '0';
+	*p++ = 'x';
+	*p++ = expo == 0 ? '0' : '1';
+	expo = expo == 0 ? -1022 : expo - 1023;
+	if (mant != 0)
+	{
+		*p++ = '.';
+		for (i = 48; i >= 0 && mant != 0; i -= 4)
+		{
+			*p++ = digits[(mant >> i) & 0xf];
+			mant &= (1ull << i) - 1;
+		}
+	}
+	*p++ = 'p';
+	*p++ = expo < 0 ? '-' : '+';
+	expo = expo < 0 ? -expo : expo;
+	if (expo >= 1000)
+	{
+		*p++ = (char)('0' + expo / 1000);
+	}
+	if (expo >= 100)
+	{
+		*p++ = (char)('0' + expo / 100 % 10);
+	}
+	if (expo >= 10)
+	{
+		*p++ = (char)('0' + expo / 10 % 10);
+	}
+	*p++ = (char)('0' + expo % 10);
+
+	return p;
+}
+
+/* Append v with WRITER_CSV_DECIMALS decimals */
+static char *putFixed(char *p, double v)
+{
+	char tmp[24];
+	uint64_t ip, fp;
+	int i, k;
+
+	if (!(v > -1e9 && v < 1e9))
+	{
+		return p + snprintf(p, TEXT_LINE / 4, "%.*f", WRITER_CSV_DECIMALS, v);
+	}
+
+	if (v < 0)
+	{
+		*p++ = '-';
+		v = -v;
+	}
+	/* The integer part and v - ip are exact, so only the fraction is rounded */
+	ip = (uint64_t)v;
+	fp = (uint64_t)((v - (double)ip) * decimalScale[WRITER_CSV_DECIMALS] + 0.5);
+	if (fp >= (uint64_t)decimalScale[WRITER_CSV_DECIMALS])
+	{
+		ip++;
+		fp -= (uint64_t)decimalScale[WRITER_CSV_DECIMALS];
+	}
+
+	k = 0;
+	do
+	{
+		tmp[k++] = (char)('0' + ip % 10);
+		ip /= 10;
+	} while (ip != 0);
+	while (k > 0)
+	{
+		*p++ = tmp[--k];
+	}
+	if (WRITER_CSV_DECIMALS > 0)
+	{
+		*p++ = '.';
+		for (i = WRITER_CSV_DECIMALS - 1; i >= 0; i--)
+		{
+			p[i] = (char)('0' + fp % 10);
+			fp /= 10;
+		}
+		p += WRITER_CSV_DECIMALS;
+	}
+
+	return p;
+}
+
+/* Format and write one buffer; returns 0 or -1 on a write error */
+static int writeBuf(struct refractWriter *w, const struct writerBuf *b)
+{
+	const double *cols[EPHEM_OUT_COLS];
+	char *p = w->text;
+	size_t i;
+
+	if (w->format == WRITER_BINARY)
+	{
+		cols[0] = b->d;
+		cols[1] = b->e;
+		cols[2] = b->f;
+		return ephemWriterAppend(&w->bin, b->n, cols);
+	}
+
+	for (i = 0; i < b->n; i++)
+	{
+		if (w->format == WRITER_HEX)
+		{
+			p = putHex(p, b->d[i]);
+			*p++ = ' ';
+			p = putHex(p, b->e[i]);
+			*p++ = ' ';
+			p = putHex(p, b->f[i]);
+		}
+		else
+		{
+			p = putFixed(p, b->d[i]);
+			*p++ = ',';
+			p = putFixed(p, b->e[i]);
+			*p++ = ',';
+			p = putFixed(p, b->f[i]);
+		}
+		*p++ = '\n';
+
+		if ((size_t)(p - w->text) > TEXT_SIZE - TEXT_LINE)
+		{
+			if (fwrite(w->text, 1, (size_t)(p - w->text), w->fp) != (size_t)(p - w->text))
+			{
+				return -1;
+			}
+			p = w->text;
+		}
+	}
+
+	return fwrite(w->text, 1, (size_t)(p - w->text), w->fp) == (size_t)(p - w->text) ? 0 : -1;
+}
+
+static void *writerMain(void *p)
+{
+	struct refractWriter *w = p;
+	struct writerBuf *b;
+	int error;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&w->lock);
+		while (w->queued == 0 && !w->closing)
+		{
+			pthread_cond_wait(&w->ready, &w->lock);
+		}
+		if (w->queued == 0)
+		{
+			pthread_mutex_unlock(&w->lock);
+			break;
+		}
+		b = &w->buf[w->next];
+		error = w->error;
+		pthread_mutex_unlock(&w->lock);
+
+		/* After an error, buffers are only drained so that the producer never waits forever */
+		if (!error && writeBuf(w, b) != 0)
+		{
+			error = 1;
+		}
+
+		pthread_mutex_lock(&w->lock);
+		w->error = error;
+		w->next = (w->next + 1) % WRITER_BUFFERS;
+		w->queued--;
+		pthread_cond_signal(&w->done);
+		pthread_mutex_unlock(&w->lock);
+	}
+
+	return NULL;
+}
+
+/* Hand the buffer being filled to the writer thread and move to the next free one */
+static void queueFill(struct refractWriter *w)
+{
+	pthread_mutex_lock(&w->lock);
+	w->queued++;
+	pthread_cond_signal(&w->ready);
+	while (w->queued == WRITER_BUFFERS)
+	{
+		pthread_cond_wait(&w->done, &w->lock);
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	w->fill = (w->fill + 1) % WRITER_BUFFERS;
+	w->buf[w->fill].n = 0;
+}
+
+/*
+------------------------------------------------------
+refractWriterOpen
+
+PURPOSE:		Create an output file and start its writer thread
+INPUT ARGUMENTS:	path ("-" for standard output, text formats only), format (writer.h)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		The writer, or NULL on failure
+FUNCTIONS CALLED:	ephemWriterOpen, fopen, fputs, malloc, pthread_create
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:
+------------------------------------------------------
+*/
+
+struct refractWriter *refractWriterOpen(const char *path, int format)
+{
+	struct refractWriter *w;
+	int i, ok = 1;
+
+	w = calloc(1, sizeof(*w));
+	if (w == NULL)
+	{
+		return NULL;
+	}
+	w->format = format;
+	for (i = 0; i < WRITER_BUFFERS; i++)
+	{
+		w->buf[i].d = malloc(3 * WRITER_CHUNK * sizeof(double));
+		ok = ok && w->buf[i].d != NULL;
+		w->buf[i].e = w->buf[i].d + WRITER_CHUNK;
+		w->buf[i].f = w->buf[i].e + WRITER_CHUNK;
+	}
+
+	if (ok && format == WRITER_BINARY)
+	{
+		ok = strcmp(path, "-") != 0 && ephemWriterOpen(&w->bin, path, EPHEM_OUT_COLS) == 0;
+	}
+	else if (ok && (format == WRITER_HEX || format == WRITER_CSV))
+	{
+		w->text = malloc(TEXT_SIZE);
+		w->fp = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+		ok = w->text != NULL && w->fp != NULL;
+		if (ok && format == WRITER_CSV)
+		{
+			ok = fputs("d,e,f\n", w->fp) >= 0;
+		}
+		if (!ok && w->fp != NULL && w->fp != stdout)
+		{
+			fclose(w->fp);
+		}
+	}
+	else
+	{
+		ok = 0;
+	}
+
+	if (ok)
+	{
+		pthread_mutex_init(&w->lock, NULL);
+		pthread_cond_init(&w->ready, NULL);
+		pthread_cond_init(&w->done, NULL);
+		if (pthread_create(&w->thread, NULL, writerMain, w) != 0)
+		{
+			if (format == WRITER_BINARY)
+			{
+				ephemWriterClose(&w->bin);
+			}
+			else if (w->fp != stdout)
+			{
+				fclose(w->fp);
+			}
+			pthread_mutex_destroy(&w->lock);
+			pthread_cond_destroy(&w->ready);
+			pthread_cond_destroy(&w->done);
+			ok = 0;
+		}
+	}
+	if (!ok)
+	{
+		for (i = 0; i < WRITER_BUFFERS; i++)
+		{
+			free(w->buf[i].d);
+		}
+		free(w->text);
+		free(w);
+		return NULL;
+	}
+
+	return w;
+}
+
+/*
+------------------------------------------------------
+refractWriterPut
+
+PURPOSE:		Queue n refracted points for writing
+INPUT ARGUMENTS:	w, n, refracted ground station coordinates (d,e,f)
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		0, or -1 if an earlier write has failed
+FUNCTIONS CALLED:	memcpy
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:			The points are copied; the arrays can be reused on return.
+			Call from one thread only.
+------------------------------------------------------
+*/
+
+int refractWriterPut(struct refractWriter *w, size_t n, const double *d, const double *e, const double *f)
+{
+	struct writerBuf *b;
+	size_t done = 0, m;
+	int error;
+
+	while (done < n)
+	{
+		b = &w->buf[w->fill];
+		m = WRITER_CHUNK - b->n < n - done ? WRITER_CHUNK - b->n : n - done;
+		memcpy(b->d + b->n, d + done, m * sizeof(double));
+		memcpy(b->e + b->n, e + done, m * sizeof(double));
+		memcpy(b->f + b->n, f + done, m * sizeof(double));
+		b->n += m;
+		done += m;
+		if (b->n == WRITER_CHUNK)
+		{
+			queueFill(w);
+		}
+	}
+
+	pthread_mutex_lock(&w->lock);
+	error = w->error;
+	pthread_mutex_unlock(&w->lock);
+
+	return error ? -1 : 0;
+}
+
+/*
+------------------------------------------------------
+refractWriterClose
+
+PURPOSE:		Write the remaining points, stop the writer thread and close the file
+INPUT ARGUMENTS:	w
+OUTPUT ARGUMENTS:	None
+RETURNED VALUE:		0 if every point was written, -1 otherwise
+FUNCTIONS CALLED:	ephemWriterClose, fclose, fflush, pthread_join
+VER./DATE:		1.0 16 Oct 2026
+PROGRAMMER:		JFG
+NOTES:
+------------------------------------------------------
+*/
+
+int refractWriterClose(struct refractWriter *w)
+{
+	int i, error;
+
+	if (w->buf[w->fill].n > 0)
+	{
+		queueFill(w);
+	}
+	pthread_mutex_lock(&w->lock);
+	w->closing = 1;
+	pthread_cond_signal(&w->ready);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread, NULL);
+
+	error = w->error;
+	if (w->format == WRITER_BINARY)
+	{
+		error = ephemWriterClose(&w->bin) != 0 || error;
+	}
+	else if (w->fp == stdout)
+	{
+		error = fflush(w->fp) != 0 || error;
+	}
+	else
+	{
+		error = fclose(w->fp) != 0 || error;
+	}
+
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->ready);
+	pthread_cond_destroy(&w->done);
+	for (i = 0; i < WRITER_BUFFERS; i++)
+	{
+		free(w->buf[i].d);
+	}
+	free(w->text);
+	free(w);
+
+	return error ? -1 : 0;
+}
+
+/* Format number for a name: "bin", "hex" or "csv"; -1 if unknown */
+int refractWriterFormat(const char *name)
+{
+	if (strcmp(name, "bin") == 0)
+	{
+		return WRITER_BINARY;
+	}
+	if (strcmp(name, "hex") == 0)
+	{
+		return WRITER_HEX;
+	}
+	if (strcmp(name, "csv") == 0)
+	{
+		return WRITER_CSV;
+	}
+
+	return -1;
+}
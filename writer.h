@@ -0,0 +1,31 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <stddef.h>
+
+/*
+Output stage for refracted ground station coordinates (d,e,f), formatted and
+written on a thread of its own
+*/
+#define WRITER_BINARY 0         // Output file of ephemeris.h (raw doubles in columns, with header)
+#define WRITER_HEX 1            // One "d e f" line per point in C99 hex floats, exact and diffable
+#define WRITER_CSV 2            // "d,e,f" header, then one line per point with WRITER_CSV_DECIMALS decimals
+
+#ifndef WRITER_CSV_DECIMALS
+#define WRITER_CSV_DECIMALS 9   // Nanometres; at most 9
+#endif
+
+struct refractWriter;
+
+/*
+Function prototypes
+*/
+struct refractWriter *refractWriterOpen(const char *path, int format);
+
+int refractWriterPut(struct refractWriter *w, size_t n, const double *d, const double *e, const double *f);
+
+int refractWriterClose(struct refractWriter *w);
+
+int refractWriterFormat(const char *name);
+
+#endif